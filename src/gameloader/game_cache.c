@@ -0,0 +1,368 @@
+/*
+ * HackDS Game Loader
+ * Persistent cache of extracted games
+ *
+ * Each game is extracted once into <root>/<content id>, where the content id
+ * comes from hackds_content_id(). A marker file written after a successful
+ * extraction records the id, the extracted size and a stamp of every file's
+ * inode, size, mtime and ctime; its mtime is bumped on every launch and
+ * drives LRU eviction.
+ */
+
+#define _GNU_SOURCE
+#include "game_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#define MARKER_NAME ".hackds-cache"
+#define TMP_INFIX ".tmp."
+#define STAMP_SEED 0xcbf29ce484222325ull   // FNV-1a offset basis
+
+typedef struct {
+    char name[64];
+    uint64_t bytes;
+    time_t used;
+} cache_entry_t;
+
+static int remove_entry(const char *path, const struct stat *st,
+                        int type, struct FTW *ftw) {
+    (void)st;
+    (void)type;
+    (void)ftw;
+    remove(path);
+    return 0;
+}
+
+int game_cache_remove_tree(const char *path) {
+    if (access(path, F_OK) != 0) return 0;
+    return nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static int mkdir_p(const char *path) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s", path);
+
+    for (char *p = tmp + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(tmp, 0755) != 0 && errno != EEXIST) return -1;
+        *p = '/';
+    }
+    if (mkdir(tmp, 0755) != 0 && errno != EEXIST) return -1;
+
+    return 0;
+}
+
+// Name of the i-th file in the tree of a game, or of the game with its mods
+// applied. *size is set to UINT64_MAX for merged files, whose size is not
+// known without building them.
+static const char *tree_file(const hackds_file_t *game, const hackds_overlay_t *overlay,
+                             size_t i, uint64_t *size) {
+    if (!overlay) {
+        *size = game->files[i].size;
+        return game->files[i].filename;
+    }
+
+    const hackds_overlay_entry_t *entry = &overlay->entries[i];
+    *size = entry->layer == entry->merge_base ? entry->entry->size : UINT64_MAX;
+    return entry->filename;
+}
+
+static size_t tree_count(const hackds_file_t *game, const hackds_overlay_t *overlay) {
+    return overlay ? overlay->entry_count : game->file_count;
+}
+
+// Fold a file's identity into a tree stamp (FNV-1a). Any write changes the
+// ctime, even when the size stays the same and the mtime is put back.
+static uint64_t stamp_file(uint64_t stamp, const struct stat *st) {
+    const uint64_t fields[] = {
+        (uint64_t)st->st_ino, (uint64_t)st->st_size,
+        (uint64_t)st->st_mtim.tv_sec, (uint64_t)st->st_mtim.tv_nsec,
+        (uint64_t)st->st_ctim.tv_sec, (uint64_t)st->st_ctim.tv_nsec,
+    };
+    const uint8_t *bytes = (const uint8_t*)fields;
+    for (size_t i = 0; i < sizeof(fields); i++) {
+        stamp = (stamp ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return stamp;
+}
+
+// Disk space taken by an extracted tree, where skeleton placeholders count
+// as 0, and the stamp of its files
+static uint64_t tree_bytes(const hackds_file_t *game, const hackds_overlay_t *overlay,
+                           const char *dir, uint64_t *stamp) {
+    *stamp = STAMP_SEED;
+    int dirfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) return 0;
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < tree_count(game, overlay); i++) {
+        struct stat st;
+        uint64_t size;
+        if (fstatat(dirfd, tree_file(game, overlay, i, &size), &st,
+                    AT_SYMLINK_NOFOLLOW) == 0) {
+            total += (uint64_t)st.st_size;
+            *stamp = stamp_file(*stamp, &st);
+        }
+    }
+
+    close(dirfd);
+    return total;
+}
+
+// Read a marker, returning the extracted size or 0 if it is missing or was
+// written for different contents. Markers without a stamp predate it and
+// count as missing when stamp is wanted.
+static uint64_t read_marker(int dirfd, const char *key, uint64_t *stamp) {
+    int fd = openat(dirfd, MARKER_NAME, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    char buf[96];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return 0;
+    buf[n] = '\0';
+
+    char stored[32];
+    unsigned long long bytes, stored_stamp;
+    int fields = sscanf(buf, "%31s %llu %llx", stored, &bytes, &stored_stamp);
+    if (fields < 2 || (stamp && fields < 3)) return 0;
+    if (key && strcmp(stored, key) != 0) return 0;
+    if (stamp) *stamp = stored_stamp;
+
+    // A game with no data still needs a non-zero answer
+    return bytes + 1;
+}
+
+static int write_marker(const hackds_file_t *game, const hackds_overlay_t *overlay,
+                        const char *dir, const char *key) {
+    uint64_t stamp;
+    uint64_t bytes = tree_bytes(game, overlay, dir, &stamp);
+
+    char path[512];
+    if (snprintf(path, sizeof(path), "%s/" MARKER_NAME, dir) >= (int)sizeof(path)) {
+        return -1;
+    }
+
+    FILE *fp = fopen(path, "w");
+    if (!fp) return -1;
+    fprintf(fp, "%s %llu %016llx\n", key, (unsigned long long)bytes,
+            (unsigned long long)stamp);
+    return fclose(fp);
+}
+
+// Check that a cached tree still matches the archive. Every entry must exist
+// with the right size, or as an untouched placeholder in a skeleton, and no
+// file may have been written or replaced since the marker was; anything else
+// means it was tampered with or a previous run was interrupted, and the game
+// is extracted again.
+static bool cache_intact(const hackds_file_t *game, const hackds_overlay_t *overlay,
+                         const char *dir, const char *key, bool skeleton) {
+    int dirfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) return false;
+
+    uint64_t stored, stamp = STAMP_SEED;
+    bool intact = read_marker(dirfd, key, &stored) != 0;
+    for (size_t i = 0; i < tree_count(game, overlay) && intact; i++) {
+        struct stat st;
+        uint64_t size;
+        const char *name = tree_file(game, overlay, i, &size);
+        if (fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0 ||
+            !S_ISREG(st.st_mode) ||
+            ((uint64_t)st.st_size != size && size != UINT64_MAX &&
+             !(skeleton && hackds_is_placeholder(&st)))) {
+            intact = false;
+        } else {
+            stamp = stamp_file(stamp, &st);
+        }
+    }
+    if (intact && stamp != stored) intact = false;
+
+    // Record the launch for LRU eviction
+    if (intact) utimensat(dirfd, MARKER_NAME, NULL, 0);
+
+    close(dirfd);
+    return intact;
+}
+
+static int compare_used(const void *a, const void *b) {
+    const cache_entry_t *x = a;
+    const cache_entry_t *y = b;
+    return x->used < y->used ? -1 : x->used > y->used;
+}
+
+// Drop least recently used games until the cache fits in budget. The game
+// being launched is never evicted.
+static void evict(const char *root, const char *keep, uint64_t budget) {
+    DIR *dir = opendir(root);
+    if (!dir) return;
+
+    cache_entry_t *entries = NULL;
+    size_t count = 0, capacity = 0;
+    uint64_t total = 0;
+
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.' || strlen(de->d_name) >= sizeof(entries->name)) {
+            continue;
+        }
+
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", root, de->d_name);
+
+        // Leftovers from an extraction whose process has gone away
+        char *tmp = strstr(de->d_name, TMP_INFIX);
+        if (tmp) {
+            pid_t pid = (pid_t)atoi(tmp + strlen(TMP_INFIX));
+            if (pid > 0 && kill(pid, 0) != 0 && errno == ESRCH) {
+                game_cache_remove_tree(path);
+            }
+            continue;
+        }
+
+        int dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirfd < 0) continue;
+
+        struct stat st;
+        uint64_t bytes = read_marker(dirfd, NULL, NULL);
+        if (bytes == 0 || fstatat(dirfd, MARKER_NAME, &st, 0) != 0) {
+            close(dirfd);
+            continue;
+        }
+        close(dirfd);
+
+        if (count == capacity) {
+            size_t grown = capacity ? capacity * 2 : 16;
+            cache_entry_t *resized = realloc(entries, grown * sizeof(*entries));
+            if (!resized) break;
+            entries = resized;
+            capacity = grown;
+        }
+
+        strcpy(entries[count].name, de->d_name);
+        entries[count].bytes = bytes - 1;
+        entries[count].used = st.st_mtime;
+        total += bytes - 1;
+        count++;
+    }
+    closedir(dir);
+
+    qsort(entries, count, sizeof(*entries), compare_used);
+
+    for (size_t i = 0; i < count && total > budget; i++) {
+        if (strcmp(entries[i].name, keep) == 0) continue;
+
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", root, entries[i].name);
+        if (game_cache_remove_tree(path) == 0) total -= entries[i].bytes;
+    }
+
+    free(entries);
+}
+
+static const char *cache_root(void) {
+    const char *root = getenv("HACKDS_CACHE_DIR");
+    return root && *root ? root : GAME_CACHE_ROOT;
+}
+
+static uint64_t cache_budget(void) {
+    uint64_t budget = GAME_CACHE_DEFAULT_MB;
+    const char *size_env = getenv("HACKDS_CACHE_SIZE_MB");
+    if (size_env && *size_env) budget = strtoull(size_env, NULL, 10);
+    return budget << 20;
+}
+
+int game_cache_prepare(hackds_file_t *game, const game_cache_opts_t *opts,
+                       char *game_dir, size_t len) {
+    const char *root = cache_root();
+    bool skeleton = opts->mode == GAME_CACHE_SKELETON;
+
+    // Mods change the tree, so each combination is cached on its own
+    uint64_t id;
+    int identified = opts->overlay ? hackds_overlay_content_id(opts->overlay, &id)
+                                   : hackds_content_id(game, &id);
+    if (identified != 0) return -1;
+
+    // Pipelined trees end up identical to full ones and share their key
+    char key[32];
+    snprintf(key, sizeof(key), "%016llx%s", (unsigned long long)id,
+             skeleton ? "-skel" : "");
+    snprintf(game_dir, len, "%s/%s", root, key);
+
+    if (cache_intact(game, opts->overlay, game_dir, key, skeleton)) {
+        return 0;
+    }
+
+    if (mkdir_p(root) != 0) {
+        fprintf(stderr, "Warning: cannot create cache %s: %s\n", root, strerror(errno));
+        return -1;
+    }
+    game_cache_remove_tree(game_dir);
+
+    // Extract next to the final location and rename into place, so a crash
+    // or a second loader never sees a half-written tree
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s/%s" TMP_INFIX "%d", root, key, (int)getpid());
+    game_cache_remove_tree(tmp);
+
+    int extracted;
+    switch (opts->mode) {
+    case GAME_CACHE_SKELETON:
+        extracted = hackds_extract_skeleton(game, tmp, opts->entrypoint);
+        break;
+    case GAME_CACHE_PIPELINED:
+        extracted = hackds_extract_skeleton(game, tmp, opts->entrypoint);
+        if (extracted == 0 && opts->preload_count > 0) {
+            extracted = hackds_fill_skeleton(game, tmp, opts->preload,
+                                             opts->preload_count);
+        }
+        break;
+    default:
+        extracted = opts->overlay ? hackds_overlay_extract_all(opts->overlay, tmp)
+                                  : hackds_extract_all(game, tmp);
+        break;
+    }
+
+    // A pipelined tree gets its marker once game_cache_finish() is done
+    if (extracted != 0 ||
+        (opts->mode != GAME_CACHE_PIPELINED &&
+         write_marker(game, opts->overlay, tmp, key) != 0)) {
+        fprintf(stderr, "Warning: cache extraction failed: %s\n", hackds_get_error());
+        game_cache_remove_tree(tmp);
+        return -1;
+    }
+
+    if (rename(tmp, game_dir) != 0) {
+        // Another loader finished the same game first
+        game_cache_remove_tree(tmp);
+        return cache_intact(game, opts->overlay, game_dir, key, skeleton) ? 0 : -1;
+    }
+
+    if (opts->mode == GAME_CACHE_PIPELINED) return 1;
+
+    evict(root, key, cache_budget());
+    return 0;
+}
+
+int game_cache_finish(hackds_file_t *game, const char *game_dir) {
+    if (hackds_fill_skeleton(game, game_dir, NULL, 0) != 0) {
+        fprintf(stderr, "Warning: background extraction failed: %s\n",
+                hackds_get_error());
+        return -1;
+    }
+
+    const char *key = strrchr(game_dir, '/');
+    key = key ? key + 1 : game_dir;
+    if (write_marker(game, NULL, game_dir, key) != 0) return -1;
+
+    evict(cache_root(), key, cache_budget());
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * HackDS Game Loader
+ * Persistent cache of extracted games
+ */
+
+#ifndef GAME_CACHE_H
+#define GAME_CACHE_H
+
+#include "../libhackds/hackds_format.h"
+
+#define GAME_CACHE_ROOT "/var/cache/hackds/games"
+#define GAME_CACHE_DEFAULT_MB 512
+
+typedef enum {
+    GAME_CACHE_FULL,          // Extract everything before launch
+    GAME_CACHE_SKELETON,      // Layout only, files served by the preload shim
+    GAME_CACHE_PIPELINED      // Full extraction, but launch as soon as the
+                              // entrypoint and preload list are written
+} game_cache_mode_t;
+
+typedef struct {
+    game_cache_mode_t mode;
+    const char *entrypoint;
+    const char *const *preload;  // Pipelined: files written before launch
+    size_t preload_count;
+    hackds_overlay_t *overlay;   // Cache the game with these mods applied;
+                                 // full mode only
+} game_cache_opts_t;
+
+// Make sure an extracted copy of game exists in the cache and write its
+// directory to game_dir. Unchanged games are reused without extracting
+// anything. Returns 0 when the tree is ready, 1 when a pipelined tree still
+// has placeholders (finish it with game_cache_finish() while the game runs
+// through the preload shim), and -1 if the cache could not be used.
+//
+// The cache lives in HACKDS_CACHE_DIR (default GAME_CACHE_ROOT) and is kept
+// under HACKDS_CACHE_SIZE_MB megabytes by evicting least recently launched
+// games first.
+int game_cache_prepare(hackds_file_t *game, const game_cache_opts_t *opts,
+                       char *game_dir, size_t len);
+
+// Write out the rest of a pipelined tree and mark it complete
+int game_cache_finish(hackds_file_t *game, const char *game_dir);
+
+// Recursively delete a directory tree
+int game_cache_remove_tree(const char *path);
+
+#endif // GAME_CACHE_H
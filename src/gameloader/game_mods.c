@@ -0,0 +1,197 @@
+/*
+ * HackDS Game Loader
+ * Mods enabled in a game's settings
+ *
+ * Settings file payload:
+ *   {"mods": ["hd-textures.hdsm", "speedrun.hdsm"], ...}
+ *
+ * The order of the list does not matter; mods are layered by their own
+ * "priority".
+ */
+
+#define _GNU_SOURCE
+#include "game_mods.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_PATH 512
+
+static const char *dir_from_env(const char *env, const char *fallback) {
+    const char *dir = getenv(env);
+    return dir && *dir ? dir : fallback;
+}
+
+// Compare dotted version numbers: "1.10" > "1.9", "1.0" == "1"
+static int compare_versions(const char *a, const char *b) {
+    for (;;) {
+        char *a_end, *b_end;
+        long x = strtol(a, &a_end, 10);
+        long y = strtol(b, &b_end, 10);
+        if (x != y) return x < y ? -1 : 1;
+        if (*a_end != '.' && *b_end != '.') return 0;
+        a = *a_end == '.' ? a_end + 1 : a_end;
+        b = *b_end == '.' ? b_end + 1 : b_end;
+    }
+}
+
+// Check a constraint such as ">=1.0.0". Constraints that cannot be read
+// do not block the mod.
+static bool version_satisfies(const char *version, const char *constraint) {
+    while (*constraint == ' ') constraint++;
+
+    static const char *const ops[] = { ">=", "<=", "==", ">", "<", "=" };
+    const char *op = "==";
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (strncmp(constraint, ops[i], strlen(ops[i])) == 0) {
+            op = ops[i];
+            constraint += strlen(ops[i]);
+            break;
+        }
+    }
+    while (*constraint == ' ') constraint++;
+    if (*constraint < '0' || *constraint > '9') return true;
+
+    int cmp = compare_versions(version, constraint);
+    if (op[0] == '>') return cmp > 0 || (op[1] == '=' && cmp == 0);
+    if (op[0] == '<') return cmp < 0 || (op[1] == '=' && cmp == 0);
+    return cmp == 0;
+}
+
+// Read the "mods" list of a settings file. Returns how many names were
+// stored in names; the caller frees them.
+static size_t read_enabled(const char *path, char **names, size_t max) {
+    if (access(path, F_OK) != 0) return 0;
+
+    hackds_file_t *settings = hackds_open(path);
+    if (!settings) {
+        fprintf(stderr, "Warning: cannot read %s: %s\n", path, hackds_get_error());
+        return 0;
+    }
+
+    const char *json = (const char*)settings->payload;
+    size_t len = settings->payload ? settings->header.payload_size : 0;
+    if (settings->type != HACKDS_TYPE_SETTINGS || settings->blocks) {
+        fprintf(stderr, "Warning: %s is not a settings file\n", path);
+        len = 0;
+    }
+
+    int count = len ? hackds_json_parse(json, len, NULL, 0) : 0;
+    hackds_json_token_t *tokens = count > 0 ? malloc((size_t)count * sizeof(*tokens)) : NULL;
+    if (tokens && hackds_json_parse(json, len, tokens, count) != count) {
+        free(tokens);
+        tokens = NULL;
+    }
+    if (len && !tokens) {
+        fprintf(stderr, "Warning: malformed settings in %s\n", path);
+    }
+
+    size_t used = 0;
+    int list = tokens ? hackds_json_find(json, tokens, count, 0, "mods") : -1;
+    if (list >= 0 && tokens[list].type == HACKDS_JSON_ARRAY) {
+        for (int i = 0; i < tokens[list].size && used < max; i++) {
+            char item[16];
+            snprintf(item, sizeof(item), "%d", i);
+            int tok = hackds_json_find(json, tokens, count, list, item);
+
+            char name[256];
+            if (tok < 0 || tokens[tok].type != HACKDS_JSON_STRING ||
+                hackds_json_unescape(json, &tokens[tok], name, sizeof(name)) < 0) {
+                continue;
+            }
+
+            // Mods are plain file names inside the mods directory
+            if (name[0] == '\0' || name[0] == '.' || strchr(name, '/')) {
+                fprintf(stderr, "Warning: ignoring mod name %s\n", name);
+                continue;
+            }
+            names[used++] = strdup(name);
+            if (!names[used - 1]) used--;
+        }
+    }
+
+    free(tokens);
+    hackds_close(settings);
+    return used;
+}
+
+// Whether a mod is meant for this game and version
+static bool mod_compatible(hackds_file_t *mod, hackds_file_t *game, const char *id,
+                           const char *name) {
+    char target[256], value[256];
+
+    if (hackds_get_metadata_string(mod, "target_game", target, sizeof(target)) == 0 &&
+        strcmp(target, id) != 0 &&
+        (hackds_get_metadata_string(game, "name", value, sizeof(value)) != 0 ||
+         strcmp(target, value) != 0)) {
+        fprintf(stderr, "Warning: mod %s is for %s\n", name, target);
+        return false;
+    }
+
+    if (hackds_get_metadata_string(mod, "target_version", target, sizeof(target)) == 0 &&
+        hackds_get_metadata_string(game, "version", value, sizeof(value)) == 0 &&
+        !version_satisfies(value, target)) {
+        fprintf(stderr, "Warning: mod %s needs version %s, game is %s\n",
+                name, target, value);
+        return false;
+    }
+
+    return true;
+}
+
+size_t game_mods_load(hackds_file_t *game, const char *game_path, game_mods_t *mods) {
+    memset(mods, 0, sizeof(*mods));
+
+    // Game id: file name without extension
+    const char *base = strrchr(game_path, '/');
+    base = base ? base + 1 : game_path;
+    char id[256];
+    snprintf(id, sizeof(id), "%s", base);
+    char *ext = strrchr(id, '.');
+    if (ext && ext != id) *ext = '\0';
+
+    char path[MAX_PATH];
+    snprintf(path, sizeof(path), "%s/%s.hdss",
+             dir_from_env("HACKDS_SETTINGS_DIR", GAME_SETTINGS_DIR), id);
+
+    char *names[MAX_MODS];
+    size_t count = read_enabled(path, names, MAX_MODS);
+    const char *mods_dir = dir_from_env("HACKDS_MODS_DIR", GAME_MODS_DIR);
+
+    for (size_t i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "%s/%s", mods_dir, names[i]);
+
+        hackds_file_t *mod = hackds_open_mapped(path);
+        if (!mod) {
+            fprintf(stderr, "Warning: cannot open mod %s: %s\n", names[i], hackds_get_error());
+        } else if (!mod_compatible(mod, game, id, names[i])) {
+            hackds_close(mod);
+        } else {
+            if (!mods->overlay) mods->overlay = hackds_overlay_open(game);
+            if (!mods->overlay || hackds_overlay_add(mods->overlay, mod) != 0) {
+                fprintf(stderr, "Warning: cannot apply mod %s: %s\n",
+                        names[i], hackds_get_error());
+                hackds_close(mod);
+            } else {
+                mods->mods[mods->count++] = mod;
+            }
+        }
+        free(names[i]);
+    }
+
+    if (mods->overlay && mods->count == 0) {
+        hackds_overlay_close(mods->overlay);
+        mods->overlay = NULL;
+    }
+
+    return mods->count;
+}
+
+void game_mods_close(game_mods_t *mods) {
+    hackds_overlay_close(mods->overlay);
+    mods->overlay = NULL;
+
+    for (size_t i = 0; i < mods->count; i++) hackds_close(mods->mods[i]);
+    mods->count = 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * HackDS Game Loader
+ * Mods enabled in a game's settings
+ */
+
+#ifndef GAME_MODS_H
+#define GAME_MODS_H
+
+#include "../libhackds/hackds_format.h"
+
+#define GAME_SETTINGS_DIR "/settings/games"
+#define GAME_MODS_DIR "/mods"
+#define MAX_MODS 32
+
+typedef struct {
+    hackds_overlay_t *overlay;  // NULL when no mod is enabled
+    hackds_file_t *mods[MAX_MODS];
+    size_t count;
+} game_mods_t;
+
+// Layer the game's enabled mods over it. The game id is the .hdsg file name
+// without its extension; its settings are <settings>/<id>.hdss, whose JSON
+// payload lists mod files in <mods> under "mods". Mods that cannot be
+// opened, target another game or a version this one does not satisfy are
+// skipped with a warning.
+//
+// HACKDS_SETTINGS_DIR and HACKDS_MODS_DIR override GAME_SETTINGS_DIR and
+// GAME_MODS_DIR. Returns the number of mods enabled.
+size_t game_mods_load(hackds_file_t *game, const char *game_path, game_mods_t *mods);
+
+// Close the overlay and the mods; do this before closing the game
+void game_mods_close(game_mods_t *mods);
+
+#endif // GAME_MODS_H
@@ -3,17 +3,28 @@
  * Loads and executes .hdsg game files
  */
 
+#define _GNU_SOURCE
 #include "../libhackds/hackds_format.h"
+#include "game_cache.h"
+#include "game_mods.h"
+#include "launch_profile.h"
+#include "perf_profile.h"
+#include "zygote_client.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <errno.h>
 
 #define TEMP_DIR "/tmp/hackds_game"
+#define PRELOAD_LIB "/system/lib/libhackds_preload.so"
 #define MAX_PATH 512
+#define MAX_PRELOAD 64
+#define MAX_LIBRARIES 32
 
 typedef struct {
     char name[256];
@@ -21,26 +32,75 @@ typedef struct {
     char author[128];
     char engine[32];
     char entrypoint[256];
+    char *preload[MAX_PRELOAD];  // Files needed before the first frame
+    size_t preload_count;
+    char *libraries[MAX_LIBRARIES];  // requires.libraries
+    size_t library_count;
 } game_metadata_t;
 
-static int parse_metadata(const char *json, game_metadata_t *meta);
-static int extract_game(hackds_file_t *game, const char *dest);
-static int run_python_game(const char *game_dir, const char *entrypoint);
+typedef struct {
+    hackds_file_t *game;
+    const char *game_dir;
+} fill_job_t;
+
+// Environment handed to games that run through the preload shim
+static char shim_env[3][MAX_PATH + 32];
+static bool use_shim;
+
+// The game's "performance" block
+static perf_profile_t perf;
+
+static int parse_metadata(hackds_file_t *game, game_metadata_t *meta);
+static size_t parse_list(hackds_file_t *game, const char *path,
+                         char **items, size_t max);
+static int launch_game(const char *game_path);
+static bool setup_shim(const char *game_path);
+static void *fill_thread(void *arg);
+static int run_python_game(const char *game_dir, const game_metadata_t *meta);
 static int run_cpp_game(const char *game_dir, const char *entrypoint);
+static void apply_perf(pid_t pid);
+static void open_exec_pipe(int fds[2]);
+static int wait_for_game(pid_t pid, int ready_fd, uint64_t begin);
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <game.hdsg>\n", argv[0]);
+    // Launch profiling: --profile[=FILE] or HACKDS_PROFILE=FILE
+    const char *profile_log = getenv("HACKDS_PROFILE");
+    const char *game_path = NULL;
+    bool usage = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--profile") == 0) {
+            profile_log = LAUNCH_PROFILE_LOG;
+        } else if (strncmp(argv[i], "--profile=", 10) == 0) {
+            profile_log = argv[i] + 10;
+        } else if (!game_path) {
+            game_path = argv[i];
+        } else {
+            usage = true;
+        }
+    }
+
+    if (!game_path || usage) {
+        fprintf(stderr, "Usage: %s [--profile[=FILE]] <game.hdsg>\n", argv[0]);
         return 1;
     }
 
-    const char *game_path = argv[1];
+    if (profile_log && *profile_log) {
+        launch_profile_start(profile_log);
+    }
 
+    int result = launch_game(game_path);
+
+    launch_profile_write(game_path, result);
+    return result;
+}
+
+static int launch_game(const char *game_path) {
     printf("HackDS Game Loader\n");
     printf("Loading: %s\n", game_path);
 
     // Open the game file
-    hackds_file_t *game = hackds_open(game_path);
+    hackds_file_t *game = hackds_open_mapped(game_path);
     if (!game) {
         fprintf(stderr, "Error: %s\n", hackds_get_error());
         return 1;
@@ -54,223 +114,251 @@ int main(int argc, char *argv[]) {
     }
 
     // Parse metadata
-    game_metadata_t meta;
-    if (parse_metadata(hackds_get_metadata(game), &meta) != 0) {
+    game_metadata_t meta = {0};
+    uint64_t begin = launch_profile_now();
+    if (parse_metadata(game, &meta) != 0) {
         fprintf(stderr, "Error: Failed to parse game metadata\n");
         hackds_close(game);
         return 1;
     }
+    launch_profile_end(PROFILE_METADATA, begin, 0);
+    launch_profile_set("game", meta.name);
+    launch_profile_set("engine", meta.engine);
 
     printf("Game: %s v%s\n", meta.name, meta.version);
     printf("Author: %s\n", meta.author);
     printf("Engine: %s\n", meta.engine);
 
-    // Create temporary directory
-    mkdir(TEMP_DIR, 0755);
+    // A broken performance profile is the game's problem, not a reason to
+    // refuse it
+    if (perf_profile_parse(game, &perf) != 0) {
+        fprintf(stderr, "Warning: Ignoring invalid performance profile\n");
+        perf.present = false;
+    }
 
-    // Extract game files
-    printf("Extracting game files...\n");
-    if (extract_game(game, TEMP_DIR) != 0) {
-        fprintf(stderr, "Error: Failed to extract game\n");
-        hackds_close(game);
-        return 1;
+    // Mods enabled in the game's settings are layered over it
+    game_mods_t mods;
+    if (game_mods_load(game, game_path, &mods) > 0) {
+        printf("Mods: %zu enabled\n", mods.count);
     }
 
-    hackds_close(game);
+    // Pick how the game gets onto disk. Through the preload shim an
+    // uncompressed archive needs only its layout extracted, since the game
+    // can read straight from the mapped file. Compressed archives are
+    // extracted in full, but pipelined: the game starts once its entrypoint
+    // and preload list are written and the rest streams out in the
+    // background, with the shim serving whatever is not there yet. Either
+    // way the cached tree is reused when the game is unchanged. Without a
+    // usable cache, fully extract to a temporary directory as before.
+    // The shim serves a single archive, so modded games are always
+    // extracted in full, each winning file once.
+    bool shim_available = !mods.overlay && setup_shim(game_path);
+
+    game_cache_opts_t opts = {
+        .mode = GAME_CACHE_FULL,
+        .entrypoint = meta.entrypoint,
+        .preload = (const char *const *)meta.preload,
+        .preload_count = meta.preload_count,
+        .overlay = mods.overlay,
+    };
+    if (shim_available) {
+        opts.mode = (game->header.flags & FLAG_COMPRESSED) ? GAME_CACHE_PIPELINED
+                                                           : GAME_CACHE_SKELETON;
+    }
+
+    static const char *const mode_names[] = { "full", "skeleton", "pipelined" };
+    begin = launch_profile_now();
+    uint64_t written = launch_profile_written();
+
+    char game_dir[MAX_PATH];
+    int prepared = game_cache_prepare(game, &opts, game_dir, sizeof(game_dir));
+    bool cached = prepared >= 0;
+    bool filling = prepared == 1;
+    use_shim = opts.mode == GAME_CACHE_SKELETON || filling;
+
+    if (!cached) {
+        use_shim = false;
+        snprintf(game_dir, sizeof(game_dir), "%s", TEMP_DIR);
+        game_cache_remove_tree(game_dir);
+
+        printf("Extracting game files...\n");
+        int extracted = mods.overlay ? hackds_overlay_extract_all(mods.overlay, game_dir)
+                                     : hackds_extract_all(game, game_dir);
+        if (extracted != 0) {
+            fprintf(stderr, "Error: Failed to extract game: %s\n", hackds_get_error());
+            game_mods_close(&mods);
+            hackds_close(game);
+            return 1;
+        }
+    }
+    launch_profile_end(PROFILE_EXTRACT, begin, launch_profile_written() - written);
+    launch_profile_set("mode", cached ? mode_names[opts.mode] : "temp");
+
+    pthread_t filler;
+    fill_job_t job = { game, game_dir };
+    if (filling && pthread_create(&filler, NULL, fill_thread, &job) != 0) {
+        game_cache_finish(game, game_dir);
+        filling = false;
+    }
+    if (!filling) {
+        game_mods_close(&mods);
+        hackds_close(game);
+    }
 
     // Run the game based on engine type
+    perf_profile_setup(&perf);
     int result = 0;
     if (strcmp(meta.engine, "python") == 0) {
-        result = run_python_game(TEMP_DIR, meta.entrypoint);
+        result = run_python_game(game_dir, &meta);
     } else if (strcmp(meta.engine, "cpp") == 0) {
-        result = run_cpp_game(TEMP_DIR, meta.entrypoint);
+        result = run_cpp_game(game_dir, meta.entrypoint);
     } else {
         fprintf(stderr, "Error: Unsupported engine: %s\n", meta.engine);
         result = 1;
     }
+    perf_profile_restore(&perf);
+
+    // Let the background extraction finish so the next launch finds a
+    // complete tree
+    if (filling) {
+        pthread_join(filler, NULL);
+        hackds_close(game);
+    }
+
+    for (size_t i = 0; i < meta.preload_count; i++) free(meta.preload[i]);
+    for (size_t i = 0; i < meta.library_count; i++) free(meta.libraries[i]);
 
     // Cleanup
-    printf("Cleaning up...\n");
-    system("rm -rf " TEMP_DIR);
+    if (!cached) {
+        printf("Cleaning up...\n");
+        game_cache_remove_tree(game_dir);
+    }
 
     return result;
 }
 
-static int parse_metadata(const char *json, game_metadata_t *meta) {
-    if (!json || !meta) return -1;
-
-    // Simple JSON parsing (you'd want a proper JSON library in production)
-    // For now, we'll do basic string parsing
-
-    const char *name_start = strstr(json, "\"name\"");
-    if (name_start) {
-        name_start = strchr(name_start, ':');
-        if (name_start) {
-            name_start = strchr(name_start, '"');
-            if (name_start) {
-                name_start++;
-                const char *name_end = strchr(name_start, '"');
-                if (name_end) {
-                    size_t len = name_end - name_start;
-                    if (len < sizeof(meta->name)) {
-                        strncpy(meta->name, name_start, len);
-                        meta->name[len] = '\0';
-                    }
-                }
-            }
-        }
-    }
+// Copy a string field, leaving it empty if missing or too long
+static void get_string(hackds_file_t *game, const char *path, char *buf, size_t len) {
+    if (hackds_get_metadata_string(game, path, buf, len) != 0) buf[0] = '\0';
+}
 
-    const char *version_start = strstr(json, "\"version\"");
-    if (version_start) {
-        version_start = strchr(version_start, ':');
-        if (version_start) {
-            version_start = strchr(version_start, '"');
-            if (version_start) {
-                version_start++;
-                const char *version_end = strchr(version_start, '"');
-                if (version_end) {
-                    size_t len = version_end - version_start;
-                    if (len < sizeof(meta->version)) {
-                        strncpy(meta->version, version_start, len);
-                        meta->version[len] = '\0';
-                    }
-                }
-            }
-        }
-    }
+static int parse_metadata(hackds_file_t *game, game_metadata_t *meta) {
+    if (!game || !meta) return -1;
 
-    const char *author_start = strstr(json, "\"author\"");
-    if (author_start) {
-        author_start = strchr(author_start, ':');
-        if (author_start) {
-            author_start = strchr(author_start, '"');
-            if (author_start) {
-                author_start++;
-                const char *author_end = strchr(author_start, '"');
-                if (author_end) {
-                    size_t len = author_end - author_start;
-                    if (len < sizeof(meta->author)) {
-                        strncpy(meta->author, author_start, len);
-                        meta->author[len] = '\0';
-                    }
-                }
-            }
-        }
-    }
+    get_string(game, "name", meta->name, sizeof(meta->name));
 
-    const char *engine_start = strstr(json, "\"engine\"");
-    if (engine_start) {
-        engine_start = strchr(engine_start, ':');
-        if (engine_start) {
-            engine_start = strchr(engine_start, '"');
-            if (engine_start) {
-                engine_start++;
-                const char *engine_end = strchr(engine_start, '"');
-                if (engine_end) {
-                    size_t len = engine_end - engine_start;
-                    if (len < sizeof(meta->engine)) {
-                        strncpy(meta->engine, engine_start, len);
-                        meta->engine[len] = '\0';
-                    }
-                }
-            }
-        }
-    }
+    // The first lookup indexes the metadata; if that failed it is not JSON
+    if (!game->meta_indexed) return -1;
 
-    const char *entry_start = strstr(json, "\"entrypoint\"");
-    if (entry_start) {
-        entry_start = strchr(entry_start, ':');
-        if (entry_start) {
-            entry_start = strchr(entry_start, '"');
-            if (entry_start) {
-                entry_start++;
-                const char *entry_end = strchr(entry_start, '"');
-                if (entry_end) {
-                    size_t len = entry_end - entry_start;
-                    if (len < sizeof(meta->entrypoint)) {
-                        strncpy(meta->entrypoint, entry_start, len);
-                        meta->entrypoint[len] = '\0';
-                    }
-                }
-            }
-        }
-    }
+    get_string(game, "version", meta->version, sizeof(meta->version));
+    get_string(game, "author", meta->author, sizeof(meta->author));
+    get_string(game, "engine", meta->engine, sizeof(meta->engine));
+    get_string(game, "entrypoint", meta->entrypoint, sizeof(meta->entrypoint));
+
+    // "preload": ["a.png", "b.ogg"]
+    meta->preload_count = parse_list(game, "preload", meta->preload, MAX_PRELOAD);
+
+    // "requires": {"libraries": ["pygame", "numpy"]}
+    meta->library_count = parse_list(game, "requires.libraries", meta->libraries,
+                                     MAX_LIBRARIES);
 
     return 0;
 }
 
-static int extract_game(hackds_file_t *game, const char *dest) {
-    char **filenames;
-    size_t count;
+// Copy up to max strings of an array field; the caller frees them
+static size_t parse_list(hackds_file_t *game, const char *path,
+                         char **items, size_t max) {
+    int count = hackds_get_metadata_array_size(game, path);
+    size_t used = 0;
+
+    for (int i = 0; i < count && used < max; i++) {
+        char item_path[64];
+        snprintf(item_path, sizeof(item_path), "%s.%d", path, i);
 
-    if (hackds_list_files(game, &filenames, &count) != 0) {
-        return -1;
+        char *item = hackds_get_metadata_field(game, item_path);
+        if (item) items[used++] = item;
     }
 
-    for (size_t i = 0; i < count; i++) {
-        uint8_t *data;
-        size_t size;
+    return used;
+}
 
-        if (hackds_extract_file(game, filenames[i], &data, &size) != 0) {
-            fprintf(stderr, "Failed to extract: %s\n", filenames[i]);
-            continue;
-        }
+static void *fill_thread(void *arg) {
+    fill_job_t *job = arg;
+    uint64_t begin = launch_profile_now();
+    uint64_t written = launch_profile_written();
 
-        // Create full path
-        char path[MAX_PATH];
-        snprintf(path, sizeof(path), "%s/%s", dest, filenames[i]);
-
-        // Create parent directories if needed
-        char *slash = strrchr(path, '/');
-        if (slash) {
-            *slash = '\0';
-            char cmd[MAX_PATH + 20];
-            snprintf(cmd, sizeof(cmd), "mkdir -p \"%s\"", path);
-            system(cmd);
-            *slash = '/';
-        }
+    game_cache_finish(job->game, job->game_dir);
 
-        // Write file
-        FILE *fp = fopen(path, "wb");
-        if (fp) {
-            fwrite(data, 1, size, fp);
-            fclose(fp);
-        } else {
-            fprintf(stderr, "Failed to write: %s\n", path);
-        }
+    launch_profile_end(PROFILE_FILL, begin, launch_profile_written() - written);
+    return NULL;
+}
 
-        free(data);
-        free(filenames[i]);
-    }
+static bool setup_shim(const char *game_path) {
+    const char *lib = getenv("HACKDS_PRELOAD_LIB");
+    if (!lib) lib = PRELOAD_LIB;
+    if (!*lib || access(lib, R_OK) != 0) return false;
 
-    free(filenames);
-    return 0;
+    char archive[MAX_PATH];
+    if (!realpath(game_path, archive)) return false;
+
+    snprintf(shim_env[0], sizeof(shim_env[0]), "LD_PRELOAD=%s", lib);
+    snprintf(shim_env[1], sizeof(shim_env[1]), "HACKDS_PRELOAD_ARCHIVE=%s", archive);
+    return true;
+}
+
+// Complete a child environment with the shim variables when it is in use
+static void add_shim_env(char **env, size_t used, const char *game_dir) {
+    if (use_shim) {
+        snprintf(shim_env[2], sizeof(shim_env[2]), "HACKDS_PRELOAD_ROOT=%s", game_dir);
+        for (size_t i = 0; i < 3; i++) env[used++] = shim_env[i];
+    }
+    env[used] = NULL;
 }
 
-static int run_python_game(const char *game_dir, const char *entrypoint) {
+static int run_python_game(const char *game_dir, const game_metadata_t *meta) {
     printf("Starting Python game...\n");
+    const char *entrypoint = meta->entrypoint;
 
     char path[MAX_PATH];
-    snprintf(path, sizeof(path), "%s/%s", game_dir, entrypoint);
+    if (snprintf(path, sizeof(path), "%s/%s", game_dir, entrypoint) >= (int)sizeof(path)) {
+        fprintf(stderr, "Entrypoint path too long\n");
+        return 1;
+    }
+
+    char *env[8] = {
+        "PYTHONPATH=/system/lib/python3.11",
+        "LD_LIBRARY_PATH=/system/lib",
+    };
+    add_shim_env(env, 2, game_dir);
+
+    // A warm interpreter from the zygote saves the interpreter start and
+    // library imports. It cannot load the preload shim into an interpreter
+    // that is already running, so shim launches always start cold.
+    int status;
+    if (!use_shim && zygote_run(game_dir, entrypoint, env, meta->libraries,
+                                meta->library_count, apply_perf, &status) == 0) {
+        return status;
+    }
+
+    int ready[2];
+    open_exec_pipe(ready);
+    uint64_t begin = launch_profile_now();
 
     pid_t pid = fork();
     if (pid < 0) {
         fprintf(stderr, "Fork failed: %s\n", strerror(errno));
+        if (ready[0] >= 0) close(ready[0]);
+        if (ready[1] >= 0) close(ready[1]);
         return 1;
     }
 
     if (pid == 0) {
         // Child process
+        if (ready[0] >= 0) close(ready[0]);
         chdir(game_dir);
+        perf_profile_apply(&perf, 0);
 
         char *args[] = {"python3", (char*)entrypoint, NULL};
-        char *env[] = {
-            "PYTHONPATH=/system/lib/python3.11",
-            "LD_LIBRARY_PATH=/system/lib",
-            NULL
-        };
-
         execve("/system/bin/python3", args, env);
 
         fprintf(stderr, "Failed to execute Python: %s\n", strerror(errno));
@@ -278,40 +366,45 @@ static int run_python_game(const char *game_dir, const char *entrypoint) {
     }
 
     // Parent process - wait for game to finish
-    int status;
-    waitpid(pid, &status, 0);
-
-    if (WIFEXITED(status)) {
-        return WEXITSTATUS(status);
-    }
-
-    return 1;
+    if (ready[1] >= 0) close(ready[1]);
+    return wait_for_game(pid, ready[0], begin);
 }
 
 static int run_cpp_game(const char *game_dir, const char *entrypoint) {
     printf("Starting C++ game...\n");
 
     char path[MAX_PATH];
-    snprintf(path, sizeof(path), "%s/%s", game_dir, entrypoint);
+    if (snprintf(path, sizeof(path), "%s/%s", game_dir, entrypoint) >= (int)sizeof(path)) {
+        fprintf(stderr, "Entrypoint path too long\n");
+        return 1;
+    }
 
     // Make executable
     chmod(path, 0755);
 
+    int ready[2];
+    open_exec_pipe(ready);
+    uint64_t begin = launch_profile_now();
+
     pid_t pid = fork();
     if (pid < 0) {
         fprintf(stderr, "Fork failed: %s\n", strerror(errno));
+        if (ready[0] >= 0) close(ready[0]);
+        if (ready[1] >= 0) close(ready[1]);
         return 1;
     }
 
     if (pid == 0) {
         // Child process
+        if (ready[0] >= 0) close(ready[0]);
         chdir(game_dir);
+        perf_profile_apply(&perf, 0);
 
         char *args[] = {(char*)entrypoint, NULL};
-        char *env[] = {
+        char *env[8] = {
             "LD_LIBRARY_PATH=/system/lib",
-            NULL
         };
+        add_shim_env(env, 1, game_dir);
 
         execve(path, args, env);
 
@@ -320,8 +413,36 @@ static int run_cpp_game(const char *game_dir, const char *entrypoint) {
     }
 
     // Parent process - wait for game to finish
+    if (ready[1] >= 0) close(ready[1]);
+    return wait_for_game(pid, ready[0], begin);
+}
+
+// Zygote games are forked elsewhere and get their profile once running
+static void apply_perf(pid_t pid) {
+    perf_profile_apply(&perf, pid);
+}
+
+// When profiling, a close-on-exec pipe tells the parent the moment the
+// child's execve() succeeds: the write end closes and the read end sees EOF
+static void open_exec_pipe(int fds[2]) {
+    fds[0] = fds[1] = -1;
+    if (launch_profile_enabled() && pipe2(fds, O_CLOEXEC) != 0) {
+        fds[0] = fds[1] = -1;
+    }
+}
+
+static int wait_for_game(pid_t pid, int ready_fd, uint64_t begin) {
+    if (ready_fd >= 0) {
+        char c;
+        while (read(ready_fd, &c, 1) < 0 && errno == EINTR) {}
+        close(ready_fd);
+    }
+    uint64_t started = launch_profile_now();
+    launch_profile_end(PROFILE_EXEC, begin, 0);
+
     int status;
     waitpid(pid, &status, 0);
+    launch_profile_end(PROFILE_EXIT, started, 0);
 
     if (WIFEXITED(status)) {
         return WEXITSTATUS(status);
@@ -0,0 +1,218 @@
+/*
+ * HackDS Game Loader
+ * Launch phase profiling
+ *
+ * Each launch becomes one JSON line appended to the log, so launches from
+ * several loaders never interleave and a script can aggregate them per game:
+ *
+ *   {"game_path":"/games/x.hdsg","status":0,"game":"X","mode":"pipelined",
+ *    "t0_ns":123,"total_us":81234,"peak_rss_kb":5120,"child_peak_rss_kb":40960,
+ *    "phases":{"open":{"start_us":12,"us":40,"bytes":1048576},...}}
+ *
+ * Timestamps are CLOCK_MONOTONIC; start_us is relative to t0_ns, taken when
+ * profiling started. Phases can nest (decompression usually happens inside
+ * extract) and are not meant to be summed.
+ */
+
+#define _GNU_SOURCE
+#include "launch_profile.h"
+#include "../libhackds/hackds_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#define MAX_FIELDS 8
+#define LINE_MAX_LEN 4096
+
+typedef struct {
+    uint64_t start_ns;
+    uint64_t ns;
+    uint64_t bytes;
+} phase_t;
+
+static const char *const phase_names[PROFILE_PHASE_COUNT] = {
+    "open", "header", "metadata", "decompress", "directory",
+    "extract", "exec", "exit", "fill"
+};
+
+static struct {
+    bool enabled;
+    char log_path[512];
+    uint64_t t0;
+    phase_t phases[PROFILE_PHASE_COUNT];
+    hackds_stats_t lib;
+    const char *keys[MAX_FIELDS];
+    char *values[MAX_FIELDS];
+    size_t field_count;
+} profile;
+
+void launch_profile_start(const char *log_path) {
+    snprintf(profile.log_path, sizeof(profile.log_path), "%s", log_path);
+    profile.enabled = true;
+    profile.t0 = launch_profile_now();
+    hackds_set_stats(&profile.lib);
+}
+
+bool launch_profile_enabled(void) {
+    return profile.enabled;
+}
+
+uint64_t launch_profile_now(void) {
+    if (!profile.enabled) return 0;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void launch_profile_end(profile_phase_t phase, uint64_t begin, uint64_t bytes) {
+    if (!profile.enabled || !begin) return;
+
+    phase_t *p = &profile.phases[phase];
+    if (!p->start_ns) p->start_ns = begin;
+    p->ns += launch_profile_now() - begin;
+    p->bytes += bytes;
+}
+
+void launch_profile_set(const char *key, const char *value) {
+    if (!profile.enabled || profile.field_count == MAX_FIELDS) return;
+
+    char *copy = strdup(value);
+    if (!copy) return;
+    profile.keys[profile.field_count] = key;
+    profile.values[profile.field_count] = copy;
+    profile.field_count++;
+}
+
+typedef struct {
+    char buf[LINE_MAX_LEN];
+    size_t len;
+    bool truncated;
+} line_t;
+
+static void append(line_t *line, const char *fmt, ...) {
+    if (line->truncated) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line->buf + line->len, sizeof(line->buf) - line->len, fmt, ap);
+    va_end(ap);
+
+    if (n < 0 || (size_t)n >= sizeof(line->buf) - line->len) {
+        line->truncated = true;
+    } else {
+        line->len += (size_t)n;
+    }
+}
+
+static void append_string(line_t *line, const char *s) {
+    append(line, "\"");
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            append(line, "\\%c", c);
+        } else if (c < 0x20) {
+            append(line, "\\u%04x", c);
+        } else {
+            append(line, "%c", c);
+        }
+    }
+    append(line, "\"");
+}
+
+static void append_phase(line_t *line, const char *name, uint64_t start_ns,
+                         uint64_t ns, uint64_t bytes, bool *first) {
+    if (!start_ns && !bytes) return;
+
+    uint64_t start_us = start_ns > profile.t0 ? (start_ns - profile.t0) / 1000 : 0;
+    append(line, "%s\"%s\":{\"start_us\":%llu,\"us\":%llu,\"bytes\":%llu}",
+           *first ? "" : ",", name, (unsigned long long)start_us,
+           (unsigned long long)(ns / 1000), (unsigned long long)bytes);
+    *first = false;
+}
+
+// Phases before extract are timed inside libhackds; the loader adds its
+// own share, such as parsing the metadata, on top
+static phase_t merged_phase(profile_phase_t phase) {
+    phase_t p = profile.phases[phase];
+    if (phase >= PROFILE_EXTRACT) return p;
+
+    hackds_phase_t lib = (hackds_phase_t)phase;
+    uint64_t lib_start = __atomic_load_n(&profile.lib.start_ns[lib], __ATOMIC_RELAXED);
+    if (lib_start && (!p.start_ns || lib_start < p.start_ns)) p.start_ns = lib_start;
+    p.ns += __atomic_load_n(&profile.lib.ns[lib], __ATOMIC_RELAXED);
+    p.bytes += __atomic_load_n(&profile.lib.bytes[lib], __ATOMIC_RELAXED);
+    return p;
+}
+
+uint64_t launch_profile_written(void) {
+    return __atomic_load_n(&profile.lib.bytes[HACKDS_PHASE_EXTRACT], __ATOMIC_RELAXED);
+}
+
+static int make_parent(const char *path) {
+    char copy[512];
+    snprintf(copy, sizeof(copy), "%s", path);
+    const char *dir = dirname(copy);
+    if (mkdir(dir, 0755) != 0 && access(dir, W_OK) != 0) return -1;
+    return 0;
+}
+
+int launch_profile_write(const char *game_path, int status) {
+    if (!profile.enabled) return 0;
+
+    uint64_t total_ns = launch_profile_now() - profile.t0;
+    hackds_set_stats(NULL);
+
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+
+    line_t line = { .len = 0 };
+    append(&line, "{\"game_path\":");
+    append_string(&line, game_path);
+    append(&line, ",\"status\":%d", status);
+    for (size_t i = 0; i < profile.field_count; i++) {
+        append(&line, ",");
+        append_string(&line, profile.keys[i]);
+        append(&line, ":");
+        append_string(&line, profile.values[i]);
+        free(profile.values[i]);
+    }
+    profile.field_count = 0;
+
+    append(&line, ",\"t0_ns\":%llu,\"total_us\":%llu,\"peak_rss_kb\":%ld,"
+           "\"child_peak_rss_kb\":%ld,\"phases\":{",
+           (unsigned long long)profile.t0, (unsigned long long)(total_ns / 1000),
+           self.ru_maxrss, children.ru_maxrss);
+
+    bool first = true;
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++) {
+        phase_t p = merged_phase((profile_phase_t)i);
+        append_phase(&line, phase_names[i], p.start_ns, p.ns, p.bytes, &first);
+    }
+    append(&line, "}}\n");
+
+    if (line.truncated) {
+        fprintf(stderr, "Warning: launch profile too long, not written\n");
+        return -1;
+    }
+
+    make_parent(profile.log_path);
+    int fd = open(profile.log_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Warning: cannot write launch profile to %s\n", profile.log_path);
+        return -1;
+    }
+
+    // A single append keeps concurrent launches from interleaving
+    ssize_t written = write(fd, line.buf, line.len);
+    close(fd);
+    return written == (ssize_t)line.len ? 0 : -1;
+}
@@ -0,0 +1,50 @@
+/*
+ * HackDS Game Loader
+ * Launch phase profiling
+ */
+
+#ifndef LAUNCH_PROFILE_H
+#define LAUNCH_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LAUNCH_PROFILE_LOG "/var/log/hackds/launch.jsonl"
+
+typedef enum {
+    PROFILE_OPEN,
+    PROFILE_HEADER,
+    PROFILE_METADATA,
+    PROFILE_DECOMPRESS,
+    PROFILE_DIRECTORY,
+    PROFILE_EXTRACT,          // Preparing the game directory
+    PROFILE_EXEC,             // fork() until execve() has succeeded
+    PROFILE_EXIT,             // execve() until the game exits
+    PROFILE_FILL,             // Background extraction while the game runs
+    PROFILE_PHASE_COUNT
+} profile_phase_t;
+
+// Start profiling a launch, appending the result to log_path. Until this is
+// called every other function here does nothing.
+void launch_profile_start(const char *log_path);
+
+bool launch_profile_enabled(void);
+
+// Monotonic timestamp to pass to launch_profile_end(), or 0 when disabled
+uint64_t launch_profile_now(void);
+
+// Record a phase that started at begin. Phases may repeat; their times and
+// bytes add up.
+void launch_profile_end(profile_phase_t phase, uint64_t begin, uint64_t bytes);
+
+// Bytes written out by libhackds extraction so far
+uint64_t launch_profile_written(void);
+
+// Attach a string field ("game", "mode", ...) to the record
+void launch_profile_set(const char *key, const char *value);
+
+// Append the record as one JSON line. Phases timed inside libhackds are
+// taken from its statistics.
+int launch_profile_write(const char *game_path, int status);
+
+#endif // LAUNCH_PROFILE_H
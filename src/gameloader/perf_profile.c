@@ -0,0 +1,407 @@
+/*
+ * HackDS Game Loader
+ * Per-game performance profiles
+ *
+ * The system-wide settings (a cgroup v2 group for the game and the cpufreq
+ * governor) are set up by the loader before the game starts and undone when
+ * it exits. The per-process ones (affinity, nice, scheduling policy) are
+ * applied to the game process itself and end with it. HACKDS_SYSFS_ROOT and
+ * HACKDS_CGROUP_ROOT move the sysfs and cgroup trees, e.g. for testing in a
+ * container; an empty value turns the respective settings off.
+ */
+
+#define _GNU_SOURCE
+#include "perf_profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <glob.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#define CGROUP_PREFIX "hackds-game."
+#define CPU_PERIOD_US 100000
+#define RMDIR_RETRIES 50
+
+typedef struct {
+    const char *name;
+    int policy;
+} policy_name_t;
+
+static const policy_name_t policies[] = {
+    { "other", SCHED_OTHER },
+    { "batch", SCHED_BATCH },
+    { "idle", SCHED_IDLE },
+    { "fifo", SCHED_FIFO },
+    { "rr", SCHED_RR },
+};
+
+static const char *root_dir(const char *env, const char *fallback) {
+    const char *root = getenv(env);
+    return root ? root : fallback;
+}
+
+// Write a string to a sysfs or cgroup file. Async-signal-safe. Creating
+// the file only ever succeeds in a stand-in tree set up for testing.
+static int write_file(const char *path, const char *value) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    size_t len = strlen(value);
+    ssize_t n = write(fd, value, len);
+    int saved = errno;
+    close(fd);
+    errno = saved;
+
+    return n == (ssize_t)len ? 0 : -1;
+}
+
+static int read_file(const char *path, char *buf, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if (n < 0) return -1;
+
+    buf[n] = '\0';
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+// Whether a space-separated list contains word
+static bool has_word(const char *list, const char *word) {
+    size_t len = strlen(word);
+    for (const char *p = list; (p = strstr(p, word)) != NULL; p += len) {
+        if ((p == list || p[-1] == ' ') && (p[len] == '\0' || p[len] == ' ')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Warnings from a forked child cannot use stdio
+static void warn(const char *what) {
+    static const char prefix[] = "Warning: cannot set ";
+    write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+    write(STDERR_FILENO, what, strlen(what));
+    write(STDERR_FILENO, "\n", 1);
+}
+
+static bool get_int(hackds_file_t *game, const char *path, int min, int max,
+                    int *value, bool *valid) {
+    double number;
+    if (hackds_get_metadata_number(game, path, &number) != 0) return false;
+
+    if (number < min || number > max || number != (int)number) {
+        fprintf(stderr, "Warning: %s must be a whole number from %d to %d\n",
+                path, min, max);
+        *valid = false;
+        return false;
+    }
+
+    *value = (int)number;
+    return true;
+}
+
+int perf_profile_parse(hackds_file_t *game, perf_profile_t *profile) {
+    memset(profile, 0, sizeof(*profile));
+
+    // Any lookup tells a missing block apart from one of some other type
+    double unused;
+    if (hackds_get_metadata_number(game, "performance", &unused) != 0 &&
+        hackds_get_error_code() == HACKDS_ERR_NOT_FOUND) {
+        return 0;
+    }
+
+    bool valid = true;
+
+    int count = hackds_get_metadata_array_size(game, "performance.cpus");
+    for (int i = 0; i < count; i++) {
+        char path[64];
+        int cpu;
+        snprintf(path, sizeof(path), "performance.cpus.%d", i);
+        if (get_int(game, path, 0, CPU_SETSIZE - 1, &cpu, &valid)) {
+            CPU_SET(cpu, &profile->cpus);
+            profile->has_cpus = true;
+        }
+    }
+
+    profile->has_nice = get_int(game, "performance.nice", -20, 19,
+                                &profile->nice, &valid);
+
+    char policy[16];
+    if (hackds_get_metadata_string(game, "performance.policy", policy,
+                                   sizeof(policy)) == 0) {
+        for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+            if (strcmp(policy, policies[i].name) == 0) {
+                profile->policy = policies[i].policy;
+                profile->has_policy = true;
+            }
+        }
+        if (!profile->has_policy) {
+            fprintf(stderr, "Warning: unknown scheduling policy: %s\n", policy);
+            valid = false;
+        }
+    }
+
+    // Real-time policies need a priority; the others only take 0
+    if (profile->policy == SCHED_FIFO || profile->policy == SCHED_RR) {
+        profile->priority = 1;
+        get_int(game, "performance.priority", 1, 99, &profile->priority, &valid);
+    }
+
+    int memory_mb = 0;
+    if (get_int(game, "performance.memory_max_mb", 1, 1 << 20, &memory_mb, &valid)) {
+        profile->memory_max = (uint64_t)memory_mb << 20;
+    }
+    get_int(game, "performance.cpu_max_percent", 1, 100 * CPU_SETSIZE,
+            &profile->cpu_max_percent, &valid);
+    get_int(game, "performance.cpu_weight", 1, 10000, &profile->cpu_weight, &valid);
+
+    hackds_get_metadata_string(game, "performance.governor", profile->governor,
+                               sizeof(profile->governor));
+
+    if (!valid) return -1;
+
+    profile->present = true;
+    return 0;
+}
+
+// Enable a controller for the children of the cgroup root if it is not yet
+static bool enable_controller(perf_profile_t *profile, const char *root,
+                              const char *controller) {
+    char path[512], enabled[256];
+    snprintf(path, sizeof(path), "%s/cgroup.subtree_control", root);
+    if (read_file(path, enabled, sizeof(enabled)) != 0) return false;
+    if (has_word(enabled, controller)) return true;
+
+    char change[32];
+    snprintf(change, sizeof(change), "+%s", controller);
+    if (write_file(path, change) != 0) return false;
+
+    size_t used = strlen(profile->enabled_controllers);
+    snprintf(profile->enabled_controllers + used,
+             sizeof(profile->enabled_controllers) - used, "%s%s",
+             used ? " " : "", controller);
+    return true;
+}
+
+static void setup_cgroup(perf_profile_t *profile) {
+    const char *root = root_dir("HACKDS_CGROUP_ROOT", PERF_CGROUP_ROOT);
+    if (!*root) return;
+
+    bool ok = true;
+    if (profile->memory_max) ok = enable_controller(profile, root, "memory");
+    if (ok && (profile->cpu_max_percent || profile->cpu_weight)) {
+        ok = enable_controller(profile, root, "cpu");
+    }
+
+    snprintf(profile->cgroup, sizeof(profile->cgroup), "%s/" CGROUP_PREFIX "%d",
+             root, (int)getpid());
+    if (!ok || (mkdir(profile->cgroup, 0755) != 0 && errno != EEXIST)) {
+        fprintf(stderr, "Warning: cannot create cgroup %s: %s\n",
+                profile->cgroup, strerror(errno));
+        profile->cgroup[0] = '\0';
+        return;
+    }
+
+    char path[576], value[64];
+    if (profile->memory_max) {
+        snprintf(path, sizeof(path), "%s/memory.max", profile->cgroup);
+        snprintf(value, sizeof(value), "%llu", (unsigned long long)profile->memory_max);
+        ok = write_file(path, value) == 0;
+    }
+    if (ok && profile->cpu_max_percent) {
+        snprintf(path, sizeof(path), "%s/cpu.max", profile->cgroup);
+        snprintf(value, sizeof(value), "%d %d",
+                 profile->cpu_max_percent * (CPU_PERIOD_US / 100), CPU_PERIOD_US);
+        ok = write_file(path, value) == 0;
+    }
+    if (ok && profile->cpu_weight) {
+        snprintf(path, sizeof(path), "%s/cpu.weight", profile->cgroup);
+        snprintf(value, sizeof(value), "%d", profile->cpu_weight);
+        ok = write_file(path, value) == 0;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "Warning: cannot set %s: %s\n", path, strerror(errno));
+        rmdir(profile->cgroup);
+        profile->cgroup[0] = '\0';
+    }
+}
+
+static void setup_governor(perf_profile_t *profile) {
+    const char *root = root_dir("HACKDS_SYSFS_ROOT", PERF_SYSFS_ROOT);
+    if (!*root) return;
+
+    char pattern[512];
+    snprintf(pattern, sizeof(pattern),
+             "%s/devices/system/cpu/cpufreq/policy*/scaling_governor", root);
+
+    glob_t found;
+    if (glob(pattern, 0, NULL, &found) != 0) return;
+
+    for (size_t i = 0; i < found.gl_pathc && profile->saved_count < PERF_MAX_POLICIES; i++) {
+        const char *path = found.gl_pathv[i];
+        perf_saved_governor_t *saved = &profile->saved[profile->saved_count];
+
+        char available_path[512], available[256];
+        snprintf(available_path, sizeof(available_path), "%.*s/scaling_available_governors",
+                 (int)(strrchr(path, '/') - path), path);
+        if (read_file(available_path, available, sizeof(available)) == 0 &&
+            !has_word(available, profile->governor)) {
+            fprintf(stderr, "Warning: cpufreq governor %s is not available\n",
+                    profile->governor);
+            break;
+        }
+
+        if (read_file(path, saved->value, sizeof(saved->value)) != 0 ||
+            strcmp(saved->value, profile->governor) == 0) {
+            continue;
+        }
+
+        if (write_file(path, profile->governor) != 0) {
+            fprintf(stderr, "Warning: cannot set %s: %s\n", path, strerror(errno));
+            continue;
+        }
+
+        snprintf(saved->path, sizeof(saved->path), "%s", path);
+        profile->saved_count++;
+    }
+
+    globfree(&found);
+}
+
+void perf_profile_setup(perf_profile_t *profile) {
+    if (!profile->present) return;
+
+    if (profile->memory_max || profile->cpu_max_percent || profile->cpu_weight) {
+        setup_cgroup(profile);
+    }
+    if (profile->governor[0]) {
+        setup_governor(profile);
+    }
+}
+
+// Settings that Linux keeps per thread
+static int apply_thread(const perf_profile_t *profile, pid_t tid) {
+    int failed = 0;
+
+    if (profile->has_cpus &&
+        sched_setaffinity(tid, sizeof(profile->cpus), &profile->cpus) != 0) {
+        warn("CPU affinity");
+        failed++;
+    }
+
+    if (profile->has_nice && setpriority(PRIO_PROCESS, (id_t)tid, profile->nice) != 0) {
+        warn("nice value");
+        failed++;
+    }
+
+    if (profile->has_policy) {
+        struct sched_param param = { .sched_priority = profile->priority };
+        if (sched_setscheduler(tid, profile->policy, &param) != 0) {
+            warn("scheduling policy");
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+int perf_profile_apply(const perf_profile_t *profile, pid_t pid) {
+    if (!profile->present) return 0;
+    int failed = 0;
+
+    // Join the cgroup first so the limits cover everything that follows
+    if (profile->cgroup[0]) {
+        char path[576];
+        char id[16] = "0";
+        strcpy(path, profile->cgroup);
+        strcat(path, "/cgroup.procs");
+        if (pid) snprintf(id, sizeof(id), "%d", (int)pid);
+
+        if (write_file(path, id) != 0) {
+            warn("cgroup");
+            failed++;
+        }
+    }
+
+    if (!pid) {
+        return failed + apply_thread(profile, 0);
+    }
+
+    // A process that is already running may have started threads of its own
+    char task_dir[64];
+    snprintf(task_dir, sizeof(task_dir), "/proc/%d/task", (int)pid);
+    DIR *dir = opendir(task_dir);
+    if (!dir) {
+        return failed + apply_thread(profile, pid);
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            failed += apply_thread(profile, (pid_t)atoi(entry->d_name));
+        }
+    }
+    closedir(dir);
+
+    return failed;
+}
+
+static void remove_cgroup(perf_profile_t *profile) {
+    // Whatever the game left running goes with it
+    for (int i = 0; rmdir(profile->cgroup) != 0; i++) {
+        if (errno != EBUSY || i == RMDIR_RETRIES) {
+            fprintf(stderr, "Warning: cannot remove cgroup %s: %s\n",
+                    profile->cgroup, strerror(errno));
+            break;
+        }
+        if (i == 0) {
+            char path[576];
+            snprintf(path, sizeof(path), "%s/cgroup.kill", profile->cgroup);
+            write_file(path, "1");
+        }
+
+        struct timespec wait = { 0, 10 * 1000 * 1000 };
+        nanosleep(&wait, NULL);
+    }
+    profile->cgroup[0] = '\0';
+
+    // Hand back controllers only this loader turned on; if anything else
+    // started using them meanwhile the kernel refuses and they stay
+    if (profile->enabled_controllers[0]) {
+        const char *root = root_dir("HACKDS_CGROUP_ROOT", PERF_CGROUP_ROOT);
+        char path[512], change[32];
+        snprintf(path, sizeof(path), "%s/cgroup.subtree_control", root);
+
+        char *save = NULL;
+        for (char *name = strtok_r(profile->enabled_controllers, " ", &save); name;
+             name = strtok_r(NULL, " ", &save)) {
+            snprintf(change, sizeof(change), "-%s", name);
+            write_file(path, change);
+        }
+        profile->enabled_controllers[0] = '\0';
+    }
+}
+
+void perf_profile_restore(perf_profile_t *profile) {
+    if (profile->cgroup[0]) {
+        remove_cgroup(profile);
+    }
+
+    for (size_t i = 0; i < profile->saved_count; i++) {
+        if (write_file(profile->saved[i].path, profile->saved[i].value) != 0) {
+            fprintf(stderr, "Warning: cannot restore %s: %s\n",
+                    profile->saved[i].path, strerror(errno));
+        }
+    }
+    profile->saved_count = 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * HackDS Game Loader
+ * Per-game performance profiles
+ */
+
+#ifndef PERF_PROFILE_H
+#define PERF_PROFILE_H
+
+#define _GNU_SOURCE
+#include "../libhackds/hackds_format.h"
+#include <sched.h>
+#include <sys/types.h>
+
+#define PERF_SYSFS_ROOT "/sys"
+#define PERF_CGROUP_ROOT "/sys/fs/cgroup"
+#define PERF_MAX_POLICIES 16
+
+typedef struct {
+    char path[256];
+    char value[32];
+} perf_saved_governor_t;
+
+// The optional "performance" block of game metadata:
+//
+//   "performance": {
+//     "cpus": [2, 3],             CPU affinity
+//     "nice": -5,
+//     "policy": "fifo",           other, batch, idle, fifo or rr
+//     "priority": 10,             Real-time priority for fifo and rr
+//     "memory_max_mb": 256,       cgroup v2 memory.max
+//     "cpu_max_percent": 150,     cgroup v2 cpu.max, 100 = one full CPU
+//     "cpu_weight": 200,          cgroup v2 cpu.weight
+//     "governor": "performance"   cpufreq governor while the game runs
+//   }
+typedef struct {
+    bool present;
+    bool has_cpus;
+    cpu_set_t cpus;
+    bool has_nice;
+    int nice;
+    bool has_policy;
+    int policy;
+    int priority;
+    uint64_t memory_max;      // Bytes, 0 = no limit
+    int cpu_max_percent;      // 0 = no limit
+    int cpu_weight;           // 0 = default
+    char governor[32];
+
+    // State to undo in perf_profile_restore()
+    char cgroup[512];
+    char enabled_controllers[32];
+    perf_saved_governor_t saved[PERF_MAX_POLICIES];
+    size_t saved_count;
+} perf_profile_t;
+
+// Read the performance block. Returns 0, with profile->present false if the
+// game has none, or -1 if it is malformed.
+int perf_profile_parse(hackds_file_t *game, perf_profile_t *profile);
+
+// System-wide part, before the game starts: create the game's cgroup and
+// switch the cpufreq governor. Problems are reported as warnings; the game
+// still runs without them.
+void perf_profile_setup(perf_profile_t *profile);
+
+// Per-process part: affinity, nice, scheduling policy and cgroup membership.
+// pid 0 means the calling process, for use between fork() and execve().
+// Only async-signal-safe calls are made in that case.
+int perf_profile_apply(const perf_profile_t *profile, pid_t pid);
+
+// Undo perf_profile_setup() once the game has exited
+void perf_profile_restore(perf_profile_t *profile);
+
+#endif // PERF_PROFILE_H
@@ -0,0 +1,181 @@
+/*
+ * HackDS Game Loader
+ * Client for the Python zygote
+ *
+ * One connection per game. The request is a list of NUL-terminated strings
+ * ended by an empty one: the protocol name, the game directory, the
+ * entrypoint, "E<name>=<value>" per environment variable and "L<module>"
+ * per required library. The loader's stdin, stdout and stderr travel with
+ * it as SCM_RIGHTS. The zygote answers "pid <pid>" once the game runs and
+ * "exit <code>" or "signal <number>" when it ends.
+ */
+
+#define _GNU_SOURCE
+#include "zygote_client.h"
+#include "launch_profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define PROTOCOL "hackds-zygote 1"
+#define MAX_REQUEST (64 * 1024)
+
+typedef struct {
+    char *buf;
+    size_t len;
+} request_t;
+
+// Append a field, leaving room for the terminating empty string
+static bool add_field(request_t *req, char prefix, const char *value) {
+    size_t len = strlen(value);
+    if (req->len + (prefix ? 1 : 0) + len + 2 > MAX_REQUEST) return false;
+
+    if (prefix) req->buf[req->len++] = prefix;
+    memcpy(req->buf + req->len, value, len + 1);
+    req->len += len + 1;
+    return true;
+}
+
+static int connect_zygote(void) {
+    const char *path = getenv("HACKDS_ZYGOTE_SOCKET");
+    if (!path) path = ZYGOTE_SOCKET;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (!*path || strlen(path) >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int send_request(int fd, const request_t *req) {
+    int stdio[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    union {
+        char buf[CMSG_SPACE(sizeof(stdio))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct iovec iov = { .iov_base = req->buf, .iov_len = req->len };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(stdio));
+    memcpy(CMSG_DATA(cmsg), stdio, sizeof(stdio));
+
+    // The descriptors go with the first chunk, the rest follows plainly
+    ssize_t n;
+    do {
+        n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return -1;
+
+    for (size_t sent = (size_t)n; sent < req->len; sent += (size_t)n) {
+        n = send(fd, req->buf + sent, req->len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                n = 0;
+                continue;
+            }
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Read a "<word> <number>" reply line
+static int read_reply(int fd, char word[16], long *value) {
+    char line[64];
+    size_t len = 0;
+
+    for (;;) {
+        char c;
+        ssize_t n = read(fd, &c, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        if (c == '\n') break;
+        if (len < sizeof(line) - 1) line[len++] = c;
+    }
+    line[len] = '\0';
+
+    return sscanf(line, "%15s %ld", word, value) == 2 ? 0 : -1;
+}
+
+int zygote_run(const char *game_dir, const char *entrypoint, char *const env[],
+               char *const libraries[], size_t library_count,
+               void (*started)(pid_t pid), int *status) {
+    int fd = connect_zygote();
+    if (fd < 0) return -1;
+
+    request_t req = { .buf = malloc(MAX_REQUEST), .len = 0 };
+    bool built = req.buf &&
+                 add_field(&req, 0, PROTOCOL) &&
+                 add_field(&req, 0, game_dir) &&
+                 add_field(&req, 0, entrypoint);
+    for (size_t i = 0; built && env[i]; i++) {
+        built = add_field(&req, 'E', env[i]);
+    }
+    for (size_t i = 0; built && i < library_count; i++) {
+        built = add_field(&req, 'L', libraries[i]);
+    }
+
+    // Whatever the loader printed must come out before the game's output
+    fflush(stdout);
+    fflush(stderr);
+
+    uint64_t begin = launch_profile_now();
+    char word[16];
+    long value;
+    bool running = false;
+
+    if (!built) {
+        fprintf(stderr, "Warning: zygote request too large\n");
+    } else {
+        req.buf[req.len++] = '\0';
+        running = send_request(fd, &req) == 0 &&
+                  read_reply(fd, word, &value) == 0 && strcmp(word, "pid") == 0;
+    }
+    free(req.buf);
+
+    if (!running) {
+        close(fd);
+        return -1;
+    }
+
+    launch_profile_end(PROFILE_EXEC, begin, 0);
+    if (started) started((pid_t)value);
+    begin = launch_profile_now();
+
+    // From here on the game runs; if the zygote goes away mid-game its
+    // status is lost
+    *status = 1;
+    if (read_reply(fd, word, &value) != 0) {
+        fprintf(stderr, "Warning: lost contact with the Python zygote\n");
+    } else if (strcmp(word, "exit") == 0) {
+        *status = (int)value;
+    }
+
+    launch_profile_end(PROFILE_EXIT, begin, 0);
+    close(fd);
+    return 0;
+}
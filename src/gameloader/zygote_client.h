@@ -0,0 +1,30 @@
+/*
+ * HackDS Game Loader
+ * Client for the Python zygote
+ */
+
+#ifndef ZYGOTE_CLIENT_H
+#define ZYGOTE_CLIENT_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define ZYGOTE_SOCKET "/run/hackds/zygote.sock"
+
+// Run a Python game in a process forked from the resident zygote
+// (hackds-zygote), which already has the usual libraries imported. The game
+// shares the loader's stdin, stdout and stderr and gets env as its
+// environment; libraries are the modules it requires, which the zygote
+// preloads for later launches.
+//
+// started, if not NULL, is called with the game's pid as soon as it runs.
+//
+// Returns 0 once the game has run, with its exit status in *status, and -1
+// if the zygote could not start it, in which case the caller should launch
+// the game itself. HACKDS_ZYGOTE_SOCKET overrides the socket path; an empty
+// value disables the zygote.
+int zygote_run(const char *game_dir, const char *entrypoint, char *const env[],
+               char *const libraries[], size_t library_count,
+               void (*started)(pid_t pid), int *status);
+
+#endif // ZYGOTE_CLIENT_H
@@ -3,6 +3,7 @@
  * Minimal init process for HackDS gaming OS
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -10,23 +11,42 @@
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <sys/reboot.h>
+#include <sys/sysmacros.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 
 #define VERSION "0.1.0"
+#define ZYGOTE_MIN_UPTIME 10      // Seconds; a zygote that dies sooner failed
+#define ZYGOTE_MAX_FAILURES 5     // Failed starts in a row before giving up
 
 static void mount_filesystems(void);
 static void setup_environment(void);
 static void spawn_menu(void);
+static time_t monotonic_seconds(void);
+static void spawn_zygote(void);
+static void check_zygote(void);
 static void reap_zombies(int sig);
 static void handle_shutdown(int sig);
 
 static volatile int shutting_down = 0;
-static pid_t menu_pid = -1;
+static volatile pid_t menu_pid = -1;
+static volatile pid_t zygote_pid = -1;
+
+// Set by the SIGCHLD handler, which reaps every child
+static volatile sig_atomic_t menu_exited = 0;
+static volatile sig_atomic_t zygote_exited = 0;
+
+static time_t zygote_started;
+static time_t zygote_retry_at;    // 0 while no respawn is pending
+static int zygote_failures;
 
 int main(int argc, char *argv[]) {
+    (void)argc;
+    (void)argv;
+
     printf("HackDS Init v%s starting...\n", VERSION);
 
     // We must be PID 1
@@ -56,6 +76,10 @@ int main(int argc, char *argv[]) {
 
     printf("HackDS Init: System initialized\n");
 
+    // Start the Python zygote first so it has its libraries imported by
+    // the time the first game is picked
+    spawn_zygote();
+
     // Launch the game menu
     spawn_menu();
 
@@ -64,15 +88,14 @@ int main(int argc, char *argv[]) {
         sleep(1);
 
         // Check if menu crashed
-        if (menu_pid > 0) {
-            int status;
-            pid_t result = waitpid(menu_pid, &status, WNOHANG);
-            if (result > 0) {
-                printf("Menu process exited, respawning...\n");
-                sleep(1);
-                spawn_menu();
-            }
+        if (menu_exited) {
+            menu_exited = 0;
+            printf("Menu process exited, respawning...\n");
+            sleep(1);
+            spawn_menu();
         }
+
+        check_zygote();
     }
 
     // Shutdown sequence
@@ -84,6 +107,11 @@ int main(int argc, char *argv[]) {
         waitpid(menu_pid, NULL, 0);
     }
 
+    if (zygote_pid > 0) {
+        kill(zygote_pid, SIGTERM);
+        waitpid(zygote_pid, NULL, 0);
+    }
+
     // Unmount filesystems
     umount("/proc");
     umount("/sys");
@@ -148,8 +176,29 @@ static void setup_environment(void) {
     chmod("/tmp", 01777);
 }
 
+static time_t monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+// Fork with SIGCHLD blocked until the child's pid is recorded, so the
+// handler cannot miss a child that exits straight away
+static pid_t fork_child(volatile pid_t *pid) {
+    sigset_t chld, old;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &old);
+
+    *pid = fork();
+    pid_t result = *pid;
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    return result;
+}
+
 static void spawn_menu(void) {
-    menu_pid = fork();
+    fork_child(&menu_pid);
 
     if (menu_pid < 0) {
         fprintf(stderr, "Failed to fork menu process: %s\n", strerror(errno));
@@ -177,10 +226,72 @@ static void spawn_menu(void) {
     printf("Menu spawned with PID %d\n", menu_pid);
 }
 
+static void spawn_zygote(void) {
+    zygote_started = monotonic_seconds();
+    fork_child(&zygote_pid);
+
+    if (zygote_pid < 0) {
+        fprintf(stderr, "Failed to fork Python zygote: %s\n", strerror(errno));
+        zygote_exited = 1;    // Counts as a failed start
+        return;
+    }
+
+    if (zygote_pid == 0) {
+        // Same environment the game loader gives Python games
+        char *args[] = {"python3", "/system/bin/hackds-zygote", NULL};
+        char *env[] = {
+            "PATH=/system/bin:/usr/bin:/bin",
+            "HOME=/",
+            "PYTHONPATH=/system/lib/python3.11",
+            "LD_LIBRARY_PATH=/system/lib",
+            NULL
+        };
+
+        execve("/system/bin/python3", args, env);
+
+        fprintf(stderr, "Failed to execute Python zygote: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    printf("Python zygote spawned with PID %d\n", zygote_pid);
+}
+
+// Respawn the zygote after it exits. A zygote that keeps dying right after
+// start (python3 or its socket directory broken) is retried with growing
+// delays and then left alone; Python games still start without it.
+static void check_zygote(void) {
+    time_t now = monotonic_seconds();
+
+    if (zygote_exited) {
+        zygote_exited = 0;
+        zygote_pid = -1;
+
+        zygote_failures = now - zygote_started < ZYGOTE_MIN_UPTIME ? zygote_failures + 1 : 0;
+        if (zygote_failures >= ZYGOTE_MAX_FAILURES) {
+            printf("Python zygote keeps failing, not respawning it\n");
+            return;
+        }
+
+        time_t delay = (time_t)1 << zygote_failures;
+        printf("Python zygote exited, respawning in %ld s...\n", (long)delay);
+        zygote_retry_at = now + delay;
+    }
+
+    if (zygote_retry_at != 0 && now >= zygote_retry_at) {
+        zygote_retry_at = 0;
+        spawn_zygote();
+    }
+}
+
 static void reap_zombies(int sig) {
     (void)sig;
-    while (waitpid(-1, NULL, WNOHANG) > 0)
-        ;
+    int saved_errno = errno;
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        if (pid == menu_pid) menu_exited = 1;
+        if (pid == zygote_pid) zygote_exited = 1;
+    }
+    errno = saved_errno;
 }
 
 static void handle_shutdown(int sig) {
@@ -0,0 +1,218 @@
+/*
+ * HackDS File Format Library
+ * CRC32 with hardware acceleration where the CPU provides it
+ *
+ * All paths compute the standard (zlib) CRC32. ARMv8 has dedicated CRC32
+ * instructions for this polynomial; x86 folds 64 bytes at a time with
+ * carry-less multiplication (Intel, "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction"). Everything else uses zlib.
+ */
+
+#define _GNU_SOURCE
+#include "hackds_format.h"
+#include <zlib.h>
+
+#if defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+typedef uint32_t (*crc_fn)(uint32_t crc, const uint8_t *data, size_t length);
+
+static uint32_t crc32_zlib(uint32_t crc, const uint8_t *data, size_t length) {
+    // zlib takes a 32-bit length on some platforms
+    while (length > 0) {
+        uInt chunk = length > (1u << 30) ? (1u << 30) : (uInt)length;
+        crc = crc32(crc, data, chunk);
+        data += chunk;
+        length -= chunk;
+    }
+    return crc;
+}
+
+#if defined(__aarch64__)
+
+__attribute__((target("+crc")))
+static uint32_t crc32_armv8(uint32_t crc, const uint8_t *data, size_t length) {
+    uint32_t c = ~crc;
+
+    while (length > 0 && ((uintptr_t)data & 7)) {
+        c = __crc32b(c, *data++);
+        length--;
+    }
+
+    const uint64_t *words = (const uint64_t*)data;
+    while (length >= 32) {
+        c = __crc32d(c, words[0]);
+        c = __crc32d(c, words[1]);
+        c = __crc32d(c, words[2]);
+        c = __crc32d(c, words[3]);
+        words += 4;
+        length -= 32;
+    }
+    while (length >= 8) {
+        c = __crc32d(c, *words++);
+        length -= 8;
+    }
+
+    data = (const uint8_t*)words;
+    while (length > 0) {
+        c = __crc32b(c, *data++);
+        length--;
+    }
+
+    return ~c;
+}
+
+static crc_fn select_crc(void) {
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) return crc32_armv8;
+    return crc32_zlib;
+}
+
+#elif defined(__x86_64__) || defined(__i386__)
+
+// Fold constants for the bit-reflected CRC32 polynomial
+static const uint64_t __attribute__((aligned(16))) k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+static const uint64_t __attribute__((aligned(16))) k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+static const uint64_t __attribute__((aligned(16))) k5k0[] = { 0x0163cd6124, 0x0000000000 };
+static const uint64_t __attribute__((aligned(16))) poly[] = { 0x01db710641, 0x01f7011641 };
+
+// Fold a buffer of at least 64 bytes, length a multiple of 16. Works on the
+// inverted CRC register like the reference implementation.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t fold_pclmul(uint32_t reg, const uint8_t *data, size_t length) {
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)reg));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+
+    data += 64;
+    length -= 64;
+
+    // Fold four lanes of 64 bytes in parallel
+    while (length >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        data += 64;
+        length -= 64;
+    }
+
+    // Fold the four lanes into one
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Remaining 16-byte blocks
+    while (length >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)data);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        data += 16;
+        length -= 16;
+    }
+
+    // 128 -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i*)poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t *data, size_t length) {
+    if (length < 64) return crc32_zlib(crc, data, length);
+
+    size_t folded = length & ~(size_t)15;
+    crc = ~fold_pclmul(~crc, data, folded);
+
+    return crc32_zlib(crc, data + folded, length - folded);
+}
+
+static crc_fn select_crc(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+        return crc32_pclmul;
+    }
+    return crc32_zlib;
+}
+
+#else
+
+static crc_fn select_crc(void) {
+    return crc32_zlib;
+}
+
+#endif
+
+uint32_t hackds_crc32_update(uint32_t crc, const uint8_t *data, size_t length) {
+    static crc_fn impl = NULL;
+
+    // Benign race: every thread selects the same function
+    crc_fn fn = __atomic_load_n(&impl, __ATOMIC_RELAXED);
+    if (!fn) {
+        fn = select_crc();
+        __atomic_store_n(&impl, fn, __ATOMIC_RELAXED);
+    }
+
+    return fn(crc, data, length);
+}
+
+uint32_t hackds_crc32(const uint8_t *data, size_t length) {
+    return hackds_crc32_update(0, data, length);
+}
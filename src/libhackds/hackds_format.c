@@ -3,27 +3,77 @@
  * Implementation
  */
 
+#define _GNU_SOURCE
 #include "hackds_format.h"
+#include "hackds_internal.h"
+#include "hackds_pool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <zlib.h>
+#ifdef HACKDS_WITH_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#ifdef HACKDS_WITH_ZSTD
+#include <zstd.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <time.h>
 
-static char error_buffer[256] = {0};
+// Error state is per thread so that handles can be used concurrently
+static __thread char error_buffer[256] = {0};
+static __thread hackds_error_t error_code = HACKDS_OK;
 
-static void set_error(const char *msg) {
+static void set_error(hackds_error_t code, const char *msg) {
+    error_code = code;
     snprintf(error_buffer, sizeof(error_buffer), "%s", msg);
 }
 
+void hackds_set_error(hackds_error_t code, const char *msg) {
+    set_error(code, msg);
+}
+
 const char* hackds_get_error(void) {
     return error_buffer;
 }
 
-// CRC32 calculation using zlib
-uint32_t hackds_crc32(const uint8_t *data, size_t length) {
-    return crc32(0L, data, length);
+hackds_error_t hackds_get_error_code(void) {
+    return error_code;
+}
+
+static hackds_stats_t *stats;  // Installed by hackds_set_stats()
+
+void hackds_set_stats(hackds_stats_t *s) {
+    __atomic_store_n(&stats, s, __ATOMIC_RELEASE);
+}
+
+// Start of a timed phase, or 0 when nobody is collecting
+static uint64_t stats_clock(void) {
+    if (!__atomic_load_n(&stats, __ATOMIC_ACQUIRE)) return 0;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Add a phase that began at begin (0 records only bytes)
+static void stats_record(hackds_phase_t phase, uint64_t begin, uint64_t bytes) {
+    hackds_stats_t *s = __atomic_load_n(&stats, __ATOMIC_ACQUIRE);
+    if (!s) return;
+
+    if (begin) {
+        uint64_t first = 0;
+        __atomic_compare_exchange_n(&s->start_ns[phase], &first, begin, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        uint64_t now = stats_clock();
+        if (now > begin) __atomic_add_fetch(&s->ns[phase], now - begin, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch(&s->bytes[phase], bytes, __ATOMIC_RELAXED);
 }
 
 hackds_file_type_t hackds_get_type(uint32_t magic) {
@@ -36,44 +86,21 @@ hackds_file_type_t hackds_get_type(uint32_t magic) {
     }
 }
 
-hackds_file_t* hackds_open(const char *path) {
-    FILE *fp = fopen(path, "rb");
-    if (!fp) {
-        set_error("Failed to open file");
-        return NULL;
-    }
-
-    // Allocate file structure
-    hackds_file_t *file = calloc(1, sizeof(hackds_file_t));
-    if (!file) {
-        set_error("Memory allocation failed");
-        fclose(fp);
-        return NULL;
-    }
-
-    // Read header
-    if (fread(&file->header, sizeof(hackds_header_t), 1, fp) != 1) {
-        set_error("Failed to read header");
-        free(file);
-        fclose(fp);
-        return NULL;
-    }
+// Validate magic, version and checksum of a freshly read header
+static int check_header(hackds_file_t *file) {
+    uint64_t begin = stats_clock();
 
     // Validate magic number
     file->type = hackds_get_type(file->header.magic);
     if (file->type == HACKDS_TYPE_UNKNOWN) {
-        set_error("Invalid magic number");
-        free(file);
-        fclose(fp);
-        return NULL;
+        set_error(HACKDS_ERR_FORMAT, "Invalid magic number");
+        return -1;
     }
 
     // Validate version
     if (file->header.version_major != HACKDS_VERSION_MAJOR) {
-        set_error("Unsupported format version");
-        free(file);
-        fclose(fp);
-        return NULL;
+        set_error(HACKDS_ERR_UNSUPPORTED, "Unsupported format version");
+        return -1;
     }
 
     // Validate header checksum
@@ -83,38 +110,157 @@ hackds_file_t* hackds_open(const char *path) {
     file->header.header_crc = saved_crc;
 
     if (calc_crc != saved_crc) {
-        set_error("Header checksum mismatch");
+        set_error(HACKDS_ERR_CHECKSUM, "Header checksum mismatch");
+        return -1;
+    }
+
+    stats_record(HACKDS_PHASE_HEADER, begin, sizeof(hackds_header_t));
+    return 0;
+}
+
+static hackds_codec_t payload_codec(const hackds_file_t *file) {
+    return (hackds_codec_t)((file->header.flags & FLAG_CODEC_MASK) >> FLAG_CODEC_SHIFT);
+}
+
+static bool is_blocked(const hackds_file_t *file) {
+    return (file->header.flags & (FLAG_COMPRESSED | FLAG_BLOCKED)) ==
+           (FLAG_COMPRESSED | FLAG_BLOCKED);
+}
+
+// Read the block table at the start of a block-compressed payload:
+// block size (4), block count (4), then block_count + 1 offsets (8 each)
+// into the compressed data that follows the table
+static int load_block_table(hackds_file_t *file) {
+    uint64_t size = file->header.payload_size;
+    uint32_t block_size, block_count;
+
+    if (size < 8) {
+        set_error(HACKDS_ERR_FORMAT, "Invalid block table");
+        return -1;
+    }
+    memcpy(&block_size, file->payload, 4);
+    memcpy(&block_count, file->payload + 4, 4);
+
+    uint64_t table_size = 8 + ((uint64_t)block_count + 1) * 8;
+    uint64_t expected_count = block_size ?
+        (file->header.uncompressed_size + block_size - 1) / block_size : 0;
+    if (block_size == 0 || table_size > size || expected_count != block_count) {
+        set_error(HACKDS_ERR_FORMAT, "Invalid block table");
+        return -1;
+    }
+
+    if (!hackds_codec_supported(payload_codec(file))) {
+        set_error(HACKDS_ERR_UNSUPPORTED, "Unsupported compression codec");
+        return -1;
+    }
+
+    hackds_block_table_t *blocks = calloc(1, sizeof(hackds_block_table_t));
+    if (!blocks) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        return -1;
+    }
+
+    blocks->offsets = malloc(((size_t)block_count + 1) * sizeof(uint64_t));
+    if (!blocks->offsets) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        free(blocks);
+        return -1;
+    }
+    memcpy(blocks->offsets, file->payload + 8, ((size_t)block_count + 1) * 8);
+
+    for (uint32_t i = 0; i < block_count; i++) {
+        if (blocks->offsets[i] > blocks->offsets[i + 1]) {
+            set_error(HACKDS_ERR_FORMAT, "Invalid block table");
+            free(blocks->offsets);
+            free(blocks);
+            return -1;
+        }
+    }
+    if (blocks->offsets[block_count] > size - table_size) {
+        set_error(HACKDS_ERR_FORMAT, "Invalid block table");
+        free(blocks->offsets);
+        free(blocks);
+        return -1;
+    }
+
+    blocks->block_size = block_size;
+    blocks->block_count = block_count;
+    blocks->data = file->payload + table_size;
+    blocks->cache_index = UINT32_MAX;
+    pthread_mutex_init(&blocks->cache_lock, NULL);
+    file->blocks = blocks;
+
+    return 0;
+}
+
+// Read and validate the header and metadata block, leaving the stream
+// positioned at the start of the payload
+static hackds_file_t* read_header_and_metadata(FILE *fp) {
+    // Allocate file structure
+    hackds_file_t *file = calloc(1, sizeof(hackds_file_t));
+    if (!file) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        return NULL;
+    }
+    pthread_mutex_init(&file->lock, NULL);
+
+    // Read header
+    if (fread(&file->header, sizeof(hackds_header_t), 1, fp) != 1) {
+        set_error(HACKDS_ERR_IO, "Failed to read header");
+        free(file);
+        return NULL;
+    }
+
+    if (check_header(file) != 0) {
         free(file);
-        fclose(fp);
         return NULL;
     }
 
     // Read metadata
+    uint64_t begin = stats_clock();
     if (file->header.metadata_size > 0) {
         file->metadata = malloc(file->header.metadata_size + 1);
         if (!file->metadata) {
-            set_error("Memory allocation failed");
+            set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
             free(file);
-            fclose(fp);
             return NULL;
         }
 
         if (fread(file->metadata, file->header.metadata_size, 1, fp) != 1) {
-            set_error("Failed to read metadata");
+            set_error(HACKDS_ERR_IO, "Failed to read metadata");
             free(file->metadata);
             free(file);
-            fclose(fp);
             return NULL;
         }
 
         file->metadata[file->header.metadata_size] = '\0';
     }
+    stats_record(HACKDS_PHASE_METADATA, begin, file->header.metadata_size);
+
+    return file;
+}
+
+hackds_file_t* hackds_open(const char *path) {
+    uint64_t begin = stats_clock();
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        set_error(HACKDS_ERR_IO, "Failed to open file");
+        return NULL;
+    }
+    stats_record(HACKDS_PHASE_OPEN, begin, 0);
+
+    hackds_file_t *file = read_header_and_metadata(fp);
+    if (!file) {
+        fclose(fp);
+        return NULL;
+    }
 
     // Read payload
     if (file->header.payload_size > 0) {
+        begin = stats_clock();
         file->payload = malloc(file->header.payload_size);
         if (!file->payload) {
-            set_error("Memory allocation failed");
+            set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
             free(file->metadata);
             free(file);
             fclose(fp);
@@ -122,22 +268,34 @@ hackds_file_t* hackds_open(const char *path) {
         }
 
         if (fread(file->payload, file->header.payload_size, 1, fp) != 1) {
-            set_error("Failed to read payload");
+            set_error(HACKDS_ERR_IO, "Failed to read payload");
             free(file->payload);
             free(file->metadata);
             free(file);
             fclose(fp);
             return NULL;
         }
+        stats_record(HACKDS_PHASE_OPEN, begin, file->header.payload_size);
 
-        // Decompress if needed
-        if (file->header.flags & FLAG_COMPRESSED) {
+        // Decompress if needed. Block-compressed payloads stay compressed
+        // and are inflated block by block on access.
+        if (is_blocked(file)) {
+            if (load_block_table(file) != 0) {
+                free(file->payload);
+                free(file->metadata);
+                free(file);
+                fclose(fp);
+                return NULL;
+            }
+        } else if (file->header.flags & FLAG_COMPRESSED) {
             uint8_t *decompressed = NULL;
             size_t decompressed_size = 0;
+            begin = stats_clock();
 
-            if (hackds_decompress(file->payload, file->header.payload_size,
-                                  &decompressed, &decompressed_size) != 0) {
-                set_error("Decompression failed");
+            if (hackds_decompress_codec(payload_codec(file),
+                                        file->payload, file->header.payload_size,
+                                        &decompressed, &decompressed_size,
+                                        file->header.uncompressed_size) != 0) {
                 free(file->payload);
                 free(file->metadata);
                 free(file);
@@ -148,6 +306,7 @@ hackds_file_t* hackds_open(const char *path) {
             free(file->payload);
             file->payload = decompressed;
             file->header.payload_size = decompressed_size;
+            stats_record(HACKDS_PHASE_DECOMPRESS, begin, decompressed_size);
         }
     }
 
@@ -157,11 +316,160 @@ hackds_file_t* hackds_open(const char *path) {
     return file;
 }
 
+hackds_file_t* hackds_open_mapped(const char *path) {
+    uint64_t begin = stats_clock();
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        set_error(HACKDS_ERR_IO, "Failed to open file");
+        return NULL;
+    }
+
+    // Pipes, character devices and friends cannot be mapped
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        (uint64_t)st.st_size < sizeof(hackds_header_t)) {
+        close(fd);
+        return hackds_open(path);
+    }
+
+    size_t map_size = (size_t)st.st_size;
+    uint8_t *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return hackds_open(path);
+    }
+
+    hackds_file_t *file = calloc(1, sizeof(hackds_file_t));
+    if (!file) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        munmap(map, map_size);
+        return NULL;
+    }
+    pthread_mutex_init(&file->lock, NULL);
+    stats_record(HACKDS_PHASE_OPEN, begin, map_size);
+
+    memcpy(&file->header, map, sizeof(hackds_header_t));
+    if (check_header(file) != 0) {
+        free(file);
+        munmap(map, map_size);
+        return NULL;
+    }
+
+    uint64_t metadata_offset = sizeof(hackds_header_t);
+    uint64_t payload_offset = metadata_offset + file->header.metadata_size;
+    if (payload_offset + file->header.payload_size > map_size ||
+        payload_offset + file->header.payload_size < payload_offset) {
+        set_error(HACKDS_ERR_FORMAT, "File is truncated");
+        free(file);
+        munmap(map, map_size);
+        return NULL;
+    }
+
+    // Metadata is tiny and callers expect a terminated string, so it is
+    // still copied out of the mapping
+    begin = stats_clock();
+    if (file->header.metadata_size > 0) {
+        file->metadata = malloc(file->header.metadata_size + 1);
+        if (!file->metadata) {
+            set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+            free(file);
+            munmap(map, map_size);
+            return NULL;
+        }
+
+        memcpy(file->metadata, map + metadata_offset, file->header.metadata_size);
+        file->metadata[file->header.metadata_size] = '\0';
+    }
+    stats_record(HACKDS_PHASE_METADATA, begin, file->header.metadata_size);
+
+    if (file->header.payload_size > 0) {
+        if (is_blocked(file)) {
+            // Blocks are inflated straight out of the mapping on access
+            file->payload = map + payload_offset;
+            file->map = map;
+            file->map_size = map_size;
+
+            if (load_block_table(file) != 0) {
+                free(file->metadata);
+                free(file);
+                munmap(map, map_size);
+                return NULL;
+            }
+        } else if (file->header.flags & FLAG_COMPRESSED) {
+            // Solid compressed payloads are inflated into private memory; the
+            // mapping is not needed past this point
+            uint8_t *decompressed = NULL;
+            size_t decompressed_size = 0;
+            begin = stats_clock();
+
+            if (hackds_decompress_codec(payload_codec(file),
+                                        map + payload_offset,
+                                        file->header.payload_size,
+                                        &decompressed, &decompressed_size,
+                                        file->header.uncompressed_size) != 0) {
+                free(file->metadata);
+                free(file);
+                munmap(map, map_size);
+                return NULL;
+            }
+
+            munmap(map, map_size);
+            file->payload = decompressed;
+            file->header.payload_size = decompressed_size;
+            stats_record(HACKDS_PHASE_DECOMPRESS, begin, decompressed_size);
+        } else {
+            file->payload = map + payload_offset;
+            file->map = map;
+            file->map_size = map_size;
+        }
+    } else {
+        munmap(map, map_size);
+    }
+
+    file->loaded = true;
+
+    return file;
+}
+
+hackds_file_t* hackds_open_header(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        set_error(HACKDS_ERR_IO, "Failed to open file");
+        return NULL;
+    }
+
+    // Only the header and metadata are read; the payload is never touched
+    hackds_file_t *file = read_header_and_metadata(fp);
+    fclose(fp);
+
+    return file;
+}
+
+char* hackds_peek_metadata(const char *path) {
+    hackds_file_t *file = hackds_open_header(path);
+    if (!file) return NULL;
+
+    char *metadata = file->metadata;
+    file->metadata = NULL;
+    hackds_close(file);
+
+    if (!metadata) {
+        set_error(HACKDS_ERR_FORMAT, "File has no metadata");
+    }
+
+    return metadata;
+}
+
 void hackds_close(hackds_file_t *file) {
     if (!file) return;
 
     if (file->metadata) free(file->metadata);
-    if (file->payload) free(file->payload);
+    if (file->map) {
+        // Payload is a view into the mapping
+        munmap(file->map, file->map_size);
+    } else if (file->payload) {
+        free(file->payload);
+    }
 
     if (file->files) {
         for (size_t i = 0; i < file->file_count; i++) {
@@ -170,63 +478,175 @@ void hackds_close(hackds_file_t *file) {
         }
         free(file->files);
     }
+    free(file->index);
+    free(file->meta_tokens);
+
+    if (file->blocks) {
+        free(file->blocks->offsets);
+        free(file->blocks->cache);
+        pthread_mutex_destroy(&file->blocks->cache_lock);
+        free(file->blocks);
+    }
 
+    pthread_mutex_destroy(&file->lock);
     free(file);
 }
 
-bool hackds_validate(hackds_file_t *file) {
-    if (!file || !file->loaded) return false;
+const char* hackds_get_metadata(hackds_file_t *file) {
+    if (!file) return NULL;
+    return file->metadata;
+}
 
-    // Header was already validated during load
-    // Could add additional validation here
+// Tokenize the metadata once per handle
+static int ensure_meta_indexed(hackds_file_t *file) {
+    if (__atomic_load_n(&file->meta_indexed, __ATOMIC_ACQUIRE)) return 0;
+    if (!file->metadata) {
+        set_error(HACKDS_ERR_FORMAT, "File has no metadata");
+        return -1;
+    }
 
-    return true;
+    int ret = 0;
+    pthread_mutex_lock(&file->lock);
+    if (!file->meta_indexed) {
+        // Typical metadata fits on the stack, which saves a counting pass
+        uint64_t begin = stats_clock();
+        size_t len = strlen(file->metadata);
+        hackds_json_token_t stack[128];
+        int count = hackds_json_parse(file->metadata, len, stack, 128);
+        if (count == HACKDS_JSON_ENOMEM) {
+            count = hackds_json_parse(file->metadata, len, NULL, 0);
+        }
+        hackds_json_token_t *tokens = NULL;
+
+        if (count < 0) {
+            set_error(HACKDS_ERR_FORMAT, "Malformed metadata JSON");
+            ret = -1;
+        } else if (!(tokens = malloc((size_t)count * sizeof(*tokens)))) {
+            set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+            ret = -1;
+        } else {
+            if (count <= 128) {
+                memcpy(tokens, stack, (size_t)count * sizeof(*tokens));
+            } else {
+                hackds_json_parse(file->metadata, len, tokens, count);
+            }
+            file->meta_tokens = tokens;
+            file->meta_token_count = count;
+            __atomic_store_n(&file->meta_indexed, true, __ATOMIC_RELEASE);
+            stats_record(HACKDS_PHASE_METADATA, begin, 0);
+        }
+    }
+    pthread_mutex_unlock(&file->lock);
+
+    return ret;
 }
 
-const char* hackds_get_metadata(hackds_file_t *file) {
-    if (!file) return NULL;
-    return file->metadata;
+static const hackds_json_token_t* find_meta(hackds_file_t *file, const char *path) {
+    if (!file || !path) return NULL;
+    if (ensure_meta_indexed(file) != 0) return NULL;
+
+    int i = hackds_json_find(file->metadata, file->meta_tokens,
+                             file->meta_token_count, 0, path);
+    if (i < 0) {
+        set_error(HACKDS_ERR_NOT_FOUND, "Metadata field not found");
+        return NULL;
+    }
+    return &file->meta_tokens[i];
 }
 
-int hackds_decompress(const uint8_t *in, size_t in_size,
-                      uint8_t **out, size_t *out_size) {
-    // Start with a reasonable output size
-    size_t buf_size = in_size * 4;
-    uint8_t *buffer = malloc(buf_size);
-    if (!buffer) return -1;
+char* hackds_get_metadata_field(hackds_file_t *file, const char *field) {
+    const hackds_json_token_t *tok = find_meta(file, field);
+    if (!tok) return NULL;
 
-    z_stream stream;
-    stream.zalloc = Z_NULL;
-    stream.zfree = Z_NULL;
-    stream.opaque = Z_NULL;
-    stream.avail_in = in_size;
-    stream.next_in = (Bytef*)in;
-    stream.avail_out = buf_size;
-    stream.next_out = buffer;
+    // Unescaping never makes a string longer
+    size_t len = (size_t)(tok->end - tok->start) + 1;
+    char *value = malloc(len);
+    if (!value) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        return NULL;
+    }
+    hackds_json_unescape(file->metadata, tok, value, len);
+    return value;
+}
 
-    if (inflateInit(&stream) != Z_OK) {
-        free(buffer);
+int hackds_get_metadata_string(hackds_file_t *file, const char *path,
+                               char *buf, size_t len) {
+    const hackds_json_token_t *tok = find_meta(file, path);
+    if (!tok) return -1;
+
+    if (tok->type != HACKDS_JSON_STRING) {
+        set_error(HACKDS_ERR_FORMAT, "Metadata field is not a string");
+        return -1;
+    }
+    if (hackds_json_unescape(file->metadata, tok, buf, len) < 0) {
+        set_error(HACKDS_ERR_NOMEM, "Metadata string too long");
         return -1;
     }
+    return 0;
+}
 
-    int ret = inflate(&stream, Z_FINISH);
-    if (ret != Z_STREAM_END) {
-        inflateEnd(&stream);
-        free(buffer);
+int hackds_get_metadata_number(hackds_file_t *file, const char *path, double *value) {
+    const hackds_json_token_t *tok = find_meta(file, path);
+    if (!tok) return -1;
+
+    const char *text = file->metadata + tok->start;
+    char *end;
+    double parsed = tok->type == HACKDS_JSON_PRIMITIVE ? strtod(text, &end) : 0;
+    if (tok->type != HACKDS_JSON_PRIMITIVE || end != file->metadata + tok->end) {
+        set_error(HACKDS_ERR_FORMAT, "Metadata field is not a number");
         return -1;
     }
 
-    *out_size = stream.total_out;
-    *out = realloc(buffer, *out_size);
-    if (!*out) *out = buffer;
+    *value = parsed;
+    return 0;
+}
 
-    inflateEnd(&stream);
+int hackds_get_metadata_bool(hackds_file_t *file, const char *path, bool *value) {
+    const hackds_json_token_t *tok = find_meta(file, path);
+    if (!tok) return -1;
+
+    const char *text = file->metadata + tok->start;
+    if (tok->type == HACKDS_JSON_PRIMITIVE && text[0] == 't') {
+        *value = true;
+    } else if (tok->type == HACKDS_JSON_PRIMITIVE && text[0] == 'f') {
+        *value = false;
+    } else {
+        set_error(HACKDS_ERR_FORMAT, "Metadata field is not a boolean");
+        return -1;
+    }
     return 0;
 }
 
-int hackds_compress(const uint8_t *in, size_t in_size,
-                    uint8_t **out, size_t *out_size, int level) {
-    size_t buf_size = compressBound(in_size);
+int hackds_get_metadata_array_size(hackds_file_t *file, const char *path) {
+    const hackds_json_token_t *tok = find_meta(file, path);
+    if (!tok) return -1;
+
+    if (tok->type != HACKDS_JSON_ARRAY) {
+        set_error(HACKDS_ERR_FORMAT, "Metadata field is not an array");
+        return -1;
+    }
+    return tok->size;
+}
+
+// zlib counts in 32-bit units, so large buffers are fed in slices
+#define ZLIB_CHUNK_MAX (1u << 30)
+
+int hackds_decompress(const uint8_t *in, size_t in_size,
+                      uint8_t **out, size_t *out_size) {
+    return hackds_decompress_sized(in, in_size, out, out_size, 0);
+}
+
+int hackds_decompress_sized(const uint8_t *in, size_t in_size,
+                            uint8_t **out, size_t *out_size,
+                            size_t expected_size) {
+    // With a recorded size the buffer is allocated exactly once; otherwise
+    // start from a guess and grow as the stream demands
+    size_t buf_size = expected_size;
+    if (buf_size == 0) {
+        buf_size = in_size * 4;
+        if (buf_size < 4096) buf_size = 4096;
+    }
+
     uint8_t *buffer = malloc(buf_size);
     if (!buffer) return -1;
 
@@ -234,19 +654,95 @@ int hackds_compress(const uint8_t *in, size_t in_size,
     stream.zalloc = Z_NULL;
     stream.zfree = Z_NULL;
     stream.opaque = Z_NULL;
-    stream.avail_in = in_size;
-    stream.next_in = (Bytef*)in;
-    stream.avail_out = buf_size;
-    stream.next_out = buffer;
+    stream.avail_in = 0;
+    stream.next_in = Z_NULL;
 
-    if (deflateInit(&stream, level) != Z_OK) {
+    if (inflateInit(&stream) != Z_OK) {
         free(buffer);
         return -1;
     }
 
-    int ret = deflate(&stream, Z_FINISH);
-    if (ret != Z_STREAM_END) {
-        deflateEnd(&stream);
+    size_t in_left = in_size;
+    size_t produced = 0;
+    int ret = Z_OK;
+
+    while (ret != Z_STREAM_END) {
+        if (stream.avail_in == 0 && in_left > 0) {
+            uInt chunk = in_left > ZLIB_CHUNK_MAX ? ZLIB_CHUNK_MAX : (uInt)in_left;
+            stream.next_in = (Bytef*)in + (in_size - in_left);
+            stream.avail_in = chunk;
+            in_left -= chunk;
+        }
+
+        if (produced == buf_size) {
+            if (expected_size) {
+                // Stream is larger than the header claims
+                break;
+            }
+
+            uint8_t *grown = realloc(buffer, buf_size * 2);
+            if (!grown) break;
+            buffer = grown;
+            buf_size *= 2;
+        }
+
+        size_t room = buf_size - produced;
+        stream.next_out = buffer + produced;
+        stream.avail_out = room > ZLIB_CHUNK_MAX ? ZLIB_CHUNK_MAX : (uInt)room;
+
+        uInt before = stream.avail_out;
+        ret = inflate(&stream, Z_NO_FLUSH);
+        produced += before - stream.avail_out;
+
+        if (ret == Z_BUF_ERROR && stream.avail_in == 0 && in_left == 0) {
+            // Input ran out before the end of the stream
+            break;
+        }
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            break;
+        }
+    }
+
+    inflateEnd(&stream);
+
+    if (ret != Z_STREAM_END || (expected_size && produced != expected_size)) {
+        free(buffer);
+        return -1;
+    }
+
+    *out_size = produced;
+    *out = buffer;
+    if (produced < buf_size) {
+        uint8_t *shrunk = realloc(buffer, produced ? produced : 1);
+        if (shrunk) *out = shrunk;
+    }
+
+    return 0;
+}
+
+int hackds_compress(const uint8_t *in, size_t in_size,
+                    uint8_t **out, size_t *out_size, int level) {
+    size_t buf_size = compressBound(in_size);
+    uint8_t *buffer = malloc(buf_size);
+    if (!buffer) return -1;
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.avail_in = in_size;
+    stream.next_in = (Bytef*)in;
+    stream.avail_out = buf_size;
+    stream.next_out = buffer;
+
+    if (deflateInit(&stream, level) != Z_OK) {
+        free(buffer);
+        return -1;
+    }
+
+    int ret = deflate(&stream, Z_FINISH);
+    if (ret != Z_STREAM_END) {
+        deflateEnd(&stream);
         free(buffer);
         return -1;
     }
@@ -259,82 +755,1304 @@ int hackds_compress(const uint8_t *in, size_t in_size,
     return 0;
 }
 
-// Parse archive structure from payload
-static int parse_archive(hackds_file_t *file) {
-    if (!file || !file->payload) return -1;
+bool hackds_codec_supported(hackds_codec_t codec) {
+    switch (codec) {
+        case HACKDS_CODEC_ZLIB: return true;
+#ifdef HACKDS_WITH_LZ4
+        case HACKDS_CODEC_LZ4: return true;
+#endif
+#ifdef HACKDS_WITH_ZSTD
+        case HACKDS_CODEC_ZSTD: return true;
+#endif
+        default: return false;
+    }
+}
 
-    uint8_t *ptr = file->payload;
-    uint8_t *end = ptr + file->header.payload_size;
+// Decode a buffer whose uncompressed size is known exactly
+static int decode_exact(hackds_codec_t codec, const uint8_t *in, size_t in_size,
+                        uint8_t *out, size_t out_size) {
+    switch (codec) {
+        case HACKDS_CODEC_ZLIB: {
+            uLongf out_len = out_size;
+            if (uncompress(out, &out_len, in, in_size) != Z_OK) return -1;
+            return out_len == out_size ? 0 : -1;
+        }
+#ifdef HACKDS_WITH_LZ4
+        case HACKDS_CODEC_LZ4:
+            if (in_size > LZ4_MAX_INPUT_SIZE || out_size > INT32_MAX) return -1;
+            return LZ4_decompress_safe((const char*)in, (char*)out, (int)in_size,
+                                       (int)out_size) == (int)out_size ? 0 : -1;
+#endif
+#ifdef HACKDS_WITH_ZSTD
+        case HACKDS_CODEC_ZSTD: {
+            size_t ret = ZSTD_decompress(out, out_size, in, in_size);
+            return !ZSTD_isError(ret) && ret == out_size ? 0 : -1;
+        }
+#endif
+        default:
+            return -1;
+    }
+}
 
-    // Count files first
-    uint8_t *scan = ptr;
-    size_t count = 0;
+int hackds_decompress_codec(hackds_codec_t codec,
+                            const uint8_t *in, size_t in_size,
+                            uint8_t **out, size_t *out_size,
+                            size_t expected_size) {
+    if (!hackds_codec_supported(codec)) {
+        set_error(HACKDS_ERR_UNSUPPORTED, "Unsupported compression codec");
+        return -1;
+    }
 
-    while (scan < end) {
-        uint16_t name_len;
-        memcpy(&name_len, scan, 2);
-        scan += 2 + name_len + 8 + 8 + 4;  // name + size + offset + crc
-        if (scan > end) break;
-        count++;
+    if (codec == HACKDS_CODEC_ZLIB) {
+        if (hackds_decompress_sized(in, in_size, out, out_size, expected_size) != 0) {
+            set_error(HACKDS_ERR_DECOMPRESS, "Decompression failed");
+            return -1;
+        }
+        return 0;
     }
 
-    file->file_count = count;
-    file->files = calloc(count, sizeof(hackds_file_entry_t));
-    if (!file->files) return -1;
+#ifdef HACKDS_WITH_ZSTD
+    if (codec == HACKDS_CODEC_ZSTD && expected_size == 0) {
+        unsigned long long frame_size = ZSTD_getFrameContentSize(in, in_size);
+        if (frame_size != ZSTD_CONTENTSIZE_UNKNOWN &&
+            frame_size != ZSTD_CONTENTSIZE_ERROR) {
+            expected_size = (size_t)frame_size;
+        }
+    }
+#endif
+
+    if (expected_size == 0) {
+        set_error(HACKDS_ERR_DECOMPRESS, "Uncompressed size required for codec");
+        return -1;
+    }
+
+    uint8_t *buffer = malloc(expected_size);
+    if (!buffer) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        return -1;
+    }
+
+    if (decode_exact(codec, in, in_size, buffer, expected_size) != 0) {
+        set_error(HACKDS_ERR_DECOMPRESS, "Decompression failed");
+        free(buffer);
+        return -1;
+    }
+
+    *out = buffer;
+    *out_size = expected_size;
+    return 0;
+}
+
+int hackds_compress_codec(hackds_codec_t codec,
+                          const uint8_t *in, size_t in_size,
+                          uint8_t **out, size_t *out_size, int level) {
+    switch (codec) {
+        case HACKDS_CODEC_ZLIB:
+            return hackds_compress(in, in_size, out, out_size, level);
+#ifdef HACKDS_WITH_LZ4
+        case HACKDS_CODEC_LZ4: {
+            if (in_size > LZ4_MAX_INPUT_SIZE) return -1;
+            int bound = LZ4_compressBound((int)in_size);
+            uint8_t *buffer = malloc(bound ? bound : 1);
+            if (!buffer) return -1;
+
+            // Levels above the fast range select the HC compressor
+            int written = level >= LZ4HC_CLEVEL_MIN
+                ? LZ4_compress_HC((const char*)in, (char*)buffer, (int)in_size,
+                                  bound, level)
+                : LZ4_compress_default((const char*)in, (char*)buffer,
+                                       (int)in_size, bound);
+            if (written <= 0 && in_size > 0) {
+                free(buffer);
+                return -1;
+            }
+
+            *out_size = (size_t)written;
+            *out = realloc(buffer, written ? written : 1);
+            if (!*out) *out = buffer;
+            return 0;
+        }
+#endif
+#ifdef HACKDS_WITH_ZSTD
+        case HACKDS_CODEC_ZSTD: {
+            size_t bound = ZSTD_compressBound(in_size);
+            uint8_t *buffer = malloc(bound);
+            if (!buffer) return -1;
+
+            size_t written = ZSTD_compress(buffer, bound, in, in_size, level);
+            if (ZSTD_isError(written)) {
+                free(buffer);
+                return -1;
+            }
+
+            *out_size = written;
+            *out = realloc(buffer, written);
+            if (!*out) *out = buffer;
+            return 0;
+        }
+#endif
+        default:
+            set_error(HACKDS_ERR_UNSUPPORTED, "Unsupported compression codec");
+            return -1;
+    }
+}
+
+// FNV-1a hash for directory lookups
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Build the open-addressing index over file->files. Slots hold the entry
+// index plus one so that zero marks an empty slot.
+static int build_index(hackds_file_t *file) {
+    size_t size = 16;
+    while (size < file->file_count * 2) size <<= 1;
+
+    file->index = calloc(size, sizeof(uint32_t));
+    if (!file->index) return -1;
+    file->index_size = size;
+
+    for (size_t i = 0; i < file->file_count; i++) {
+        size_t slot = hash_name(file->files[i].filename) & (size - 1);
+        while (file->index[slot] != 0) {
+            // Keep the first entry for duplicate names
+            if (strcmp(file->files[file->index[slot] - 1].filename,
+                       file->files[i].filename) == 0) break;
+            slot = (slot + 1) & (size - 1);
+        }
+        if (file->index[slot] == 0) file->index[slot] = (uint32_t)(i + 1);
+    }
+
+    return 0;
+}
+
+// Size of the archive (directory plus file data) once uncompressed
+static uint64_t archive_size(const hackds_file_t *file) {
+    return file->blocks ? file->header.uncompressed_size
+                        : file->header.payload_size;
+}
+
+static size_t block_length(const hackds_file_t *file, uint32_t index) {
+    uint64_t start = (uint64_t)index * file->blocks->block_size;
+    uint64_t left = file->header.uncompressed_size - start;
+    return left < file->blocks->block_size ? (size_t)left
+                                           : file->blocks->block_size;
+}
+
+static int inflate_block(hackds_file_t *file, uint32_t index, uint8_t *dst) {
+    hackds_block_table_t *blocks = file->blocks;
+    uint64_t begin = stats_clock();
+
+    if (decode_exact(payload_codec(file), blocks->data + blocks->offsets[index],
+                     blocks->offsets[index + 1] - blocks->offsets[index],
+                     dst, block_length(file, index)) != 0) {
+        set_error(HACKDS_ERR_DECOMPRESS, "Block decompression failed");
+        return -1;
+    }
+
+    stats_record(HACKDS_PHASE_DECOMPRESS, begin, block_length(file, index));
+    return 0;
+}
+
+typedef struct {
+    hackds_file_t *file;
+    uint32_t first;           // First block of the run
+    uint8_t *dst;             // Destination of the first block
+    int failed;
+} block_run_t;
+
+static void inflate_block_task(void *arg, size_t index) {
+    block_run_t *run = arg;
+    uint32_t block = run->first + (uint32_t)index;
+    uint8_t *dst = run->dst + index * run->file->blocks->block_size;
+
+    if (inflate_block(run->file, block, dst) != 0) {
+        __atomic_store_n(&run->failed, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Copy part of a single block into dst through the one-block cache
+static int read_from_block(hackds_file_t *file, uint32_t index,
+                           size_t within, uint8_t *dst, size_t len) {
+    hackds_block_table_t *blocks = file->blocks;
+    int ret = 0;
+
+    pthread_mutex_lock(&blocks->cache_lock);
+    if (blocks->cache_index != index) {
+        if (!blocks->cache) {
+            blocks->cache = malloc(blocks->block_size);
+        }
+        blocks->cache_index = UINT32_MAX;
+        if (!blocks->cache) {
+            set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+            ret = -1;
+        } else if (inflate_block(file, index, blocks->cache) != 0) {
+            ret = -1;
+        } else {
+            blocks->cache_index = index;
+        }
+    }
+
+    if (ret == 0) {
+        memcpy(dst, blocks->cache + within, len);
+    }
+    pthread_mutex_unlock(&blocks->cache_lock);
+
+    return ret;
+}
+
+// Copy a range of the uncompressed archive into dst. For block-compressed
+// payloads only the blocks covering the range are inflated: whole blocks go
+// straight into dst, in parallel on the worker pool, and the partial blocks
+// at either end go through a one-block cache.
+static int read_range(hackds_file_t *file, uint64_t offset,
+                      uint8_t *dst, size_t len) {
+    if (!file->blocks) {
+        memcpy(dst, file->payload + offset, len);
+        return 0;
+    }
+    if (len == 0) return 0;
+
+    uint64_t bs = file->blocks->block_size;
+    uint64_t end = offset + len;
+
+    // Leading partial block
+    if (offset % bs != 0 || end - offset < bs) {
+        uint32_t index = (uint32_t)(offset / bs);
+        size_t within = (size_t)(offset % bs);
+        size_t block_len = block_length(file, index);
+        size_t n = block_len - within < len ? block_len - within : len;
+
+        // A short final block counts as whole when the range runs to its end
+        if (within != 0 || n != block_len) {
+            if (read_from_block(file, index, within, dst, n) != 0) return -1;
+            dst += n;
+            offset += n;
+            len -= n;
+        }
+    }
+    if (len == 0) return 0;
+
+    // Whole blocks
+    uint32_t first = (uint32_t)(offset / bs);
+    uint32_t last = first;
+    while (last < file->blocks->block_count &&
+           (uint64_t)last * bs + block_length(file, last) <= end) {
+        last++;
+    }
+
+    if (last > first) {
+        block_run_t run = { file, first, dst, 0 };
+        hackds_pool_run(last - first, inflate_block_task, &run);
+        if (run.failed) {
+            // Workers record errors in their own thread
+            set_error(HACKDS_ERR_DECOMPRESS, "Block decompression failed");
+            return -1;
+        }
+
+        size_t n = (size_t)((uint64_t)last * bs - offset);
+        if (n > len) n = len;  // Short final block
+        dst += n;
+        offset += n;
+        len -= n;
+    }
+
+    // Trailing partial block
+    if (len > 0) {
+        if (read_from_block(file, (uint32_t)(offset / bs), 0, dst, len) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void free_entries(hackds_file_entry_t *files, size_t count) {
+    for (size_t i = 0; i < count; i++) free(files[i].filename);
+    free(files);
+}
 
-    // Parse entries
-    for (size_t i = 0; i < count && ptr < end; i++) {
+// Parse the directory at the start of the archive. dir holds dir_len bytes
+// of the uncompressed archive.
+static int parse_directory(hackds_file_t *file, const uint8_t *dir,
+                           size_t dir_len) {
+    uint64_t total = archive_size(file);
+    const uint8_t *ptr = dir;
+
+    // File data follows the directory, so the lowest data offset seen so
+    // far bounds where the directory can end
+    const uint8_t *dir_end = dir + dir_len;
+    size_t capacity = 0;
+    size_t count = 0;
+    hackds_file_entry_t *files = NULL;
+
+    while (ptr + 2 <= dir_end) {
         uint16_t name_len;
         memcpy(&name_len, ptr, 2);
+        if (ptr + 2 + name_len + 8 + 8 + 4 > dir_end) break;
         ptr += 2;
 
-        file->files[i].filename = malloc(name_len + 1);
-        memcpy(file->files[i].filename, ptr, name_len);
-        file->files[i].filename[name_len] = '\0';
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            hackds_file_entry_t *grown = realloc(files, capacity * sizeof(*files));
+            if (!grown) {
+                set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+                free_entries(files, count);
+                return -1;
+            }
+            files = grown;
+        }
+
+        hackds_file_entry_t *entry = &files[count];
+        memset(entry, 0, sizeof(*entry));
+
+        entry->filename = malloc(name_len + 1);
+        if (!entry->filename) {
+            set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+            free_entries(files, count);
+            return -1;
+        }
+        memcpy(entry->filename, ptr, name_len);
+        entry->filename[name_len] = '\0';
         ptr += name_len;
+        count++;
 
-        memcpy(&file->files[i].size, ptr, 8);
+        memcpy(&entry->size, ptr, 8);
         ptr += 8;
 
-        memcpy(&file->files[i].offset, ptr, 8);
+        memcpy(&entry->offset, ptr, 8);
         ptr += 8;
 
-        memcpy(&file->files[i].crc32, ptr, 4);
+        memcpy(&entry->crc32, ptr, 4);
         ptr += 4;
+
+        if (entry->offset > total || entry->size > total - entry->offset) {
+            set_error(HACKDS_ERR_FORMAT, "Archive entry out of bounds");
+            free_entries(files, count);
+            return -1;
+        }
+
+        if (entry->offset < (uint64_t)(dir_end - dir)) {
+            dir_end = dir + entry->offset;
+        }
+    }
+
+    file->files = files;
+    file->file_count = count;
+    stats_record(HACKDS_PHASE_DIRECTORY, 0, (uint64_t)(ptr - dir));
+
+    if (build_index(file) != 0) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        return -1;
     }
 
     return 0;
 }
 
+// Parse archive structure from payload
+static int parse_archive(hackds_file_t *file) {
+    if (!file || !file->payload) return -1;
+
+    if (!file->blocks) {
+        return parse_directory(file, file->payload, file->header.payload_size);
+    }
+
+    // Block-compressed: the first entry's data offset bounds the directory,
+    // so peek at it and then inflate only the blocks the directory spans
+    uint64_t total = archive_size(file);
+    size_t dir_len = total < 2 + UINT16_MAX + 20 ? (size_t)total
+                                                 : 2 + UINT16_MAX + 20;
+    uint8_t *dir = malloc(dir_len ? dir_len : 1);
+    if (!dir) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        return -1;
+    }
+
+    if (read_range(file, 0, dir, dir_len) != 0) {
+        free(dir);
+        return -1;
+    }
+
+    if (dir_len >= 2) {
+        uint16_t name_len;
+        uint64_t first_offset;
+        memcpy(&name_len, dir, 2);
+
+        if ((size_t)2 + name_len + 20 <= dir_len) {
+            memcpy(&first_offset, dir + 2 + name_len + 8, 8);
+
+            if (first_offset > dir_len && first_offset <= total) {
+                uint8_t *grown = realloc(dir, first_offset);
+                if (!grown) {
+                    set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+                    free(dir);
+                    return -1;
+                }
+                dir = grown;
+
+                if (read_range(file, dir_len, dir + dir_len,
+                               first_offset - dir_len) != 0) {
+                    free(dir);
+                    return -1;
+                }
+                dir_len = first_offset;
+            }
+        }
+    }
+
+    int ret = parse_directory(file, dir, dir_len);
+    free(dir);
+    return ret;
+}
+
+// Parse the directory once per handle, even when several threads get here
+// at the same time
+static int ensure_parsed(hackds_file_t *file) {
+    if (__atomic_load_n(&file->parsed, __ATOMIC_ACQUIRE)) return 0;
+
+    int ret = 0;
+    pthread_mutex_lock(&file->lock);
+    if (!file->parsed) {
+        uint64_t begin = stats_clock();
+        ret = parse_archive(file);
+        if (ret == 0) {
+            __atomic_store_n(&file->parsed, true, __ATOMIC_RELEASE);
+            stats_record(HACKDS_PHASE_DIRECTORY, begin, 0);
+        }
+    }
+    pthread_mutex_unlock(&file->lock);
+
+    return ret;
+}
+
+int hackds_ensure_parsed(hackds_file_t *file) {
+    return ensure_parsed(file);
+}
+
+// Look up an entry by name through the directory index
+static hackds_file_entry_t* find_entry(hackds_file_t *file, const char *filename) {
+    if (!file->index) return NULL;
+
+    size_t mask = file->index_size - 1;
+    size_t slot = hash_name(filename) & mask;
+    while (file->index[slot] != 0) {
+        hackds_file_entry_t *entry = &file->files[file->index[slot] - 1];
+        if (strcmp(entry->filename, filename) == 0) return entry;
+        slot = (slot + 1) & mask;
+    }
+
+    return NULL;
+}
+
+// Entries are checked in slices so that one huge file still spreads
+// across every worker; slice CRCs are joined with crc32_combine()
+#define VALIDATE_SLICE (1u << 20)
+
+typedef struct {
+    size_t entry;
+    uint64_t offset;          // Offset within the entry
+    size_t length;
+    uint32_t crc;
+} crc_slice_t;
+
+typedef struct {
+    hackds_file_t *file;
+    crc_slice_t *slices;
+} crc_job_t;
+
+static void crc_slice_task(void *arg, size_t index) {
+    crc_job_t *job = arg;
+    crc_slice_t *slice = &job->slices[index];
+    hackds_file_entry_t *entry = &job->file->files[slice->entry];
+
+    slice->crc = hackds_crc32(job->file->payload + entry->offset + slice->offset,
+                              slice->length);
+}
+
+static void report_crc_mismatch(const hackds_file_entry_t *entry) {
+    char msg[256];
+    snprintf(msg, sizeof(msg), "CRC mismatch: %s", entry->filename);
+    set_error(HACKDS_ERR_CHECKSUM, msg);
+}
+
+// Payload is in memory: checksum slices of every entry on the pool
+static bool validate_in_memory(hackds_file_t *file) {
+    size_t slice_count = 0;
+    for (size_t i = 0; i < file->file_count; i++) {
+        uint64_t size = file->files[i].size;
+        slice_count += size ? (size + VALIDATE_SLICE - 1) / VALIDATE_SLICE : 1;
+    }
+
+    crc_slice_t *slices = malloc(slice_count * sizeof(crc_slice_t));
+    if (!slices) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        return false;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < file->file_count; i++) {
+        uint64_t offset = 0;
+        do {
+            uint64_t left = file->files[i].size - offset;
+            slices[n].entry = i;
+            slices[n].offset = offset;
+            slices[n].length = left < VALIDATE_SLICE ? (size_t)left : VALIDATE_SLICE;
+            offset += slices[n].length;
+            n++;
+        } while (offset < file->files[i].size);
+    }
+
+    crc_job_t job = { file, slices };
+    hackds_pool_run(slice_count, crc_slice_task, &job);
+
+    bool valid = true;
+    size_t s = 0;
+    for (size_t i = 0; i < file->file_count && valid; i++) {
+        uint32_t crc = 0;
+        for (; s < slice_count && slices[s].entry == i; s++) {
+            crc = crc32_combine(crc, slices[s].crc, (z_off_t)slices[s].length);
+        }
+        if (crc != file->files[i].crc32) {
+            report_crc_mismatch(&file->files[i]);
+            valid = false;
+        }
+    }
+
+    free(slices);
+    return valid;
+}
+
+static int compare_offsets(const void *a, const void *b) {
+    const hackds_file_entry_t *x = *(hackds_file_entry_t* const*)a;
+    const hackds_file_entry_t *y = *(hackds_file_entry_t* const*)b;
+    return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+// Block-compressed: inflate a window of blocks at a time on the pool and
+// advance every entry's running CRC over the part that falls inside it
+static bool validate_blocked(hackds_file_t *file) {
+    hackds_block_table_t *blocks = file->blocks;
+    uint32_t window_blocks = (uint32_t)hackds_get_threads() * 4;
+    size_t window_size = (size_t)window_blocks * blocks->block_size;
+
+    uint8_t *window = malloc(window_size);
+    hackds_file_entry_t **order = malloc(file->file_count * sizeof(*order) + 1);
+    uint32_t *crcs = calloc(file->file_count + 1, sizeof(uint32_t));
+    if (!window || !order || !crcs) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        free(window);
+        free(order);
+        free(crcs);
+        return false;
+    }
+
+    for (size_t i = 0; i < file->file_count; i++) order[i] = &file->files[i];
+    qsort(order, file->file_count, sizeof(*order), compare_offsets);
+
+    bool valid = true;
+    size_t first_open = 0;  // First entry not yet fully checksummed
+
+    for (uint32_t b = 0; b < blocks->block_count && valid; b += window_blocks) {
+        uint32_t count = blocks->block_count - b < window_blocks
+                       ? blocks->block_count - b : window_blocks;
+
+        block_run_t run = { file, b, window, 0 };
+        hackds_pool_run(count, inflate_block_task, &run);
+        if (run.failed) {
+            set_error(HACKDS_ERR_DECOMPRESS, "Block decompression failed");
+            valid = false;
+            break;
+        }
+
+        uint64_t start = (uint64_t)b * blocks->block_size;
+        uint64_t end = start + (uint64_t)(count - 1) * blocks->block_size +
+                       block_length(file, b + count - 1);
+
+        for (size_t i = first_open; i < file->file_count; i++) {
+            hackds_file_entry_t *entry = order[i];
+            if (entry->offset >= end) break;
+
+            uint64_t from = entry->offset > start ? entry->offset : start;
+            uint64_t to = entry->offset + entry->size < end
+                        ? entry->offset + entry->size : end;
+            if (to > from) {
+                size_t slot = (size_t)(entry - file->files);
+                crcs[slot] = hackds_crc32_update(crcs[slot], window + (from - start),
+                                                 (size_t)(to - from));
+            }
+        }
+
+        while (first_open < file->file_count &&
+               order[first_open]->offset + order[first_open]->size <= end) {
+            first_open++;
+        }
+    }
+
+    for (size_t i = 0; i < file->file_count && valid; i++) {
+        if (crcs[i] != file->files[i].crc32) {
+            report_crc_mismatch(&file->files[i]);
+            valid = false;
+        }
+    }
+
+    free(window);
+    free(order);
+    free(crcs);
+    return valid;
+}
+
+bool hackds_validate(hackds_file_t *file) {
+    if (!file || !file->loaded) return false;
+
+    // Header was already validated during load. Settings payloads are plain
+    // JSON rather than an archive, so there is nothing more to check.
+    if (file->type == HACKDS_TYPE_SETTINGS || file->header.payload_size == 0) {
+        return true;
+    }
+
+    if (ensure_parsed(file) != 0) {
+        return false;
+    }
+
+    return file->blocks ? validate_blocked(file) : validate_in_memory(file);
+}
+
 int hackds_extract_file(hackds_file_t *file, const char *filename,
                         uint8_t **data, size_t *size) {
     if (!file || !filename || !data || !size) return -1;
 
     // Parse archive if not done yet
-    if (!file->files && parse_archive(file) != 0) {
+    if (ensure_parsed(file) != 0) {
+        return -1;
+    }
+
+    hackds_file_entry_t *entry = find_entry(file, filename);
+    if (!entry) {
+        set_error(HACKDS_ERR_NOT_FOUND, "File not found in archive");
+        return -1;
+    }
+
+    *size = entry->size;
+    *data = malloc(*size ? *size : 1);
+    if (!*data) return -1;
+
+    // Copy data from payload
+    if (read_range(file, entry->offset, *data, *size) != 0) {
+        free(*data);
+        *data = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int hackds_file_view(hackds_file_t *file, const char *filename,
+                     const uint8_t **data, size_t *size) {
+    if (!file || !filename || !data || !size) return -1;
+
+    if (ensure_parsed(file) != 0) {
+        return -1;
+    }
+
+    hackds_file_entry_t *entry = find_entry(file, filename);
+    if (!entry) {
+        set_error(HACKDS_ERR_NOT_FOUND, "File not found in archive");
+        return -1;
+    }
+
+    // Borrowed straight from the payload, no copy. Block-compressed
+    // entries are inflated once into the entry and kept until close.
+    if (file->blocks) {
+        uint8_t *cached = __atomic_load_n(&entry->data, __ATOMIC_ACQUIRE);
+        if (!cached) {
+            uint8_t *buffer = malloc(entry->size ? entry->size : 1);
+            if (!buffer) {
+                set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+                return -1;
+            }
+            if (read_range(file, entry->offset, buffer, entry->size) != 0) {
+                free(buffer);
+                return -1;
+            }
+
+            // Another thread may have inflated the same entry meanwhile
+            if (__atomic_compare_exchange_n(&entry->data, &cached, buffer, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                cached = buffer;
+            } else {
+                free(buffer);
+            }
+        }
+        *data = cached;
+    } else {
+        *data = file->payload + entry->offset;
+    }
+    *size = entry->size;
+    return 0;
+}
+
+// Entry names come from the archive, so never let one escape dest_dir
+static bool safe_entry_name(const char *name) {
+    if (name[0] == '\0' || name[0] == '/') return false;
+
+    for (const char *p = name; *p; ) {
+        const char *end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == 0 || (len == 1 && p[0] == '.') ||
+            (len == 2 && p[0] == '.' && p[1] == '.')) {
+            return false;
+        }
+        if (!end) break;
+        p = end + 1;
+    }
+
+    return true;
+}
+
+// Set of directories already created under the destination, so each one
+// costs a single mkdirat no matter how many entries live in it
+typedef struct {
+    char **slots;
+    size_t size;
+} dir_cache_t;
+
+static int make_parent_dirs(int dirfd, dir_cache_t *cache, const char *name) {
+    char path[4096];
+    size_t name_len = strlen(name);
+    if (name_len >= sizeof(path)) {
+        set_error(HACKDS_ERR_FORMAT, "Entry name too long");
         return -1;
     }
+    memcpy(path, name, name_len + 1);
 
-    // Find file
+    for (char *slash = strchr(path, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+
+        size_t slot = hash_name(path) & (cache->size - 1);
+        bool known = false;
+        while (cache->slots[slot]) {
+            if (strcmp(cache->slots[slot], path) == 0) {
+                known = true;
+                break;
+            }
+            slot = (slot + 1) & (cache->size - 1);
+        }
+
+        if (!known) {
+            if (mkdirat(dirfd, path, 0755) != 0 && errno != EEXIST) {
+                set_error(HACKDS_ERR_IO, "Failed to create directory");
+                return -1;
+            }
+            cache->slots[slot] = strdup(path);
+            if (!cache->slots[slot]) {
+                set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+                return -1;
+            }
+        }
+
+        *slash = '/';
+    }
+
+    return 0;
+}
+
+static int write_all(int fd, const uint8_t *data, size_t len, off_t offset) {
+    stats_record(HACKDS_PHASE_EXTRACT, 0, len);
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+#define PART_SUFFIX ".hackds-part"
+
+typedef struct {
+    hackds_file_t *file;
+    int dirfd;
+    hackds_file_entry_t **order;  // Entries sorted by offset
+    uint64_t *reach;              // Highest end offset of order[0..i]
+    const char *entrypoint;       // Skeletons only: always written in full
+    uint8_t *wanted;              // Entries to write; NULL for all
+    uint64_t *pending;            // Staged runs: bytes left per entry
+    bool staged;                  // Write to a part file, rename when done
+    int error;                    // First errno seen by a worker
+    int decode_failed;
+} extract_run_t;
+
+static void extract_fail(extract_run_t *run, int err) {
+    int expected = 0;
+    __atomic_compare_exchange_n(&run->error, &expected, err ? err : EIO, false,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+static bool entry_wanted(const extract_run_t *run, const hackds_file_entry_t *entry) {
+    return !run->wanted || run->wanted[entry - run->file->files];
+}
+
+// Name an entry is written under: the part file for staged runs
+static const char *output_name(const extract_run_t *run,
+                               const hackds_file_entry_t *entry,
+                               char *buf, size_t len) {
+    if (!run->staged) return entry->filename;
+    if (snprintf(buf, len, "%s" PART_SUFFIX, entry->filename) >= (int)len) return NULL;
+    return buf;
+}
+
+// Move a finished part file over its placeholder. Anything that is no
+// longer a placeholder was written by the game itself and is kept.
+static void publish_entry(extract_run_t *run, const hackds_file_entry_t *entry) {
+    char part[4096];
+    const char *name = output_name(run, entry, part, sizeof(part));
+    struct stat st;
+
+    if (fstatat(run->dirfd, entry->filename, &st, AT_SYMLINK_NOFOLLOW) == 0 &&
+        !hackds_is_placeholder(&st)) {
+        unlinkat(run->dirfd, name, 0);
+        return;
+    }
+    if (renameat(run->dirfd, name, run->dirfd, entry->filename) != 0) {
+        extract_fail(run, errno);
+    }
+}
+
+// Create (or truncate) one output file. Uncompressed archives write the
+// contents straight from the payload at the same time.
+static void extract_entry_task(void *arg, size_t index) {
+    extract_run_t *run = arg;
+    hackds_file_entry_t *entry = &run->file->files[index];
+    if (!entry_wanted(run, entry)) return;
+
+    char part[4096];
+    const char *name = output_name(run, entry, part, sizeof(part));
+    if (!name) {
+        extract_fail(run, ENAMETOOLONG);
+        return;
+    }
+
+    int fd = openat(run->dirfd, name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        extract_fail(run, errno);
+        return;
+    }
+
+    if (!run->file->blocks &&
+        write_all(fd, run->file->payload + entry->offset, entry->size, 0) != 0) {
+        extract_fail(run, errno);
+    }
+    close(fd);
+
+    // Block-compressed entries with data are finished by the block tasks
+    if (run->staged && (!run->file->blocks || entry->size == 0)) {
+        publish_entry(run, entry);
+    }
+}
+
+// Inflate one block and write every entry slice that falls inside it
+static void extract_block_task(void *arg, size_t index) {
+    extract_run_t *run = arg;
+    hackds_file_t *file = run->file;
+    uint64_t start = (uint64_t)index * file->blocks->block_size;
+    uint64_t end = start + block_length(file, (uint32_t)index);
+
+    // First entry whose data may reach into this block
+    size_t lo = 0, hi = file->file_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (run->reach[mid] > start) hi = mid;
+        else lo = mid + 1;
+    }
+
+    // Skip the inflate when no wanted entry overlaps the block
+    bool needed = false;
+    for (size_t i = lo; i < file->file_count && !needed; i++) {
+        hackds_file_entry_t *entry = run->order[i];
+        if (entry->offset >= end) break;
+        needed = entry->offset + entry->size > start && entry_wanted(run, entry);
+    }
+    if (!needed) return;
+
+    uint8_t *block = malloc(file->blocks->block_size);
+    if (!block) {
+        extract_fail(run, ENOMEM);
+        return;
+    }
+    if (inflate_block(file, (uint32_t)index, block) != 0) {
+        __atomic_store_n(&run->decode_failed, 1, __ATOMIC_RELAXED);
+        free(block);
+        return;
+    }
+
+    for (size_t i = lo; i < file->file_count; i++) {
+        hackds_file_entry_t *entry = run->order[i];
+        if (entry->offset >= end) break;
+        if (!entry_wanted(run, entry)) continue;
+
+        uint64_t from = entry->offset > start ? entry->offset : start;
+        uint64_t to = entry->offset + entry->size < end
+                    ? entry->offset + entry->size : end;
+        if (to <= from) continue;
+
+        char part[4096];
+        int fd = openat(run->dirfd, output_name(run, entry, part, sizeof(part)),
+                        O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+            extract_fail(run, errno);
+            break;
+        }
+        if (write_all(fd, block + (from - start), (size_t)(to - from),
+                      (off_t)(from - entry->offset)) != 0) {
+            extract_fail(run, errno);
+        }
+        close(fd);
+
+        // The last block to finish an entry publishes it
+        if (run->staged &&
+            __atomic_sub_fetch(&run->pending[entry - file->files], to - from,
+                               __ATOMIC_ACQ_REL) == 0) {
+            publish_entry(run, entry);
+        }
+    }
+
+    free(block);
+}
+
+// Validate every entry name and create the directory tree under dest_dir,
+// returning a descriptor for dest_dir
+static int create_tree(hackds_file_t *file, const char *dest_dir) {
+    size_t slashes = 0;
     for (size_t i = 0; i < file->file_count; i++) {
-        if (strcmp(file->files[i].filename, filename) == 0) {
-            *size = file->files[i].size;
-            *data = malloc(*size);
-            if (!*data) return -1;
+        const char *name = file->files[i].filename;
+        if (!safe_entry_name(name)) {
+            set_error(HACKDS_ERR_FORMAT, "Unsafe file name in archive");
+            return -1;
+        }
+        for (const char *p = name; *p; p++) slashes += (*p == '/');
+    }
 
-            // Copy data from payload
-            memcpy(*data, file->payload + file->files[i].offset, *size);
-            return 0;
+    if (mkdir(dest_dir, 0755) != 0 && errno != EEXIST) {
+        set_error(HACKDS_ERR_IO, "Failed to create destination directory");
+        return -1;
+    }
+    int dirfd = open(dest_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) {
+        set_error(HACKDS_ERR_IO, "Failed to open destination directory");
+        return -1;
+    }
+
+    dir_cache_t cache = { NULL, 16 };
+    while (cache.size < slashes * 2) cache.size <<= 1;
+    cache.slots = calloc(cache.size, sizeof(char*));
+    if (!cache.slots) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        close(dirfd);
+        return -1;
+    }
+
+    int ret = 0;
+    for (size_t i = 0; i < file->file_count && ret == 0; i++) {
+        ret = make_parent_dirs(dirfd, &cache, file->files[i].filename);
+    }
+
+    for (size_t i = 0; i < cache.size; i++) free(cache.slots[i]);
+    free(cache.slots);
+
+    if (ret != 0) {
+        close(dirfd);
+        return -1;
+    }
+
+    return dirfd;
+}
+
+// Workers record errors in their own thread, so report them from the caller
+static int finish_extract(const extract_run_t *run) {
+    if (run->decode_failed) {
+        set_error(HACKDS_ERR_DECOMPRESS, "Block decompression failed");
+        return -1;
+    }
+    if (run->error) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Failed to write extracted file: %s",
+                 strerror(run->error));
+        set_error(run->error == ENOMEM ? HACKDS_ERR_NOMEM : HACKDS_ERR_IO, msg);
+        return -1;
+    }
+    return 0;
+}
+
+// Write the wanted entries of an archive under run->dirfd: every file is
+// created in parallel, then block-compressed archives are filled one block
+// per task so each block is inflated exactly once
+static int run_extract(extract_run_t *run) {
+    hackds_file_t *file = run->file;
+
+    hackds_pool_run(file->file_count, extract_entry_task, run);
+
+    if (!run->error && file->blocks && file->file_count > 0) {
+        run->order = malloc(file->file_count * sizeof(*run->order));
+        run->reach = malloc(file->file_count * sizeof(*run->reach));
+        if (run->staged) run->pending = malloc(file->file_count * sizeof(uint64_t));
+        if (!run->order || !run->reach || (run->staged && !run->pending)) {
+            set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+            free(run->order);
+            free(run->reach);
+            free(run->pending);
+            return -1;
+        }
+
+        for (size_t i = 0; i < file->file_count; i++) {
+            run->order[i] = &file->files[i];
+            if (run->pending) run->pending[i] = file->files[i].size;
         }
+        qsort(run->order, file->file_count, sizeof(*run->order), compare_offsets);
+
+        uint64_t reach = 0;
+        for (size_t i = 0; i < file->file_count; i++) {
+            uint64_t end = run->order[i]->offset + run->order[i]->size;
+            if (end > reach) reach = end;
+            run->reach[i] = reach;
+        }
+
+        hackds_pool_run(file->blocks->block_count, extract_block_task, run);
+
+        free(run->order);
+        free(run->reach);
+        free(run->pending);
     }
 
-    return -1;  // File not found
+    return finish_extract(run);
+}
+
+int hackds_extract_all(hackds_file_t *file, const char *dest_dir) {
+    if (!file || !dest_dir) return -1;
+
+    if (ensure_parsed(file) != 0) {
+        return -1;
+    }
+
+    // Directory pass: validate names and create every parent once
+    uint64_t begin = stats_clock();
+    int dirfd = create_tree(file, dest_dir);
+    if (dirfd < 0) {
+        return -1;
+    }
+
+    extract_run_t run = { .file = file, .dirfd = dirfd };
+    int ret = run_extract(&run);
+
+    close(dirfd);
+    stats_record(HACKDS_PHASE_EXTRACT, begin, 0);
+    return ret;
+}
+
+int hackds_extract_files(hackds_file_t *file, const char *dest_dir,
+                         const char *const *names, size_t count) {
+    if (!file || !dest_dir || (count > 0 && !names)) return -1;
+
+    if (ensure_parsed(file) != 0) {
+        return -1;
+    }
+
+    uint64_t begin = stats_clock();
+    int dirfd = create_tree(file, dest_dir);
+    if (dirfd < 0) {
+        return -1;
+    }
+
+    extract_run_t run = { .file = file, .dirfd = dirfd };
+    run.wanted = calloc(file->file_count + 1, 1);
+    if (!run.wanted) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        close(dirfd);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        hackds_file_entry_t *entry = find_entry(file, names[i]);
+        if (entry) run.wanted[entry - file->files] = 1;
+    }
+
+    int ret = run_extract(&run);
+
+    free(run.wanted);
+    close(dirfd);
+    stats_record(HACKDS_PHASE_EXTRACT, begin, 0);
+    return ret;
+}
+
+int hackds_fill_skeleton(hackds_file_t *file, const char *dest_dir,
+                         const char *const *names, size_t count) {
+    if (!file || !dest_dir) return -1;
+
+    if (ensure_parsed(file) != 0) {
+        return -1;
+    }
+
+    uint64_t begin = stats_clock();
+    int dirfd = open(dest_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) {
+        set_error(HACKDS_ERR_IO, "Failed to open destination directory");
+        return -1;
+    }
+
+    extract_run_t run = { .file = file, .dirfd = dirfd, .staged = true };
+    run.wanted = calloc(file->file_count + 1, 1);
+    if (!run.wanted) {
+        set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        close(dirfd);
+        return -1;
+    }
+
+    if (names) {
+        for (size_t i = 0; i < count; i++) {
+            hackds_file_entry_t *entry = find_entry(file, names[i]);
+            if (entry) run.wanted[entry - file->files] = 1;
+        }
+    } else {
+        memset(run.wanted, 1, file->file_count);
+    }
+
+    // Only placeholders need filling
+    for (size_t i = 0; i < file->file_count; i++) {
+        struct stat st;
+        if (run.wanted[i] &&
+            (fstatat(dirfd, file->files[i].filename, &st, AT_SYMLINK_NOFOLLOW) != 0 ||
+             !hackds_is_placeholder(&st) || file->files[i].size == 0)) {
+            run.wanted[i] = 0;
+        }
+    }
+
+    int ret = run_extract(&run);
+
+    free(run.wanted);
+    close(dirfd);
+    stats_record(HACKDS_PHASE_EXTRACT, begin, 0);
+    return ret;
+}
+
+// Shared libraries are mapped by the dynamic linker without going through
+// libc, so they cannot be served by the shim: "libfoo.so", "libfoo.so.1.2"
+static bool is_shared_object(const char *name) {
+    const char *base = strrchr(name, '/');
+    base = base ? base + 1 : name;
+
+    for (const char *p = strstr(base, ".so"); p; p = strstr(p + 1, ".so")) {
+        const char *rest = p + 3;
+        while (*rest == '.' || (*rest >= '0' && *rest <= '9')) rest++;
+        if (*rest == '\0') return true;
+    }
+    return false;
+}
+
+// Entries that must exist as real files: the entrypoint, which is exec'd,
+// and shared libraries
+static bool needs_real_file(const hackds_file_entry_t *entry,
+                            const char *entrypoint) {
+    if (entrypoint && strcmp(entry->filename, entrypoint) == 0) return true;
+    return is_shared_object(entry->filename);
+}
+
+static void skeleton_entry_task(void *arg, size_t index) {
+    extract_run_t *run = arg;
+    hackds_file_t *file = run->file;
+    hackds_file_entry_t *entry = &file->files[index];
+
+    int fd = openat(run->dirfd, entry->filename,
+                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        extract_fail(run, errno);
+        return;
+    }
+
+    if (!needs_real_file(entry, run->entrypoint)) {
+        // Placeholder: empty, with a zero mtime that any write will change
+        const struct timespec epoch[2] = { { 0, 0 }, { 0, 0 } };
+        if (futimens(fd, epoch) != 0) extract_fail(run, errno);
+    } else if (!file->blocks) {
+        if (write_all(fd, file->payload + entry->offset, entry->size, 0) != 0) {
+            extract_fail(run, errno);
+        }
+    } else {
+        uint8_t *buffer = malloc(entry->size ? entry->size : 1);
+        if (!buffer) {
+            extract_fail(run, ENOMEM);
+        } else if (read_range(file, entry->offset, buffer, entry->size) != 0) {
+            __atomic_store_n(&run->decode_failed, 1, __ATOMIC_RELAXED);
+        } else if (write_all(fd, buffer, entry->size, 0) != 0) {
+            extract_fail(run, errno);
+        }
+        free(buffer);
+    }
+
+    close(fd);
+}
+
+int hackds_extract_skeleton(hackds_file_t *file, const char *dest_dir,
+                            const char *entrypoint) {
+    if (!file || !dest_dir) return -1;
+
+    if (ensure_parsed(file) != 0) {
+        return -1;
+    }
+
+    uint64_t begin = stats_clock();
+    int dirfd = create_tree(file, dest_dir);
+    if (dirfd < 0) {
+        return -1;
+    }
+
+    extract_run_t run = { .file = file, .dirfd = dirfd, .entrypoint = entrypoint };
+    hackds_pool_run(file->file_count, skeleton_entry_task, &run);
+
+    close(dirfd);
+    int ret = finish_extract(&run);
+    stats_record(HACKDS_PHASE_EXTRACT, begin, 0);
+    return ret;
+}
+
+bool hackds_is_placeholder(const struct stat *st) {
+    return S_ISREG(st->st_mode) && st->st_size == 0 &&
+           st->st_mtim.tv_sec == 0 && st->st_mtim.tv_nsec == 0;
+}
+
+int hackds_content_id(hackds_file_t *file, uint64_t *id) {
+    if (!file || !id) return -1;
+
+    if (ensure_parsed(file) != 0) {
+        return -1;
+    }
+
+    uint32_t crc = 0;
+    for (size_t i = 0; i < file->file_count; i++) {
+        const hackds_file_entry_t *entry = &file->files[i];
+        uint8_t fields[12];
+        for (int b = 0; b < 8; b++) fields[b] = (uint8_t)(entry->size >> (8 * b));
+        for (int b = 0; b < 4; b++) fields[8 + b] = (uint8_t)(entry->crc32 >> (8 * b));
+
+        crc = hackds_crc32_update(crc, (const uint8_t*)entry->filename,
+                                  strlen(entry->filename) + 1);
+        crc = hackds_crc32_update(crc, fields, sizeof(fields));
+    }
+
+    *id = ((uint64_t)file->header.header_crc << 32) | crc;
+    return 0;
 }
 
 int hackds_list_files(hackds_file_t *file, char ***filenames, size_t *count) {
     if (!file || !filenames || !count) return -1;
 
-    if (!file->files && parse_archive(file) != 0) {
+    if (ensure_parsed(file) != 0) {
         return -1;
     }
 
@@ -8,9 +8,11 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
 
 #define HACKDS_VERSION_MAJOR 1
-#define HACKDS_VERSION_MINOR 0
+#define HACKDS_VERSION_MINOR 1
 
 // Magic numbers
 #define MAGIC_HDSG 0x47534448  // "HDSG"
@@ -21,6 +23,30 @@
 // Flags
 #define FLAG_COMPRESSED (1 << 0)
 #define FLAG_ENCRYPTED  (1 << 1)
+#define FLAG_BLOCKED    (1 << 2)  // Payload is split into independently
+                                  // compressed blocks (format 1.1)
+
+// Compression codec, stored in flag bits 4-7
+#define FLAG_CODEC_SHIFT 4
+#define FLAG_CODEC_MASK  (0xF << FLAG_CODEC_SHIFT)
+
+typedef enum {
+    HACKDS_CODEC_ZLIB = 0,
+    HACKDS_CODEC_LZ4,
+    HACKDS_CODEC_ZSTD
+} hackds_codec_t;
+
+// Error codes
+typedef enum {
+    HACKDS_OK = 0,
+    HACKDS_ERR_IO,            // Could not open or read the file
+    HACKDS_ERR_NOMEM,
+    HACKDS_ERR_FORMAT,        // Malformed header, table or directory
+    HACKDS_ERR_UNSUPPORTED,   // Format version or codec not supported
+    HACKDS_ERR_CHECKSUM,      // Header or entry CRC mismatch
+    HACKDS_ERR_DECOMPRESS,
+    HACKDS_ERR_NOT_FOUND      // No such file in the archive
+} hackds_error_t;
 
 // File types
 typedef enum {
@@ -41,7 +67,7 @@ typedef struct __attribute__((packed)) {
     uint32_t header_crc;      // Header checksum
     uint32_t metadata_size;   // Metadata size in bytes
     uint64_t payload_size;    // Payload size in bytes
-    uint64_t reserved2;
+    uint64_t uncompressed_size; // Payload size before compression (0 = unknown)
 } hackds_header_t;
 
 // File entry in archive
@@ -53,15 +79,61 @@ typedef struct {
     uint8_t *data;  // Loaded on demand
 } hackds_file_entry_t;
 
+// Block table of a block-compressed payload
+typedef struct {
+    uint32_t block_size;      // Uncompressed bytes per block
+    uint32_t block_count;
+    uint64_t *offsets;        // block_count + 1 offsets into data
+    const uint8_t *data;      // Start of the compressed blocks
+    uint8_t *cache;           // Most recently inflated block
+    uint32_t cache_index;
+    pthread_mutex_t cache_lock;
+} hackds_block_table_t;
+
+// JSON token types
+typedef enum {
+    HACKDS_JSON_UNDEFINED = 0,
+    HACKDS_JSON_OBJECT,
+    HACKDS_JSON_ARRAY,
+    HACKDS_JSON_STRING,
+    HACKDS_JSON_PRIMITIVE     // Number, true, false or null
+} hackds_json_type_t;
+
+// hackds_json_parse() failures
+#define HACKDS_JSON_EINVAL (-1)   // Malformed document
+#define HACKDS_JSON_ENOMEM (-2)   // Not enough tokens
+
+// A span of the JSON text. Strings exclude their quotes. Object keys are
+// tokens of their own whose parent is the object; a value's parent is its
+// key, and array elements' parent is the array. size counts the keys of
+// an object, the elements of an array, and 1 for a key with its value.
+typedef struct {
+    hackds_json_type_t type;
+    int start;
+    int end;
+    int size;
+    int parent;
+} hackds_json_token_t;
+
 // Main file structure
 typedef struct {
     hackds_file_type_t type;
     hackds_header_t header;
     char *metadata;           // JSON metadata
     uint8_t *payload;         // Raw payload data
+    hackds_block_table_t *blocks;  // Set when payload is block-compressed
     hackds_file_entry_t *files;  // Archived files
     size_t file_count;
+    uint32_t *index;          // Open-addressing name index into files
+    size_t index_size;
+    bool parsed;              // Directory has been parsed
+    pthread_mutex_t lock;     // Guards lazy directory and metadata parsing
+    hackds_json_token_t *meta_tokens;  // Metadata index, built on first lookup
+    int meta_token_count;
+    bool meta_indexed;
     bool loaded;
+    void *map;                // File mapping (hackds_open_mapped only)
+    size_t map_size;
 } hackds_file_t;
 
 // Function prototypes
@@ -69,6 +141,19 @@ typedef struct {
 // Open and parse a HackDS file
 hackds_file_t* hackds_open(const char *path);
 
+// Open a HackDS file by mapping it into memory. For uncompressed files the
+// payload points straight into the mapping instead of a private copy.
+// Falls back to hackds_open() for anything that cannot be mapped.
+hackds_file_t* hackds_open_mapped(const char *path);
+
+// Open only the header and metadata of a HackDS file. The payload is not
+// read, so this is cheap regardless of archive size. The returned handle
+// has no payload and cannot be used for extraction.
+hackds_file_t* hackds_open_header(const char *path);
+
+// Read just the metadata JSON of a HackDS file (caller frees)
+char* hackds_peek_metadata(const char *path);
+
 // Close and free a HackDS file
 void hackds_close(hackds_file_t *file);
 
@@ -82,29 +167,223 @@ hackds_file_type_t hackds_get_type(uint32_t magic);
 int hackds_extract_file(hackds_file_t *file, const char *filename,
                         uint8_t **data, size_t *size);
 
-// Extract all files to a directory
+// Get a read-only view of a file inside the archive without copying it.
+// The pointer is owned by the handle and stays valid until hackds_close().
+int hackds_file_view(hackds_file_t *file, const char *filename,
+                     const uint8_t **data, size_t *size);
+
+// Extract all files to a directory, creating it and any subdirectories.
+// Files are written in parallel on the worker pool. Entry names that are
+// absolute or contain ".." are rejected.
 int hackds_extract_all(hackds_file_t *file, const char *dest_dir);
 
+// Extract only the named entries to dest_dir. The whole directory tree is
+// created as in hackds_extract_all(); names not in the archive are ignored.
+int hackds_extract_files(hackds_file_t *file, const char *dest_dir,
+                         const char *const *names, size_t count);
+
+// Lay out the archive under dest_dir without its contents: directories are
+// created as usual, but files become empty placeholders that the preload
+// shim (libhackds_preload.so) serves from the archive. The entrypoint and
+// shared libraries are written in full since they are loaded by the kernel
+// and the dynamic linker rather than through libc.
+int hackds_extract_skeleton(hackds_file_t *file, const char *dest_dir,
+                            const char *entrypoint);
+
+// Replace placeholders in a skeleton with the real files. names limits this
+// to the given entries; NULL fills everything. Each file is written under a
+// temporary name and renamed over its placeholder once complete, so it is
+// safe to run while the game is already reading the tree. Files that are
+// no longer placeholders are left alone.
+int hackds_fill_skeleton(hackds_file_t *file, const char *dest_dir,
+                         const char *const *names, size_t count);
+
+// Whether a file written by hackds_extract_skeleton() is still an
+// untouched placeholder: empty, with a zero mtime
+struct stat;
+bool hackds_is_placeholder(const struct stat *st);
+
+// Identify the archive contents: the header CRC combined with a CRC over
+// every directory entry's name, size and CRC. Two archives with the same
+// id extract to the same tree.
+int hackds_content_id(hackds_file_t *file, uint64_t *id);
+
 // Get metadata as JSON string
 const char* hackds_get_metadata(hackds_file_t *file);
 
-// Parse metadata to get specific fields
+// Look up a metadata value by path: dot-separated object keys, with numeric
+// segments indexing arrays ("name", "performance.nice", "preload.0"). The
+// metadata is tokenized once per handle on the first lookup.
+//
+// hackds_get_metadata_field() returns a copy the caller frees: strings are
+// unescaped, anything else is returned as its JSON text.
 char* hackds_get_metadata_field(hackds_file_t *file, const char *field);
 
+// Typed getters return 0 on success and -1 if the path does not exist or
+// holds another type. Strings are unescaped into buf and fail if it is
+// too small.
+int hackds_get_metadata_string(hackds_file_t *file, const char *path,
+                               char *buf, size_t len);
+int hackds_get_metadata_number(hackds_file_t *file, const char *path, double *value);
+int hackds_get_metadata_bool(hackds_file_t *file, const char *path, bool *value);
+
+// Number of elements of an array, or -1 if the path is not an array
+int hackds_get_metadata_array_size(hackds_file_t *file, const char *path);
+
+// Tokenize a JSON document into tokens (document order, root first).
+// Returns the number of tokens, or HACKDS_JSON_EINVAL / HACKDS_JSON_ENOMEM.
+// With tokens == NULL only counts them.
+int hackds_json_parse(const char *json, size_t len,
+                      hackds_json_token_t *tokens, int max_tokens);
+
+// Find the value at path below token root, as in hackds_get_metadata_field().
+// Returns its token index or -1.
+int hackds_json_find(const char *json, const hackds_json_token_t *tokens,
+                     int count, int root, const char *path);
+
+// Copy a token's text to buf, unescaping strings. Returns the length, or -1
+// if buf is too small.
+int hackds_json_unescape(const char *json, const hackds_json_token_t *token,
+                         char *buf, size_t len);
+
+// Deep-merge two JSON documents as a JSON merge patch (RFC 7396): objects
+// are merged key by key, null in the patch removes a key, and anything
+// else in the patch replaces the base value. *out is NUL-terminated and
+// freed by the caller. Returns 0 or HACKDS_JSON_EINVAL / HACKDS_JSON_ENOMEM.
+int hackds_json_merge(const char *base, size_t base_len,
+                      const char *patch, size_t patch_len,
+                      char **out, size_t *out_len);
+
 // List all files in the archive
 int hackds_list_files(hackds_file_t *file, char ***filenames, size_t *count);
 
-// CRC32 calculation
+// CRC32 calculation (hardware accelerated where available)
 uint32_t hackds_crc32(const uint8_t *data, size_t length);
 
+// Continue a CRC32 over more data; start with crc = 0
+uint32_t hackds_crc32_update(uint32_t crc, const uint8_t *data, size_t length);
+
 // Compression/decompression
 int hackds_decompress(const uint8_t *in, size_t in_size,
                       uint8_t **out, size_t *out_size);
 
+// Decompress into a buffer allocated once at expected_size. Fails if the
+// stream does not inflate to exactly that size. An expected_size of 0
+// behaves like hackds_decompress().
+int hackds_decompress_sized(const uint8_t *in, size_t in_size,
+                            uint8_t **out, size_t *out_size,
+                            size_t expected_size);
+
 int hackds_compress(const uint8_t *in, size_t in_size,
                     uint8_t **out, size_t *out_size, int level);
 
-// Error handling
+// Codec-aware variants. LZ4 data carries no size of its own, so
+// expected_size is required for it; zlib and Zstandard accept 0.
+int hackds_decompress_codec(hackds_codec_t codec,
+                            const uint8_t *in, size_t in_size,
+                            uint8_t **out, size_t *out_size,
+                            size_t expected_size);
+
+int hackds_compress_codec(hackds_codec_t codec,
+                          const uint8_t *in, size_t in_size,
+                          uint8_t **out, size_t *out_size, int level);
+
+// Whether this build of libhackds can decode the given codec
+bool hackds_codec_supported(hackds_codec_t codec);
+
+// Mod overlays: a merged directory over a base game and any number of
+// .hdsm mods, without extracting or copying anything. Mods are layered by
+// their "priority" metadata (default 0, higher wins; ties go to the mod
+// added last) and each path resolves to the entry of the highest layer
+// that has it. A mod's "patches" can mark files as "json_merge", which
+// merges them into the version below with hackds_json_merge() instead of
+// replacing it; "replace" is the default.
+
+// One path of the merged directory
+typedef struct {
+    const char *filename;     // Owned by the winning layer
+    size_t layer;             // Index of the winning layer
+    size_t merge_base;        // json_merge chains: lowest layer merged into
+    hackds_file_entry_t *entry;
+    uint8_t *merged;          // json_merge result, built on first access
+    size_t merged_size;
+} hackds_overlay_entry_t;
+
+typedef struct {
+    hackds_file_t **layers;   // Base game first, then mods by priority
+    int *priorities;
+    char ***merges;           // Per layer: NULL-terminated json_merge paths
+    size_t layer_count;
+    hackds_overlay_entry_t *entries;  // Built on first lookup
+    size_t entry_count;
+    uint32_t *index;
+    size_t index_size;
+    bool resolved;
+    pthread_mutex_t lock;
+} hackds_overlay_t;
+
+// Start an overlay over base. The overlay borrows base and every mod added
+// to it; close it before closing them.
+hackds_overlay_t* hackds_overlay_open(hackds_file_t *base);
+
+// Layer a mod over the game. Fails for files that are not mods and for
+// patch types other than "replace" and "json_merge", leaving the overlay
+// as it was.
+int hackds_overlay_add(hackds_overlay_t *overlay, hackds_file_t *mod);
+
+// Find the winning entry for a path. *layer, if not NULL, receives the
+// archive it comes from.
+const hackds_overlay_entry_t* hackds_overlay_lookup(hackds_overlay_t *overlay,
+                                                    const char *filename,
+                                                    hackds_file_t **layer);
+
+// Read-only view of a merged file, as hackds_file_view(). Plain entries
+// point into their layer; merged JSON lives until hackds_overlay_close().
+int hackds_overlay_view(hackds_overlay_t *overlay, const char *filename,
+                        const uint8_t **data, size_t *size);
+
+// Extract the merged tree. Every file is written once, from the layer it
+// resolves to.
+int hackds_overlay_extract_all(hackds_overlay_t *overlay, const char *dest_dir);
+
+// Identify the merged contents, as hackds_content_id() does for one archive.
+// This builds the merged directory, so entries is filled in afterwards.
+int hackds_overlay_content_id(hackds_overlay_t *overlay, uint64_t *id);
+
+void hackds_overlay_close(hackds_overlay_t *overlay);
+
+// Phases timed by hackds_set_stats()
+typedef enum {
+    HACKDS_PHASE_OPEN,        // Opening and mapping or reading the file
+    HACKDS_PHASE_HEADER,      // Header checks
+    HACKDS_PHASE_METADATA,    // Metadata read and tokenize
+    HACKDS_PHASE_DECOMPRESS,  // Payload or block inflation
+    HACKDS_PHASE_DIRECTORY,   // Directory parse and index
+    HACKDS_PHASE_EXTRACT,     // Writing files out
+    HACKDS_PHASE_COUNT
+} hackds_phase_t;
+
+// Time and bytes per phase, in CLOCK_MONOTONIC nanoseconds. start_ns is when
+// the phase was first entered. Work done on the worker pool is summed over
+// threads, so decompress time can exceed the wall time of an extraction.
+typedef struct {
+    uint64_t start_ns[HACKDS_PHASE_COUNT];
+    uint64_t ns[HACKDS_PHASE_COUNT];
+    uint64_t bytes[HACKDS_PHASE_COUNT];
+} hackds_stats_t;
+
+// Accumulate phase statistics for all handles into stats, or stop with NULL.
+// Collection costs nothing while no stats block is installed.
+void hackds_set_stats(hackds_stats_t *stats);
+
+// Worker threads used for decompression and extraction, including the
+// calling thread. 0 restores the default (HACKDS_THREADS or CPU count).
+void hackds_set_threads(int count);
+int hackds_get_threads(void);
+
+// Error handling. Errors are recorded per thread: these describe the last
+// failed call made from the calling thread.
 const char* hackds_get_error(void);
+hackds_error_t hackds_get_error_code(void);
 
 #endif // HACKDS_FORMAT_H
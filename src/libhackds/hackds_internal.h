@@ -0,0 +1,17 @@
+/*
+ * HackDS File Format Library
+ * Helpers shared between the library's own source files
+ */
+
+#ifndef HACKDS_INTERNAL_H
+#define HACKDS_INTERNAL_H
+
+#include "hackds_format.h"
+
+// Record the calling thread's error, as reported by hackds_get_error()
+void hackds_set_error(hackds_error_t code, const char *msg);
+
+// Parse the archive directory if that has not happened yet
+int hackds_ensure_parsed(hackds_file_t *file);
+
+#endif // HACKDS_INTERNAL_H
@@ -0,0 +1,513 @@
+/*
+ * HackDS File Format Library
+ * JSON tokenizer for metadata
+ *
+ * A single pass over the text produces a flat array of tokens in document
+ * order, each pointing back into the text and to its parent. Nothing is
+ * allocated: the caller supplies the token array, or passes NULL to just
+ * count the tokens needed. Lookups walk the tokens, never the text.
+ */
+
+#include "hackds_format.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DEPTH 32
+
+typedef enum {
+    EXPECT_VALUE,             // A value, after ':' in objects or ',' in arrays
+    EXPECT_FIRST_VALUE,       // A value or ']' right after '['
+    EXPECT_KEY,               // A key, after ','
+    EXPECT_FIRST_KEY,         // A key or '}' right after '{'
+    EXPECT_COLON,
+    EXPECT_NEXT               // ',' or the closing bracket
+} expect_t;
+
+typedef struct {
+    int token;
+    hackds_json_type_t type;
+    expect_t expect;
+    int key;                  // Most recent key of an object
+} frame_t;
+
+typedef struct {
+    const char *json;
+    size_t len;
+    size_t pos;
+    hackds_json_token_t *tokens;
+    int max_tokens;
+    int count;
+} parser_t;
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int add_token(parser_t *p, hackds_json_type_t type, size_t start, int parent) {
+    if (p->tokens) {
+        if (p->count >= p->max_tokens) return HACKDS_JSON_ENOMEM;
+        hackds_json_token_t *tok = &p->tokens[p->count];
+        tok->type = type;
+        tok->start = (int)start;
+        tok->end = -1;
+        tok->size = 0;
+        tok->parent = parent;
+    }
+    return p->count++;
+}
+
+static void set_end(parser_t *p, int token, size_t end) {
+    if (p->tokens) p->tokens[token].end = (int)end;
+}
+
+static void grow(parser_t *p, int token) {
+    if (p->tokens && token >= 0) p->tokens[token].size++;
+}
+
+static bool is_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// String starting at the opening quote. The token covers the raw contents
+// between the quotes, escapes included. Strings without escapes, which is
+// nearly all of them, are found with a single memchr().
+static int parse_string(parser_t *p, int parent) {
+    const char *s = p->json + p->pos + 1;
+    const char *end = p->json + p->len;
+    size_t start = (size_t)(s - p->json);
+
+    for (;;) {
+        const char *quote = memchr(s, '"', (size_t)(end - s));
+        if (!quote) return HACKDS_JSON_EINVAL;
+
+        const char *escape = memchr(s, '\\', (size_t)(quote - s));
+        if (!escape) {
+            s = quote;
+            break;
+        }
+
+        s = escape + 1;
+        if (s >= end) return HACKDS_JSON_EINVAL;
+        switch (*s++) {
+        case '"': case '\\': case '/': case 'b':
+        case 'f': case 'n': case 'r': case 't':
+            break;
+        case 'u':
+            if (end - s < 4 || !is_hex(s[0]) || !is_hex(s[1]) ||
+                !is_hex(s[2]) || !is_hex(s[3])) {
+                return HACKDS_JSON_EINVAL;
+            }
+            s += 4;
+            break;
+        default:
+            return HACKDS_JSON_EINVAL;
+        }
+    }
+
+    int tok = add_token(p, HACKDS_JSON_STRING, start, parent);
+    if (tok < 0) return tok;
+    set_end(p, tok, (size_t)(s - p->json));
+    p->pos = (size_t)(s - p->json) + 1;
+    return tok;
+}
+
+// Number, true, false or null
+static int parse_primitive(parser_t *p, int parent) {
+    size_t start = p->pos;
+    while (p->pos < p->len) {
+        char c = p->json[p->pos];
+        if (is_space(c) || c == ',' || c == ']' || c == '}') break;
+        p->pos++;
+    }
+
+    const char *text = p->json + start;
+    size_t n = p->pos - start;
+    bool valid = (n == 4 && memcmp(text, "true", 4) == 0) ||
+                 (n == 5 && memcmp(text, "false", 5) == 0) ||
+                 (n == 4 && memcmp(text, "null", 4) == 0);
+    if (!valid && n > 0 && (text[0] == '-' || (text[0] >= '0' && text[0] <= '9'))) {
+        valid = true;
+        for (size_t i = 0; i < n && valid; i++) {
+            char c = text[i];
+            valid = (c >= '0' && c <= '9') || c == '-' || c == '+' ||
+                    c == '.' || c == 'e' || c == 'E';
+        }
+    }
+    if (!valid) return HACKDS_JSON_EINVAL;
+
+    int tok = add_token(p, HACKDS_JSON_PRIMITIVE, start, parent);
+    if (tok < 0) return tok;
+    set_end(p, tok, p->pos);
+    return tok;
+}
+
+int hackds_json_parse(const char *json, size_t len,
+                      hackds_json_token_t *tokens, int max_tokens) {
+    parser_t p = { json, len, 0, tokens, max_tokens, 0 };
+    frame_t stack[MAX_DEPTH];
+    int depth = 0;
+    bool done = false;        // Top-level value complete
+
+    for (;;) {
+        while (p.pos < p.len && is_space(json[p.pos])) p.pos++;
+        if (p.pos == p.len) break;
+        char c = json[p.pos];
+        if (done) return HACKDS_JSON_EINVAL;
+
+        frame_t *top = depth > 0 ? &stack[depth - 1] : NULL;
+        expect_t expect = top ? top->expect : EXPECT_VALUE;
+
+        // Structure
+        if (expect == EXPECT_COLON) {
+            if (c != ':') return HACKDS_JSON_EINVAL;
+            top->expect = EXPECT_VALUE;
+            p.pos++;
+            continue;
+        }
+        if ((c == '}' || c == ']') &&
+            (expect == EXPECT_NEXT || expect == EXPECT_FIRST_KEY ||
+             expect == EXPECT_FIRST_VALUE)) {
+            hackds_json_type_t closing = c == '}' ? HACKDS_JSON_OBJECT : HACKDS_JSON_ARRAY;
+            if (top->type != closing) return HACKDS_JSON_EINVAL;
+            set_end(&p, top->token, p.pos + 1);
+            p.pos++;
+            depth--;
+            if (depth == 0) done = true;
+            else stack[depth - 1].expect = EXPECT_NEXT;
+            continue;
+        }
+        if (expect == EXPECT_NEXT) {
+            if (c != ',') return HACKDS_JSON_EINVAL;
+            top->expect = top->type == HACKDS_JSON_OBJECT ? EXPECT_KEY : EXPECT_VALUE;
+            p.pos++;
+            continue;
+        }
+        if (expect == EXPECT_KEY || expect == EXPECT_FIRST_KEY) {
+            if (c != '"') return HACKDS_JSON_EINVAL;
+            int key = parse_string(&p, top->token);
+            if (key < 0) return key;
+            grow(&p, top->token);
+            top->key = key;
+            top->expect = EXPECT_COLON;
+            continue;
+        }
+
+        // A value: keys parent object values, arrays parent their elements
+        int parent = -1;
+        if (top) {
+            parent = top->type == HACKDS_JSON_OBJECT ? top->key : top->token;
+            grow(&p, parent);
+        }
+
+        int tok;
+        if (c == '{' || c == '[') {
+            if (depth == MAX_DEPTH) return HACKDS_JSON_EINVAL;
+            hackds_json_type_t type = c == '{' ? HACKDS_JSON_OBJECT : HACKDS_JSON_ARRAY;
+            tok = add_token(&p, type, p.pos, parent);
+            if (tok < 0) return tok;
+            stack[depth].token = tok;
+            stack[depth].type = type;
+            stack[depth].expect = type == HACKDS_JSON_OBJECT ? EXPECT_FIRST_KEY
+                                                             : EXPECT_FIRST_VALUE;
+            stack[depth].key = -1;
+            depth++;
+            p.pos++;
+            continue;
+        }
+
+        tok = c == '"' ? parse_string(&p, parent) : parse_primitive(&p, parent);
+        if (tok < 0) return tok;
+        if (top) top->expect = EXPECT_NEXT;
+        else done = true;
+    }
+
+    return done ? p.count : HACKDS_JSON_EINVAL;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return c - 'A' + 10;
+}
+
+static unsigned read_hex4(const char *s) {
+    return (unsigned)(hex_value(s[0]) << 12 | hex_value(s[1]) << 8 |
+                      hex_value(s[2]) << 4 | hex_value(s[3]));
+}
+
+int hackds_json_unescape(const char *json, const hackds_json_token_t *token,
+                         char *buf, size_t len) {
+    size_t out = 0;
+
+    for (int i = token->start; i < token->end; i++) {
+        char c = json[i];
+        char utf8[4];
+        size_t n = 1;
+        utf8[0] = c;
+
+        if (c == '\\' && token->type == HACKDS_JSON_STRING) {
+            c = json[++i];
+            switch (c) {
+            case 'b': utf8[0] = '\b'; break;
+            case 'f': utf8[0] = '\f'; break;
+            case 'n': utf8[0] = '\n'; break;
+            case 'r': utf8[0] = '\r'; break;
+            case 't': utf8[0] = '\t'; break;
+            case 'u': {
+                unsigned cp = read_hex4(json + i + 1);
+                i += 4;
+                // Surrogate pair
+                if (cp >= 0xD800 && cp < 0xDC00 && i + 6 < token->end &&
+                    json[i + 1] == '\\' && json[i + 2] == 'u') {
+                    unsigned low = read_hex4(json + i + 3);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                if (cp < 0x80) {
+                    utf8[0] = (char)cp;
+                } else if (cp < 0x800) {
+                    utf8[0] = (char)(0xC0 | cp >> 6);
+                    utf8[1] = (char)(0x80 | (cp & 0x3F));
+                    n = 2;
+                } else if (cp < 0x10000) {
+                    utf8[0] = (char)(0xE0 | cp >> 12);
+                    utf8[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    utf8[2] = (char)(0x80 | (cp & 0x3F));
+                    n = 3;
+                } else {
+                    utf8[0] = (char)(0xF0 | cp >> 18);
+                    utf8[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+                    utf8[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                    utf8[3] = (char)(0x80 | (cp & 0x3F));
+                    n = 4;
+                }
+                break;
+            }
+            default: utf8[0] = c; break;
+            }
+        }
+
+        if (out + n >= len) return -1;
+        memcpy(buf + out, utf8, n);
+        out += n;
+    }
+
+    if (len == 0) return -1;
+    buf[out] = '\0';
+    return (int)out;
+}
+
+// Compare a key token with name[0..name_len)
+static bool key_equals(const char *json, const hackds_json_token_t *key,
+                       const char *name, size_t name_len) {
+    size_t raw_len = (size_t)(key->end - key->start);
+    const char *raw = json + key->start;
+
+    // Escapes only ever make the raw text longer
+    if (raw_len < name_len) return false;
+    if (raw_len == name_len && memcmp(raw, name, name_len) != 0) return false;
+    if (!memchr(raw, '\\', raw_len)) return raw_len == name_len;
+
+    char buf[256];
+    int n = hackds_json_unescape(json, key, buf, sizeof(buf));
+    return n >= 0 && (size_t)n == name_len && memcmp(buf, name, name_len) == 0;
+}
+
+// First token after the value at index i. Tokens are in document order, so
+// everything nested inside it starts before its end.
+static int skip_value(const hackds_json_token_t *tokens, int count, int i) {
+    if (tokens[i].type != HACKDS_JSON_OBJECT && tokens[i].type != HACKDS_JSON_ARRAY) {
+        return i + 1;
+    }
+
+    int lo = i + 1, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (tokens[mid].start < tokens[i].end) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+int hackds_json_find(const char *json, const hackds_json_token_t *tokens,
+                     int count, int root, const char *path) {
+    int current = root;
+
+    while (*path && current >= 0) {
+        const char *dot = strchr(path, '.');
+        size_t seg_len = dot ? (size_t)(dot - path) : strlen(path);
+        const hackds_json_token_t *node = &tokens[current];
+        int found = -1;
+
+        if (node->type == HACKDS_JSON_OBJECT) {
+            // Each key is directly followed by its value
+            int i = current + 1;
+            for (int k = 0; k < node->size && i + 1 < count; k++) {
+                if (key_equals(json, &tokens[i], path, seg_len)) {
+                    found = i + 1;
+                    break;
+                }
+                i = skip_value(tokens, count, i + 1);
+            }
+        } else if (node->type == HACKDS_JSON_ARRAY) {
+            char *end;
+            long index = strtol(path, &end, 10);
+            if (end == path + seg_len && index >= 0 && index < node->size) {
+                int i = current + 1;
+                while (index-- > 0) i = skip_value(tokens, count, i);
+                found = i;
+            }
+        }
+
+        current = found;
+        path += seg_len;
+        if (*path == '.') path++;
+    }
+
+    return current;
+}
+
+// Growing output buffer for hackds_json_merge()
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    bool failed;
+} output_t;
+
+typedef struct {
+    const char *json;
+    hackds_json_token_t *tokens;
+    int count;
+} document_t;
+
+static void emit(output_t *out, const char *text, size_t len) {
+    if (out->failed) return;
+
+    if (out->len + len + 1 > out->cap) {
+        size_t cap = out->cap ? out->cap : 256;
+        while (cap < out->len + len + 1) cap *= 2;
+        char *grown = realloc(out->buf, cap);
+        if (!grown) {
+            out->failed = true;
+            return;
+        }
+        out->buf = grown;
+        out->cap = cap;
+    }
+
+    memcpy(out->buf + out->len, text, len);
+    out->len += len;
+}
+
+// The JSON text of a value, putting back the quotes of strings. Objects
+// and arrays span their whole text.
+static void emit_token(output_t *out, const document_t *doc, int i) {
+    const hackds_json_token_t *tok = &doc->tokens[i];
+    if (tok->type == HACKDS_JSON_STRING) {
+        emit(out, doc->json + tok->start - 1, (size_t)(tok->end - tok->start) + 2);
+    } else {
+        emit(out, doc->json + tok->start, (size_t)(tok->end - tok->start));
+    }
+}
+
+static bool is_null(const document_t *doc, int i) {
+    return doc->tokens[i].type == HACKDS_JSON_PRIMITIVE && doc->json[doc->tokens[i].start] == 'n';
+}
+
+// Value of the key in object obj of doc that matches key token k of other,
+// or -1
+static int find_key(const document_t *doc, int obj, const document_t *other, int k) {
+    char name[256];
+    int len = hackds_json_unescape(other->json, &other->tokens[k], name, sizeof(name));
+    if (len < 0) return -1;
+
+    int i = obj + 1;
+    for (int n = 0; n < doc->tokens[obj].size && i + 1 < doc->count; n++) {
+        if (key_equals(doc->json, &doc->tokens[i], name, (size_t)len)) return i + 1;
+        i = skip_value(doc->tokens, doc->count, i + 1);
+    }
+    return -1;
+}
+
+// Merge patch value p over base value b, as RFC 7396 does. A patch object
+// applies to an empty object when the base is not one (or b is -1).
+static void merge_value(output_t *out, const document_t *base, int b,
+                        const document_t *patch, int p) {
+    if (patch->tokens[p].type != HACKDS_JSON_OBJECT) {
+        emit_token(out, patch, p);
+        return;
+    }
+    bool base_object = b >= 0 && base->tokens[b].type == HACKDS_JSON_OBJECT;
+
+    bool first = true;
+    emit(out, "{", 1);
+
+    // Keys of the base, merged with or removed by the patch
+    int i = b + 1;
+    for (int n = 0; base_object && n < base->tokens[b].size && i + 1 < base->count; n++) {
+        int replacement = find_key(patch, p, base, i);
+        if (replacement < 0 || !is_null(patch, replacement)) {
+            if (!first) emit(out, ",", 1);
+            first = false;
+            emit_token(out, base, i);
+            emit(out, ":", 1);
+            if (replacement < 0) emit_token(out, base, i + 1);
+            else merge_value(out, base, i + 1, patch, replacement);
+        }
+        i = skip_value(base->tokens, base->count, i + 1);
+    }
+
+    // Keys only the patch has, with the nulls of nested objects dropped too
+    i = p + 1;
+    for (int n = 0; n < patch->tokens[p].size && i + 1 < patch->count; n++) {
+        if ((!base_object || find_key(base, b, patch, i) < 0) && !is_null(patch, i + 1)) {
+            if (!first) emit(out, ",", 1);
+            first = false;
+            emit_token(out, patch, i);
+            emit(out, ":", 1);
+            merge_value(out, base, -1, patch, i + 1);
+        }
+        i = skip_value(patch->tokens, patch->count, i + 1);
+    }
+
+    emit(out, "}", 1);
+}
+
+static int tokenize(document_t *doc, const char *json, size_t len) {
+    doc->json = json;
+    doc->count = hackds_json_parse(json, len, NULL, 0);
+    if (doc->count < 0) return doc->count;
+
+    doc->tokens = malloc((size_t)doc->count * sizeof(hackds_json_token_t));
+    if (!doc->tokens) return HACKDS_JSON_ENOMEM;
+    return hackds_json_parse(json, len, doc->tokens, doc->count);
+}
+
+int hackds_json_merge(const char *base, size_t base_len,
+                      const char *patch, size_t patch_len,
+                      char **out, size_t *out_len) {
+    document_t docs[2] = { { NULL, NULL, 0 }, { NULL, NULL, 0 } };
+    int ret = tokenize(&docs[0], base, base_len);
+    if (ret >= 0) ret = tokenize(&docs[1], patch, patch_len);
+
+    output_t output = { NULL, 0, 0, false };
+    if (ret >= 0) {
+        merge_value(&output, &docs[0], 0, &docs[1], 0);
+        if (output.failed) ret = HACKDS_JSON_ENOMEM;
+    }
+
+    free(docs[0].tokens);
+    free(docs[1].tokens);
+    if (ret < 0) {
+        free(output.buf);
+        return ret;
+    }
+
+    output.buf[output.len] = '\0';
+    *out = output.buf;
+    *out_len = output.len;
+    return 0;
+}
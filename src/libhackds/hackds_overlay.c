@@ -0,0 +1,447 @@
+/*
+ * HackDS File Format Library
+ * Mod overlays
+ *
+ * Layers are kept sorted, base game first. The merged directory is built
+ * once, on the first lookup, by walking the layers from the bottom up and
+ * letting every entry take over the slot of its path. Lookups then cost a
+ * single hash probe, and reads go straight to the winning layer's archive.
+ */
+
+#define _GNU_SOURCE
+#include "hackds_format.h"
+#include "hackds_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+hackds_overlay_t* hackds_overlay_open(hackds_file_t *base) {
+    if (!base) return NULL;
+
+    hackds_overlay_t *overlay = calloc(1, sizeof(hackds_overlay_t));
+    if (overlay) {
+        overlay->layers = malloc(sizeof(hackds_file_t*));
+        overlay->priorities = malloc(sizeof(int));
+        overlay->merges = calloc(1, sizeof(char**));
+    }
+    if (!overlay || !overlay->layers || !overlay->priorities || !overlay->merges) {
+        hackds_set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        hackds_overlay_close(overlay);
+        return NULL;
+    }
+
+    pthread_mutex_init(&overlay->lock, NULL);
+    overlay->layers[0] = base;
+    overlay->priorities[0] = INT_MIN;
+    overlay->layer_count = 1;
+    return overlay;
+}
+
+static void free_list(char **list) {
+    if (!list) return;
+    for (char **p = list; *p; p++) free(*p);
+    free(list);
+}
+
+// Collect the paths a mod merges into the layers below. Patches of any
+// type other than "replace" and "json_merge" cannot be applied.
+static int read_merges(hackds_file_t *mod, char ***merges) {
+    int count = hackds_get_metadata_array_size(mod, "patches");
+    if (count < 0) count = 0;
+
+    char **list = calloc((size_t)count + 1, sizeof(char*));
+    if (!list) {
+        hackds_set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        return -1;
+    }
+
+    size_t used = 0;
+    for (int i = 0; i < count; i++) {
+        char path[64], type[32];
+        snprintf(path, sizeof(path), "patches.%d.type", i);
+        if (hackds_get_metadata_string(mod, path, type, sizeof(type)) != 0) {
+            strcpy(type, "replace");
+        }
+
+        if (strcmp(type, "replace") == 0) continue;
+        if (strcmp(type, "json_merge") != 0) {
+            hackds_set_error(HACKDS_ERR_UNSUPPORTED, "Unsupported patch type");
+            free_list(list);
+            return -1;
+        }
+
+        snprintf(path, sizeof(path), "patches.%d.file", i);
+        char *file = hackds_get_metadata_field(mod, path);
+        if (file) list[used++] = file;
+    }
+
+    *merges = list;
+    return 0;
+}
+
+int hackds_overlay_add(hackds_overlay_t *overlay, hackds_file_t *mod) {
+    if (!overlay || !mod) return -1;
+
+    if (mod->type != HACKDS_TYPE_MOD) {
+        hackds_set_error(HACKDS_ERR_FORMAT, "Not a mod file");
+        return -1;
+    }
+    if (overlay->resolved) {
+        hackds_set_error(HACKDS_ERR_FORMAT, "Overlay already in use");
+        return -1;
+    }
+    if (hackds_ensure_parsed(mod) != 0) {
+        return -1;
+    }
+
+    double number = 0;
+    hackds_get_metadata_number(mod, "priority", &number);
+    int priority = number < INT_MIN + 1 ? INT_MIN + 1 :
+                   number > INT_MAX ? INT_MAX : (int)number;
+
+    char **merges;
+    if (read_merges(mod, &merges) != 0) {
+        return -1;
+    }
+
+    size_t count = overlay->layer_count + 1;
+    hackds_file_t **layers = realloc(overlay->layers, count * sizeof(*layers));
+    if (layers) overlay->layers = layers;
+    int *priorities = realloc(overlay->priorities, count * sizeof(*priorities));
+    if (priorities) overlay->priorities = priorities;
+    char ***lists = realloc(overlay->merges, count * sizeof(*lists));
+    if (lists) overlay->merges = lists;
+    if (!layers || !priorities || !lists) {
+        hackds_set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        free_list(merges);
+        return -1;
+    }
+
+    // Above every layer of the same priority, so the latest addition wins ties
+    size_t at = overlay->layer_count;
+    while (at > 1 && overlay->priorities[at - 1] > priority) at--;
+
+    size_t moved = overlay->layer_count - at;
+    memmove(&layers[at + 1], &layers[at], moved * sizeof(*layers));
+    memmove(&priorities[at + 1], &priorities[at], moved * sizeof(*priorities));
+    memmove(&lists[at + 1], &lists[at], moved * sizeof(*lists));
+    layers[at] = mod;
+    priorities[at] = priority;
+    lists[at] = merges;
+    overlay->layer_count = count;
+
+    return 0;
+}
+
+// FNV-1a, as for archive directories
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Slot of a path in the merged index: either its entry or the empty slot
+// where it belongs
+static size_t find_slot(const hackds_overlay_t *overlay, const char *filename) {
+    size_t mask = overlay->index_size - 1;
+    size_t slot = hash_name(filename) & mask;
+    while (overlay->index[slot] != 0 &&
+           strcmp(overlay->entries[overlay->index[slot] - 1].filename, filename) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static bool is_merged(char **merges, const char *filename) {
+    for (char **p = merges; p && *p; p++) {
+        if (strcmp(*p, filename) == 0) return true;
+    }
+    return false;
+}
+
+static int build_entries(hackds_overlay_t *overlay) {
+    size_t total = 0;
+    for (size_t l = 0; l < overlay->layer_count; l++) {
+        if (hackds_ensure_parsed(overlay->layers[l]) != 0) return -1;
+        total += overlay->layers[l]->file_count;
+    }
+
+    size_t size = 16;
+    while (size < total * 2) size <<= 1;
+
+    overlay->entries = calloc(total + 1, sizeof(hackds_overlay_entry_t));
+    overlay->index = calloc(size, sizeof(uint32_t));
+    if (!overlay->entries || !overlay->index) {
+        hackds_set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        free(overlay->entries);
+        free(overlay->index);
+        overlay->entries = NULL;
+        overlay->index = NULL;
+        return -1;
+    }
+    overlay->index_size = size;
+
+    for (size_t l = 0; l < overlay->layer_count; l++) {
+        hackds_file_t *layer = overlay->layers[l];
+
+        for (size_t i = 0; i < layer->file_count; i++) {
+            hackds_file_entry_t *file = &layer->files[i];
+            size_t slot = find_slot(overlay, file->filename);
+            hackds_overlay_entry_t *entry;
+
+            if (overlay->index[slot] == 0) {
+                entry = &overlay->entries[overlay->entry_count++];
+                overlay->index[slot] = (uint32_t)overlay->entry_count;
+                entry->merge_base = l;
+            } else {
+                entry = &overlay->entries[overlay->index[slot] - 1];
+
+                // Keep the first entry for duplicate names, as archives do
+                if (entry->layer == l) continue;
+                if (!is_merged(overlay->merges[l], file->filename)) {
+                    entry->merge_base = l;
+                }
+            }
+
+            entry->filename = file->filename;
+            entry->layer = l;
+            entry->entry = file;
+        }
+    }
+
+    return 0;
+}
+
+// Build the merged directory once, even when several threads get here at
+// the same time
+static int ensure_resolved(hackds_overlay_t *overlay) {
+    if (__atomic_load_n(&overlay->resolved, __ATOMIC_ACQUIRE)) return 0;
+
+    int ret = 0;
+    pthread_mutex_lock(&overlay->lock);
+    if (!overlay->resolved) {
+        ret = build_entries(overlay);
+        if (ret == 0) __atomic_store_n(&overlay->resolved, true, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&overlay->lock);
+
+    return ret;
+}
+
+const hackds_overlay_entry_t* hackds_overlay_lookup(hackds_overlay_t *overlay,
+                                                    const char *filename,
+                                                    hackds_file_t **layer) {
+    if (!overlay || !filename) return NULL;
+
+    if (ensure_resolved(overlay) != 0) {
+        return NULL;
+    }
+
+    size_t slot = find_slot(overlay, filename);
+    if (overlay->index[slot] == 0) {
+        hackds_set_error(HACKDS_ERR_NOT_FOUND, "File not found in archive");
+        return NULL;
+    }
+
+    const hackds_overlay_entry_t *entry = &overlay->entries[overlay->index[slot] - 1];
+    if (layer) *layer = overlay->layers[entry->layer];
+    return entry;
+}
+
+// Apply a json_merge chain: the version in the merge base, with every
+// higher layer's version merged over it in turn
+static int build_merged(hackds_overlay_t *overlay, hackds_overlay_entry_t *entry) {
+    const uint8_t *data;
+    size_t size;
+    if (hackds_file_view(overlay->layers[entry->merge_base], entry->filename,
+                         &data, &size) != 0) {
+        return -1;
+    }
+
+    char *merged = NULL;
+    size_t merged_size = size;
+    const char *current = (const char*)data;
+
+    for (size_t l = entry->merge_base + 1; l <= entry->layer; l++) {
+        const uint8_t *patch;
+        size_t patch_size;
+        if (hackds_file_view(overlay->layers[l], entry->filename, &patch, &patch_size) != 0) {
+            continue;
+        }
+
+        char *next;
+        size_t next_size;
+        int ret = hackds_json_merge(current, merged_size, (const char*)patch, patch_size,
+                                    &next, &next_size);
+        free(merged);
+        if (ret != 0) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Cannot merge %s: %s", entry->filename,
+                     ret == HACKDS_JSON_ENOMEM ? "out of memory" : "not valid JSON");
+            hackds_set_error(ret == HACKDS_JSON_ENOMEM ? HACKDS_ERR_NOMEM
+                                                       : HACKDS_ERR_FORMAT, msg);
+            return -1;
+        }
+
+        merged = next;
+        merged_size = next_size;
+        current = merged;
+    }
+
+    entry->merged_size = merged_size;
+    __atomic_store_n(&entry->merged, (uint8_t*)merged, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int hackds_overlay_view(hackds_overlay_t *overlay, const char *filename,
+                        const uint8_t **data, size_t *size) {
+    if (!data || !size) return -1;
+
+    hackds_file_t *layer;
+    const hackds_overlay_entry_t *found = hackds_overlay_lookup(overlay, filename, &layer);
+    if (!found) return -1;
+
+    if (found->merge_base == found->layer) {
+        return hackds_file_view(layer, filename, data, size);
+    }
+
+    hackds_overlay_entry_t *entry = (hackds_overlay_entry_t*)found;
+    if (!__atomic_load_n(&entry->merged, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&overlay->lock);
+        int ret = entry->merged ? 0 : build_merged(overlay, entry);
+        pthread_mutex_unlock(&overlay->lock);
+        if (ret != 0) return -1;
+    }
+
+    *data = entry->merged;
+    *size = entry->merged_size;
+    return 0;
+}
+
+static int write_file(int dirfd, const char *name, const uint8_t *data, size_t size) {
+    int fd = openat(dirfd, name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return -1;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+
+    return close(fd);
+}
+
+int hackds_overlay_extract_all(hackds_overlay_t *overlay, const char *dest_dir) {
+    if (!overlay || !dest_dir) return -1;
+
+    if (ensure_resolved(overlay) != 0) {
+        return -1;
+    }
+
+    const char **names = malloc((overlay->entry_count + 1) * sizeof(char*));
+    if (!names) {
+        hackds_set_error(HACKDS_ERR_NOMEM, "Memory allocation failed");
+        return -1;
+    }
+
+    // Each layer writes the files it wins, in parallel like any extraction.
+    // Its whole directory tree is created too, which merged files rely on.
+    int ret = 0;
+    for (size_t l = 0; l < overlay->layer_count && ret == 0; l++) {
+        size_t count = 0;
+        for (size_t i = 0; i < overlay->entry_count; i++) {
+            const hackds_overlay_entry_t *entry = &overlay->entries[i];
+            if (entry->layer == l && entry->merge_base == l) {
+                names[count++] = entry->filename;
+            }
+        }
+        ret = hackds_extract_files(overlay->layers[l], dest_dir, names, count);
+    }
+    free(names);
+    if (ret != 0) return -1;
+
+    int dirfd = open(dest_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) {
+        hackds_set_error(HACKDS_ERR_IO, "Failed to open destination directory");
+        return -1;
+    }
+
+    for (size_t i = 0; i < overlay->entry_count && ret == 0; i++) {
+        const hackds_overlay_entry_t *entry = &overlay->entries[i];
+        if (entry->layer == entry->merge_base) continue;
+
+        const uint8_t *data;
+        size_t size;
+        ret = hackds_overlay_view(overlay, entry->filename, &data, &size);
+        if (ret == 0 && write_file(dirfd, entry->filename, data, size) != 0) {
+            hackds_set_error(HACKDS_ERR_IO, "Failed to write merged file");
+            ret = -1;
+        }
+    }
+
+    close(dirfd);
+    return ret;
+}
+
+int hackds_overlay_content_id(hackds_overlay_t *overlay, uint64_t *id) {
+    if (!overlay || !id) return -1;
+
+    if (ensure_resolved(overlay) != 0) {
+        return -1;
+    }
+
+    // Every layer's contents in order, plus the metadata of the mods, which
+    // holds their patch types
+    uint32_t crc = 0;
+    for (size_t l = 0; l < overlay->layer_count; l++) {
+        hackds_file_t *layer = overlay->layers[l];
+        uint64_t layer_id;
+        if (hackds_content_id(layer, &layer_id) != 0) return -1;
+
+        uint8_t bytes[8];
+        for (int b = 0; b < 8; b++) bytes[b] = (uint8_t)(layer_id >> (8 * b));
+        crc = hackds_crc32_update(crc, bytes, sizeof(bytes));
+        if (l > 0 && layer->metadata) {
+            crc = hackds_crc32_update(crc, (const uint8_t*)layer->metadata,
+                                      layer->header.metadata_size);
+        }
+    }
+
+    uint64_t base_id;
+    if (hackds_content_id(overlay->layers[0], &base_id) != 0) return -1;
+
+    *id = (base_id & 0xFFFFFFFF00000000ull) | crc;
+    return 0;
+}
+
+void hackds_overlay_close(hackds_overlay_t *overlay) {
+    if (!overlay) return;
+
+    for (size_t i = 0; i < overlay->entry_count; i++) {
+        free(overlay->entries[i].merged);
+    }
+    for (size_t l = 0; l < overlay->layer_count; l++) {
+        free_list(overlay->merges[l]);
+    }
+
+    free(overlay->entries);
+    free(overlay->index);
+    free(overlay->merges);
+    free(overlay->priorities);
+    free(overlay->layers);
+    if (overlay->layer_count > 0) pthread_mutex_destroy(&overlay->lock);
+    free(overlay);
+}
@@ -0,0 +1,192 @@
+/*
+ * HackDS File Format Library
+ * Worker pool implementation
+ */
+
+#include "hackds_pool.h"
+#include "hackds_format.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+
+typedef struct {
+    hackds_task_fn fn;
+    void *arg;
+    size_t count;
+    size_t next;              // Next index to hand out
+    size_t done;              // Indices finished
+} pool_job_t;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_idle = PTHREAD_COND_INITIALIZER;
+
+// Serialises callers so that only one job runs at a time
+static pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t workers[MAX_THREADS];
+static int worker_count = 0;
+static int thread_count = 0;  // Configured total, including the caller
+static bool stopping = false;
+static pool_job_t *current_job = NULL;
+
+static __thread bool in_task = false;
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+static int default_threads(void) {
+    const char *env = getenv("HACKDS_THREADS");
+    if (env && atoi(env) > 0) return atoi(env);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+// Take indices from the current job until none are left. Called with
+// pool_lock held; returns with it held.
+static void work_on(pool_job_t *job) {
+    while (job->next < job->count) {
+        size_t index = job->next++;
+        pthread_mutex_unlock(&pool_lock);
+
+        job->fn(job->arg, index);
+
+        pthread_mutex_lock(&pool_lock);
+        if (++job->done == job->count) {
+            pthread_cond_broadcast(&pool_idle);
+        }
+    }
+}
+
+static void* worker_main(void *unused) {
+    (void)unused;
+    in_task = true;
+
+    pthread_mutex_lock(&pool_lock);
+    while (!stopping) {
+        if (current_job && current_job->next < current_job->count) {
+            work_on(current_job);
+        } else {
+            pthread_cond_wait(&pool_work, &pool_lock);
+        }
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    return NULL;
+}
+
+static void stop_workers(void) {
+    pthread_mutex_lock(&pool_lock);
+    stopping = true;
+    pthread_cond_broadcast(&pool_work);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    worker_count = 0;
+    stopping = false;
+}
+
+// The preload shim runs the pool inside games, which may fork while another
+// of their threads is in a job. Forking must not wait for that job (the
+// game loader forks its game while extraction is still running), so only
+// the briefly held pool_lock is taken. The child, which has none of the
+// workers or the job's caller, starts over with fresh locks and starts its
+// own workers on first use.
+static void fork_prepare(void) {
+    pthread_mutex_lock(&pool_lock);
+}
+
+static void fork_parent(void) {
+    pthread_mutex_unlock(&pool_lock);
+}
+
+static void fork_child(void) {
+    pthread_mutex_init(&pool_lock, NULL);
+    pthread_mutex_init(&run_lock, NULL);
+    pthread_cond_init(&pool_work, NULL);
+    pthread_cond_init(&pool_idle, NULL);
+    worker_count = 0;
+    stopping = false;
+    current_job = NULL;
+}
+
+static void register_atfork(void) {
+    pthread_atfork(fork_prepare, fork_parent, fork_child);
+}
+
+// Start workers up to the configured count. Called with run_lock held.
+static void start_workers(void) {
+    if (thread_count == 0) thread_count = default_threads();
+
+    while (worker_count < thread_count - 1) {
+        if (pthread_create(&workers[worker_count], NULL, worker_main, NULL) != 0) {
+            break;  // Run with what we have
+        }
+        worker_count++;
+    }
+}
+
+void hackds_set_threads(int count) {
+    if (count <= 0) count = default_threads();
+    if (count > MAX_THREADS) count = MAX_THREADS;
+
+    pthread_mutex_lock(&run_lock);
+    if (count != thread_count) {
+        stop_workers();
+        thread_count = count;
+    }
+    pthread_mutex_unlock(&run_lock);
+}
+
+int hackds_get_threads(void) {
+    pthread_mutex_lock(&run_lock);
+    if (thread_count == 0) thread_count = default_threads();
+    int count = thread_count;
+    pthread_mutex_unlock(&run_lock);
+
+    return count;
+}
+
+void hackds_pool_run(size_t count, hackds_task_fn fn, void *arg) {
+    if (count == 0) return;
+
+    // Nested or trivially small jobs run inline
+    if (in_task || count == 1) {
+        for (size_t i = 0; i < count; i++) fn(arg, i);
+        return;
+    }
+
+    pthread_once(&atfork_once, register_atfork);
+    pthread_mutex_lock(&run_lock);
+    start_workers();
+
+    if (worker_count == 0) {
+        pthread_mutex_unlock(&run_lock);
+        for (size_t i = 0; i < count; i++) fn(arg, i);
+        return;
+    }
+
+    pool_job_t job = { fn, arg, count, 0, 0 };
+
+    pthread_mutex_lock(&pool_lock);
+    current_job = &job;
+    pthread_cond_broadcast(&pool_work);
+
+    // The caller works too, then waits for stragglers
+    in_task = true;
+    work_on(&job);
+    in_task = false;
+
+    while (job.done < job.count) {
+        pthread_cond_wait(&pool_idle, &pool_lock);
+    }
+    current_job = NULL;
+    pthread_mutex_unlock(&pool_lock);
+
+    pthread_mutex_unlock(&run_lock);
+}
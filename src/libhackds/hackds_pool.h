@@ -0,0 +1,18 @@
+/*
+ * HackDS File Format Library
+ * Internal worker pool shared by the decompression and extraction code
+ */
+
+#ifndef HACKDS_POOL_H
+#define HACKDS_POOL_H
+
+#include <stddef.h>
+
+typedef void (*hackds_task_fn)(void *arg, size_t index);
+
+// Run fn(arg, i) for every i in [0, count) across the pool and the calling
+// thread, returning once all calls have finished. Calls made from inside a
+// task run inline on the calling worker.
+void hackds_pool_run(size_t count, hackds_task_fn fn, void *arg);
+
+#endif // HACKDS_POOL_H
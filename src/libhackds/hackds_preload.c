@@ -0,0 +1,679 @@
+/*
+ * HackDS File Format Library
+ * LD_PRELOAD shim that serves game files straight from the archive
+ *
+ * The game loader lays a game out with hackds_extract_skeleton(), which
+ * creates the directory tree and an empty placeholder for every file, and
+ * runs it with this library preloaded. Opening a placeholder read-only
+ * returns a descriptor for the placeholder itself, and reads, seeks, stats
+ * and mappings of that descriptor are answered from the mmapped .hdsg. File
+ * contents are never copied to tmpfs.
+ *
+ * Configured through the environment:
+ *   HACKDS_PRELOAD_ARCHIVE   path of the .hdsg
+ *   HACKDS_PRELOAD_ROOT      directory holding the skeleton
+ *
+ * Limitations:
+ * - glibc reads stdio streams through internal entry points. fopen() and
+ *   fdopen() of a placeholder therefore swap its descriptor for a memfd
+ *   holding a copy of the file.
+ * - mmap() of a placeholder returns a private copy.
+ * - sendfile() and copy_file_range() from a placeholder fall back to
+ *   write() and pwrite().
+ * - Opening a placeholder for writing turns it into an ordinary file.
+ * - Stat interposition needs glibc 2.33 or newer.
+ */
+
+#define _GNU_SOURCE
+#include "hackds_format.h"
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+
+// On LP64 glibc the *64 variants share the plain layouts
+_Static_assert(sizeof(struct stat) == sizeof(struct stat64), "stat64 layout");
+_Static_assert(sizeof(off_t) == sizeof(off64_t), "off64_t size");
+
+// An open file description on a placeholder, shared by dup()ed descriptors
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    off_t pos;
+    int refs;
+} vfile_t;
+
+#define FD_CHUNK 1024
+#define FD_CHUNKS 64
+
+static vfile_t **fd_chunks[FD_CHUNKS];
+static pthread_mutex_t fd_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char root[PATH_MAX];
+static size_t root_len;       // 0 when the shim is disabled
+static hackds_file_t *archive;
+static pthread_once_t archive_once = PTHREAD_ONCE_INIT;
+static __thread int in_shim;  // Set while the shim does I/O of its own
+
+// Real implementations
+static int (*real_openat)(int, const char*, int, ...);
+static FILE* (*real_fopen)(const char*, const char*);
+static FILE* (*real_fopen64)(const char*, const char*);
+static FILE* (*real_fdopen)(int, const char*);
+static ssize_t (*real_read)(int, void*, size_t);
+static ssize_t (*real_pread)(int, void*, size_t, off_t);
+static off_t (*real_lseek)(int, off_t, int);
+static int (*real_close)(int);
+static int (*real_dup)(int);
+static int (*real_dup2)(int, int);
+static int (*real_dup3)(int, int, int);
+static int (*real_fstat)(int, struct stat*);
+static int (*real_fstatat)(int, const char*, struct stat*, int);
+static void* (*real_mmap)(void*, size_t, int, int, int, off_t);
+static ssize_t (*real_sendfile)(int, int, off_t*, size_t);
+static ssize_t (*real_copy_file_range)(int, off64_t*, int, off64_t*, size_t, unsigned int);
+static pthread_once_t real_once = PTHREAD_ONCE_INIT;
+
+static void resolve_real(void) {
+    real_openat = dlsym(RTLD_NEXT, "openat");
+    real_fopen = dlsym(RTLD_NEXT, "fopen");
+    real_fopen64 = dlsym(RTLD_NEXT, "fopen64");
+    real_fdopen = dlsym(RTLD_NEXT, "fdopen");
+    real_read = dlsym(RTLD_NEXT, "read");
+    real_pread = dlsym(RTLD_NEXT, "pread");
+    real_lseek = dlsym(RTLD_NEXT, "lseek");
+    real_close = dlsym(RTLD_NEXT, "close");
+    real_dup = dlsym(RTLD_NEXT, "dup");
+    real_dup2 = dlsym(RTLD_NEXT, "dup2");
+    real_dup3 = dlsym(RTLD_NEXT, "dup3");
+    real_fstat = dlsym(RTLD_NEXT, "fstat");
+    real_fstatat = dlsym(RTLD_NEXT, "fstatat");
+    real_mmap = dlsym(RTLD_NEXT, "mmap");
+    real_sendfile = dlsym(RTLD_NEXT, "sendfile");
+    real_copy_file_range = dlsym(RTLD_NEXT, "copy_file_range");
+}
+
+// Other libraries' constructors may do I/O before ours has run
+#define RESOLVE() do { if (!real_read) pthread_once(&real_once, resolve_real); } while (0)
+
+__attribute__((constructor))
+static void preload_init(void) {
+    RESOLVE();
+
+    const char *env_root = getenv("HACKDS_PRELOAD_ROOT");
+    if (!env_root || !getenv("HACKDS_PRELOAD_ARCHIVE")) return;
+
+    if (realpath(env_root, root)) root_len = strlen(root);
+}
+
+static void open_archive(void) {
+    in_shim = 1;
+    archive = hackds_open_mapped(getenv("HACKDS_PRELOAD_ARCHIVE"));
+    in_shim = 0;
+}
+
+// The archive is only opened once a placeholder is actually touched, so
+// helper processes that inherit the environment pay nothing for it
+static bool shim_active(void) {
+    if (in_shim || root_len == 0) return false;
+    pthread_once(&archive_once, open_archive);
+    return archive != NULL;
+}
+
+// Absolute paths outside the game directory can skip the placeholder check
+static bool may_be_placeholder(const char *path) {
+    if (root_len == 0 || in_shim) return false;
+    if (path[0] != '/') return true;
+    return strncmp(path, root, root_len) == 0 && path[root_len] == '/';
+}
+
+// Find the archive entry behind a placeholder descriptor. The path comes
+// from /proc, so relative names, dirfds and symlinks need no handling here.
+static int lookup_fd(int fd, const uint8_t **data, size_t *size) {
+    char link[32];
+    char path[PATH_MAX];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+
+    ssize_t n = readlink(link, path, sizeof(path) - 1);
+    if (n <= (ssize_t)root_len) return -1;
+    path[n] = '\0';
+    if (strncmp(path, root, root_len) != 0 || path[root_len] != '/') return -1;
+
+    in_shim = 1;
+    int ret = hackds_file_view(archive, path + root_len + 1, data, size);
+    in_shim = 0;
+    return ret;
+}
+
+// fd table
+
+static vfile_t *vfile_peek(int fd) {
+    if (fd < 0 || fd >= FD_CHUNK * FD_CHUNKS) return NULL;
+    vfile_t **chunk = __atomic_load_n(&fd_chunks[fd / FD_CHUNK], __ATOMIC_ACQUIRE);
+    if (!chunk) return NULL;
+    return __atomic_load_n(&chunk[fd % FD_CHUNK], __ATOMIC_ACQUIRE);
+}
+
+static void vfile_release(vfile_t *vf) {
+    if (vf && __atomic_sub_fetch(&vf->refs, 1, __ATOMIC_ACQ_REL) == 0) free(vf);
+}
+
+// Point fd at vf (or nothing), releasing whatever it referred to before
+static int vfile_set(int fd, vfile_t *vf) {
+    if (fd < 0 || fd >= FD_CHUNK * FD_CHUNKS) return -1;
+
+    pthread_mutex_lock(&fd_lock);
+    vfile_t **chunk = fd_chunks[fd / FD_CHUNK];
+    if (!chunk && vf) {
+        chunk = calloc(FD_CHUNK, sizeof(vfile_t*));
+        if (!chunk) {
+            pthread_mutex_unlock(&fd_lock);
+            return -1;
+        }
+        __atomic_store_n(&fd_chunks[fd / FD_CHUNK], chunk, __ATOMIC_RELEASE);
+    }
+
+    vfile_t *old = NULL;
+    if (chunk) {
+        old = chunk[fd % FD_CHUNK];
+        if (vf) __atomic_add_fetch(&vf->refs, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&chunk[fd % FD_CHUNK], vf, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&fd_lock);
+
+    vfile_release(old);
+    return 0;
+}
+
+// Take a reference to fd's vfile, if any
+static vfile_t *vfile_acquire(int fd) {
+    if (!vfile_peek(fd)) return NULL;
+
+    pthread_mutex_lock(&fd_lock);
+    vfile_t *vf = vfile_peek(fd);
+    if (vf) __atomic_add_fetch(&vf->refs, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&fd_lock);
+
+    return vf;
+}
+
+static int write_all(int fd, const uint8_t *data, size_t len) {
+    off_t offset = 0;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+// Swap a placeholder descriptor for a memfd holding the file contents, for
+// consumers such as stdio that read behind the shim's back
+static int promote(int fd, const uint8_t *data, size_t size, off_t pos) {
+    int mfd = memfd_create("hackds", MFD_CLOEXEC);
+    if (mfd < 0) return -1;
+
+    if (write_all(mfd, data, size) != 0 || real_lseek(mfd, pos, SEEK_SET) < 0) {
+        real_close(mfd);
+        return -1;
+    }
+
+    int cloexec = fcntl(fd, F_GETFD) & FD_CLOEXEC;
+    int ret = real_dup3(mfd, fd, cloexec ? O_CLOEXEC : 0);
+    real_close(mfd);
+    if (ret < 0) return -1;
+
+    vfile_set(fd, NULL);
+    return 0;
+}
+
+// Register fd if it is a freshly opened placeholder. Writers get the
+// contents filled in and carry on with an ordinary file.
+static void adopt(int fd, int flags) {
+    struct stat st;
+    if (flags & (O_PATH | O_DIRECTORY)) return;
+    if (real_fstat(fd, &st) != 0 || !hackds_is_placeholder(&st)) return;
+    if (!shim_active()) return;
+
+    const uint8_t *data;
+    size_t size;
+    if (lookup_fd(fd, &data, &size) != 0) return;
+
+    if ((flags & O_ACCMODE) != O_RDONLY) {
+        if (flags & O_TRUNC) futimens(fd, NULL);
+        else write_all(fd, data, size);
+        return;
+    }
+
+    vfile_t *vf = calloc(1, sizeof(vfile_t));
+    if (!vf) return;
+    vf->data = data;
+    vf->size = size;
+    if (vfile_set(fd, vf) != 0) {
+        // Beyond the fd table: fall back to a copy
+        free(vf);
+        promote(fd, data, size, 0);
+    }
+}
+
+static int open_common(int dirfd, const char *path, int flags, mode_t mode) {
+    RESOLVE();
+    int fd = real_openat(dirfd, path, flags, mode);
+    if (fd >= 0 && may_be_placeholder(path)) adopt(fd, flags);
+    return fd;
+}
+
+static mode_t open_mode(int flags, va_list ap) {
+    return (flags & (O_CREAT | O_TMPFILE)) ? (mode_t)va_arg(ap, int) : 0;
+}
+
+int open(const char *path, int flags, ...) {
+    va_list ap;
+    va_start(ap, flags);
+    mode_t mode = open_mode(flags, ap);
+    va_end(ap);
+    return open_common(AT_FDCWD, path, flags, mode);
+}
+
+int open64(const char *path, int flags, ...) {
+    va_list ap;
+    va_start(ap, flags);
+    mode_t mode = open_mode(flags, ap);
+    va_end(ap);
+    return open_common(AT_FDCWD, path, flags | O_LARGEFILE, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...) {
+    va_list ap;
+    va_start(ap, flags);
+    mode_t mode = open_mode(flags, ap);
+    va_end(ap);
+    return open_common(dirfd, path, flags, mode);
+}
+
+int openat64(int dirfd, const char *path, int flags, ...) {
+    va_list ap;
+    va_start(ap, flags);
+    mode_t mode = open_mode(flags, ap);
+    va_end(ap);
+    return open_common(dirfd, path, flags | O_LARGEFILE, mode);
+}
+
+static FILE *fopen_common(FILE *(*real)(const char*, const char*),
+                          const char *path, const char *mode) {
+    FILE *fp = real(path, mode);
+    if (!fp || !may_be_placeholder(path)) return fp;
+
+    int fd = fileno(fp);
+    struct stat st;
+    if (real_fstat(fd, &st) != 0 || !hackds_is_placeholder(&st) || !shim_active()) {
+        return fp;
+    }
+
+    const uint8_t *data;
+    size_t size;
+    if (lookup_fd(fd, &data, &size) != 0) return fp;
+
+    if (mode[0] == 'r' && !strchr(mode, '+')) {
+        promote(fd, data, size, 0);
+    } else if (mode[0] == 'w') {
+        futimens(fd, NULL);
+    } else {
+        write_all(fd, data, size);
+    }
+    return fp;
+}
+
+FILE *fopen(const char *path, const char *mode) {
+    RESOLVE();
+    return fopen_common(real_fopen, path, mode);
+}
+
+FILE *fopen64(const char *path, const char *mode) {
+    RESOLVE();
+    return fopen_common(real_fopen64, path, mode);
+}
+
+FILE *fdopen(int fd, const char *mode) {
+    RESOLVE();
+    vfile_t *vf = vfile_acquire(fd);
+    if (vf) {
+        promote(fd, vf->data, vf->size, vf->pos);
+        vfile_release(vf);
+    }
+    return real_fdopen(fd, mode);
+}
+
+// Copy from a vfile. offset < 0 reads at, and advances, the file position.
+static ssize_t vfile_read(vfile_t *vf, void *buf, size_t count, off_t offset) {
+    off_t start;
+    if (offset < 0) {
+        pthread_mutex_lock(&fd_lock);
+        start = vf->pos;
+        size_t left = (size_t)start < vf->size ? vf->size - (size_t)start : 0;
+        if (count > left) count = left;
+        vf->pos += (off_t)count;
+        pthread_mutex_unlock(&fd_lock);
+    } else {
+        start = offset;
+        size_t left = (size_t)start < vf->size ? vf->size - (size_t)start : 0;
+        if (count > left) count = left;
+    }
+
+    memcpy(buf, vf->data + start, count);
+    return (ssize_t)count;
+}
+
+ssize_t read(int fd, void *buf, size_t count) {
+    RESOLVE();
+    vfile_t *vf = vfile_acquire(fd);
+    if (!vf) return real_read(fd, buf, count);
+
+    ssize_t n = vfile_read(vf, buf, count, -1);
+    vfile_release(vf);
+    return n;
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
+    RESOLVE();
+    vfile_t *vf = vfile_acquire(fd);
+    if (!vf) return real_pread(fd, buf, count, offset);
+
+    if (offset < 0) {
+        vfile_release(vf);
+        errno = EINVAL;
+        return -1;
+    }
+    ssize_t n = vfile_read(vf, buf, count, offset);
+    vfile_release(vf);
+    return n;
+}
+
+ssize_t pread64(int fd, void *buf, size_t count, off64_t offset) {
+    return pread(fd, buf, count, (off_t)offset);
+}
+
+off_t lseek(int fd, off_t offset, int whence) {
+    RESOLVE();
+    vfile_t *vf = vfile_acquire(fd);
+    if (!vf) return real_lseek(fd, offset, whence);
+
+    off_t ret = -1;
+    pthread_mutex_lock(&fd_lock);
+    switch (whence) {
+    case SEEK_SET: ret = offset; break;
+    case SEEK_CUR: ret = vf->pos + offset; break;
+    case SEEK_END: ret = (off_t)vf->size + offset; break;
+    case SEEK_DATA: ret = offset < (off_t)vf->size ? offset : -1; break;
+    case SEEK_HOLE: ret = offset < (off_t)vf->size ? (off_t)vf->size : -1; break;
+    }
+    if (ret >= 0) vf->pos = ret;
+    pthread_mutex_unlock(&fd_lock);
+
+    if (ret < 0) errno = (whence == SEEK_DATA || whence == SEEK_HOLE) ? ENXIO : EINVAL;
+    vfile_release(vf);
+    return ret;
+}
+
+off64_t lseek64(int fd, off64_t offset, int whence) {
+    return lseek(fd, (off_t)offset, whence);
+}
+
+int close(int fd) {
+    RESOLVE();
+    if (vfile_peek(fd)) vfile_set(fd, NULL);
+    return real_close(fd);
+}
+
+int dup(int fd) {
+    RESOLVE();
+    int ret = real_dup(fd);
+    vfile_t *vf = ret >= 0 ? vfile_acquire(fd) : NULL;
+    if (vf) {
+        vfile_set(ret, vf);
+        vfile_release(vf);
+    }
+    return ret;
+}
+
+static int dup_to(int fd, int target, int ret) {
+    if (ret < 0 || fd == target) return ret;
+
+    vfile_t *vf = vfile_acquire(fd);
+    vfile_set(target, vf);
+    vfile_release(vf);
+    return ret;
+}
+
+int dup2(int fd, int target) {
+    RESOLVE();
+    return dup_to(fd, target, real_dup2(fd, target));
+}
+
+int dup3(int fd, int target, int flags) {
+    RESOLVE();
+    return dup_to(fd, target, real_dup3(fd, target, flags));
+}
+
+// Stat: the placeholder supplies everything except the size
+
+static void patch_stat(struct stat *st, size_t size) {
+    st->st_size = (off_t)size;
+    st->st_blocks = (blkcnt_t)((size + 511) / 512);
+}
+
+static void patch_stat_fd(int fd, struct stat *st) {
+    vfile_t *vf = vfile_acquire(fd);
+    if (vf) {
+        patch_stat(st, vf->size);
+        vfile_release(vf);
+        return;
+    }
+
+    const uint8_t *data;
+    size_t size;
+    if (hackds_is_placeholder(st) && shim_active() && lookup_fd(fd, &data, &size) == 0) {
+        patch_stat(st, size);
+    }
+}
+
+static int stat_common(int dirfd, const char *path, struct stat *st, int flags) {
+    RESOLVE();
+    int ret = real_fstatat(dirfd, path, st, flags);
+    if (ret != 0 || !hackds_is_placeholder(st)) return ret;
+
+    if ((flags & AT_EMPTY_PATH) && path[0] == '\0') {
+        patch_stat_fd(dirfd, st);
+        return ret;
+    }
+    if (!may_be_placeholder(path) || !shim_active()) return ret;
+
+    int oflags = O_PATH | O_CLOEXEC;
+    if (flags & AT_SYMLINK_NOFOLLOW) oflags |= O_NOFOLLOW;
+    int fd = real_openat(dirfd, path, oflags);
+    if (fd >= 0) {
+        patch_stat_fd(fd, st);
+        real_close(fd);
+    }
+    return ret;
+}
+
+int stat(const char *path, struct stat *st) {
+    return stat_common(AT_FDCWD, path, st, 0);
+}
+
+int stat64(const char *path, struct stat64 *st) {
+    return stat_common(AT_FDCWD, path, (struct stat*)st, 0);
+}
+
+int lstat(const char *path, struct stat *st) {
+    return stat_common(AT_FDCWD, path, st, AT_SYMLINK_NOFOLLOW);
+}
+
+int lstat64(const char *path, struct stat64 *st) {
+    return stat_common(AT_FDCWD, path, (struct stat*)st, AT_SYMLINK_NOFOLLOW);
+}
+
+int fstatat(int dirfd, const char *path, struct stat *st, int flags) {
+    return stat_common(dirfd, path, st, flags);
+}
+
+int fstatat64(int dirfd, const char *path, struct stat64 *st, int flags) {
+    return stat_common(dirfd, path, (struct stat*)st, flags);
+}
+
+int fstat(int fd, struct stat *st) {
+    RESOLVE();
+    int ret = real_fstat(fd, st);
+    if (ret == 0 && root_len != 0 && !in_shim) patch_stat_fd(fd, st);
+    return ret;
+}
+
+int fstat64(int fd, struct stat64 *st) {
+    return fstat(fd, (struct stat*)st);
+}
+
+// Entry points used by binaries built against glibc before 2.33
+int __xstat(int ver, const char *path, struct stat *st);
+int __xstat64(int ver, const char *path, struct stat64 *st);
+int __lxstat(int ver, const char *path, struct stat *st);
+int __lxstat64(int ver, const char *path, struct stat64 *st);
+int __fxstat(int ver, int fd, struct stat *st);
+int __fxstat64(int ver, int fd, struct stat64 *st);
+int __fxstatat(int ver, int dirfd, const char *path, struct stat *st, int flags);
+int __fxstatat64(int ver, int dirfd, const char *path, struct stat64 *st, int flags);
+
+int __xstat(int ver, const char *path, struct stat *st) {
+    (void)ver;
+    return stat(path, st);
+}
+
+int __xstat64(int ver, const char *path, struct stat64 *st) {
+    (void)ver;
+    return stat64(path, st);
+}
+
+int __lxstat(int ver, const char *path, struct stat *st) {
+    (void)ver;
+    return lstat(path, st);
+}
+
+int __lxstat64(int ver, const char *path, struct stat64 *st) {
+    (void)ver;
+    return lstat64(path, st);
+}
+
+int __fxstat(int ver, int fd, struct stat *st) {
+    (void)ver;
+    return fstat(fd, st);
+}
+
+int __fxstat64(int ver, int fd, struct stat64 *st) {
+    (void)ver;
+    return fstat64(fd, st);
+}
+
+int __fxstatat(int ver, int dirfd, const char *path, struct stat *st, int flags) {
+    (void)ver;
+    return fstatat(dirfd, path, st, flags);
+}
+
+int __fxstatat64(int ver, int dirfd, const char *path, struct stat64 *st, int flags) {
+    (void)ver;
+    return fstatat64(dirfd, path, st, flags);
+}
+
+// Mappings of a placeholder are private copies: the archive keeps entries
+// at arbitrary offsets, so they cannot be mapped in place
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    RESOLVE();
+    vfile_t *vf = (flags & MAP_ANONYMOUS) ? NULL : vfile_acquire(fd);
+    if (!vf) return real_mmap(addr, length, prot, flags, fd, offset);
+
+    if ((flags & MAP_SHARED) && (prot & PROT_WRITE)) {
+        vfile_release(vf);
+        errno = EACCES;
+        return MAP_FAILED;
+    }
+
+    int anon_flags = (flags & ~(MAP_SHARED | MAP_SHARED_VALIDATE)) |
+                     MAP_PRIVATE | MAP_ANONYMOUS;
+    void *map = real_mmap(addr, length, prot | PROT_WRITE, anon_flags, -1, 0);
+    if (map != MAP_FAILED) {
+        if (offset >= 0 && (size_t)offset < vf->size) {
+            size_t n = vf->size - (size_t)offset;
+            memcpy(map, vf->data + offset, n < length ? n : length);
+        }
+        if (!(prot & PROT_WRITE)) mprotect(map, length, prot);
+    }
+
+    vfile_release(vf);
+    return map;
+}
+
+void *mmap64(void *addr, size_t length, int prot, int flags, int fd, off64_t offset) {
+    return mmap(addr, length, prot, flags, fd, (off_t)offset);
+}
+
+// In-kernel copies would see the empty placeholder, so write the data out
+static ssize_t vfile_copy(vfile_t *vf, off64_t *in_offset, int out,
+                          off64_t *out_offset, size_t count) {
+    off_t start;
+    pthread_mutex_lock(&fd_lock);
+    start = in_offset ? (off_t)*in_offset : vf->pos;
+    size_t left = (size_t)start < vf->size ? vf->size - (size_t)start : 0;
+    if (count > left) count = left;
+    pthread_mutex_unlock(&fd_lock);
+
+    ssize_t n = out_offset ? pwrite(out, vf->data + start, count, (off_t)*out_offset)
+                           : write(out, vf->data + start, count);
+    if (n <= 0) return n;
+
+    if (out_offset) *out_offset += n;
+    if (in_offset) {
+        *in_offset += n;
+    } else {
+        pthread_mutex_lock(&fd_lock);
+        vf->pos = start + n;
+        pthread_mutex_unlock(&fd_lock);
+    }
+    return n;
+}
+
+ssize_t sendfile(int out, int in, off_t *offset, size_t count) {
+    RESOLVE();
+    vfile_t *vf = vfile_acquire(in);
+    if (!vf) return real_sendfile(out, in, offset, count);
+
+    ssize_t n = vfile_copy(vf, (off64_t*)offset, out, NULL, count);
+    vfile_release(vf);
+    return n;
+}
+
+ssize_t sendfile64(int out, int in, off64_t *offset, size_t count) {
+    return sendfile(out, in, (off_t*)offset, count);
+}
+
+ssize_t copy_file_range(int in, off64_t *in_offset, int out, off64_t *out_offset,
+                        size_t count, unsigned int flags) {
+    RESOLVE();
+    vfile_t *vf = vfile_acquire(in);
+    if (!vf) return real_copy_file_range(in, in_offset, out, out_offset, count, flags);
+
+    ssize_t n = vfile_copy(vf, in_offset, out, out_offset, count);
+    vfile_release(vf);
+    return n;
+}
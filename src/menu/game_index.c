@@ -0,0 +1,279 @@
+/*
+ * HackDS GUI Menu System
+ * Persistent index of the game library
+ *
+ * <games>/.hackds-index holds one fixed-size record per .hdsg with the stat
+ * data it was built from. At boot the old index is mapped, the directory is
+ * read once, and only new or changed archives are opened.
+ */
+
+#define _GNU_SOURCE
+#include "game_index.h"
+#include "../libhackds/hackds_format.h"
+#include "../libhackds/hackds_pool.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(game_index_record_t) == 1024, "index record size changed");
+_Static_assert(sizeof(game_index_header_t) == 16, "index header size changed");
+
+static int compare_records(const void *a, const void *b) {
+    return strcmp(((const game_index_record_t*)a)->path,
+                  ((const game_index_record_t*)b)->path);
+}
+
+static bool has_extension(const char *name, const char *ext) {
+    size_t len = strlen(name), ext_len = strlen(ext);
+    return len > ext_len && strcmp(name + len - ext_len, ext) == 0;
+}
+
+// Map an existing index. Returns its records, or NULL if there is none or
+// it was written by another version.
+static const game_index_record_t* map_index(const char *path, void **map,
+                                            size_t *map_size, size_t *count) {
+    *map = NULL;
+    *count = 0;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(game_index_header_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    const game_index_header_t *header = data;
+    if (header->magic != GAME_INDEX_MAGIC || header->version != GAME_INDEX_VERSION ||
+        header->record_size != sizeof(game_index_record_t) ||
+        (size_t)st.st_size != sizeof(*header) +
+                              (size_t)header->count * sizeof(game_index_record_t)) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    *map = data;
+    *map_size = st.st_size;
+    *count = header->count;
+    return (const game_index_record_t*)(header + 1);
+}
+
+static void set_stat(game_index_record_t *record, const struct stat *st) {
+    record->mtime_ns = (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+    record->size = st->st_size;
+    record->inode = st->st_ino;
+}
+
+// Build a record from the archive itself
+static void read_record(game_index_record_t *record) {
+    const char *name = strrchr(record->path, '/');
+    name = name ? name + 1 : record->path;
+
+    hackds_file_t *game = hackds_open_header(record->path);
+    if (game && game->type != HACKDS_TYPE_GAME) {
+        hackds_close(game);
+        game = NULL;
+    }
+    if (!game || hackds_get_metadata_string(game, "name", record->name,
+                                            sizeof(record->name)) != 0 || !record->name[0]) {
+        snprintf(record->name, sizeof(record->name), "%.255s", name);
+    }
+    if (!game) return;
+
+    record->flags |= GAME_INDEX_VALID;
+    if (hackds_get_metadata_string(game, "version", record->version,
+                                   sizeof(record->version)) != 0) {
+        record->version[0] = '\0';
+    }
+    if (hackds_get_metadata_string(game, "author", record->author,
+                                   sizeof(record->author)) != 0) {
+        record->author[0] = '\0';
+    }
+
+    // Icons of stored archives can be read straight from the file later
+    char icon[256];
+    bool stored = !(game->header.flags & (FLAG_COMPRESSED | FLAG_BLOCKED));
+    bool has_icon = hackds_get_metadata_string(game, "icon", icon, sizeof(icon)) == 0;
+    if (has_icon) record->flags |= GAME_INDEX_HAS_ICON;
+    hackds_close(game);
+    if (!stored || !has_icon) return;
+
+    game = hackds_open_mapped(record->path);
+    const uint8_t *data;
+    size_t size;
+    if (game && game->map && hackds_file_view(game, icon, &data, &size) == 0 &&
+        data >= (const uint8_t*)game->map &&
+        data + size <= (const uint8_t*)game->map + game->map_size) {
+        record->icon_offset = data - (const uint8_t*)game->map;
+        record->icon_size = size;
+    }
+    if (game) hackds_close(game);
+}
+
+typedef struct {
+    game_index_record_t *records;
+    game_index_fn fn;
+    void *ctx;
+} read_job_t;
+
+static void read_task(void *arg, size_t index) {
+    read_job_t *job = arg;
+    read_record(&job->records[index]);
+    if (job->fn) job->fn(&job->records[index], 1, job->ctx);
+}
+
+// Append an empty record to a growing array
+static game_index_record_t* add_record(game_index_record_t **list, size_t *count,
+                                       size_t *capacity) {
+    if (*count == *capacity) {
+        size_t grown_capacity = *capacity ? *capacity * 2 : 64;
+        game_index_record_t *grown = realloc(*list, grown_capacity * sizeof(**list));
+        if (!grown) return NULL;
+        *list = grown;
+        *capacity = grown_capacity;
+    }
+
+    game_index_record_t *record = &(*list)[(*count)++];
+    memset(record, 0, sizeof(*record));
+    return record;
+}
+
+// Replace the index atomically. Failure only costs a slower next boot.
+static void write_index(const char *path, const game_index_record_t *records,
+                        size_t count) {
+    char tmp[MAX_INDEX_PATH + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "Warning: cannot write %s\n", tmp);
+        return;
+    }
+
+    game_index_header_t header = {
+        .magic = GAME_INDEX_MAGIC,
+        .version = GAME_INDEX_VERSION,
+        .record_size = sizeof(game_index_record_t),
+        .count = count,
+    };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              (count == 0 || fwrite(records, sizeof(*records), count, f) == count);
+    if (fclose(f) != 0) ok = false;
+
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "Warning: cannot write %s\n", path);
+        unlink(tmp);
+    }
+}
+
+int game_index_read(const char *path, game_index_record_t *record) {
+    memset(record, 0, sizeof(*record));
+
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+
+    snprintf(record->path, sizeof(record->path), "%s", path);
+    set_stat(record, &st);
+    read_record(record);
+    return 0;
+}
+
+int game_index_scan(const char *dir, game_index_record_t **records,
+                    game_index_fn fn, void *ctx) {
+    *records = NULL;
+
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+
+    char index_path[MAX_INDEX_PATH];
+    snprintf(index_path, sizeof(index_path), "%s/%s", dir, GAME_INDEX_NAME);
+
+    void *map;
+    size_t map_size = 0, old_count;
+    const game_index_record_t *old = map_index(index_path, &map, &map_size, &old_count);
+
+    // Records still valid go to list, archives to re-read to fresh
+    game_index_record_t *list = NULL, *fresh = NULL;
+    size_t count = 0, capacity = 0, fresh_count = 0, fresh_capacity = 0;
+    bool failed = false;
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.' || !has_extension(entry->d_name, ".hdsg")) continue;
+
+        struct stat st;
+        if (fstatat(dirfd(d), entry->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        game_index_record_t key;
+        int len = snprintf(key.path, sizeof(key.path), "%s/%s", dir, entry->d_name);
+        if (len < 0 || (size_t)len >= sizeof(key.path)) continue;
+        set_stat(&key, &st);
+
+        const game_index_record_t *cached = old ?
+            bsearch(&key, old, old_count, sizeof(*old), compare_records) : NULL;
+        bool valid = cached && cached->mtime_ns == key.mtime_ns &&
+                     cached->size == key.size && cached->inode == key.inode;
+
+        game_index_record_t *record = valid ? add_record(&list, &count, &capacity)
+                                            : add_record(&fresh, &fresh_count, &fresh_capacity);
+        if (!record) {
+            failed = true;
+            break;
+        }
+
+        if (valid) {
+            memcpy(record, cached, sizeof(*record));
+            // The file is not trusted to be terminated
+            record->name[sizeof(record->name) - 1] = '\0';
+            record->version[sizeof(record->version) - 1] = '\0';
+            record->author[sizeof(record->author) - 1] = '\0';
+        } else {
+            memcpy(record->path, key.path, sizeof(record->path));
+            set_stat(record, &st);
+        }
+    }
+    closedir(d);
+
+    // Anything added, changed or removed means a new index
+    bool stale = !map || fresh_count > 0 || old_count != count;
+    if (map) munmap(map, map_size);
+
+    if (!failed && fresh_count > 0 && count + fresh_count > capacity) {
+        game_index_record_t *grown = realloc(list, (count + fresh_count) * sizeof(*list));
+        if (grown) list = grown;
+        failed = !grown;
+    }
+    if (failed) {
+        free(list);
+        free(fresh);
+        return -1;
+    }
+
+    // Report what is already known before opening anything
+    if (fn && count > 0) fn(list, count, ctx);
+
+    read_job_t job = { fresh, fn, ctx };
+    hackds_pool_run(fresh_count, read_task, &job);
+
+    if (fresh_count > 0) memcpy(list + count, fresh, fresh_count * sizeof(*fresh));
+    count += fresh_count;
+    free(fresh);
+
+    qsort(list, count, sizeof(*list), compare_records);
+    if (stale) write_index(index_path, list, count);
+
+    *records = list;
+    return (int)count;
+}
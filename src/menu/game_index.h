@@ -0,0 +1,61 @@
+/*
+ * HackDS GUI Menu System
+ * Persistent index of the game library
+ */
+
+#ifndef GAME_INDEX_H
+#define GAME_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GAME_INDEX_NAME ".hackds-index"
+#define GAME_INDEX_MAGIC 0x49534448  // "HDSI"
+#define GAME_INDEX_VERSION 2
+#define MAX_INDEX_PATH 512
+
+// Record flags
+#define GAME_INDEX_VALID (1u << 0)   // Metadata was read from a game file
+#define GAME_INDEX_HAS_ICON (1u << 1) // Metadata names an icon
+
+// Fixed-size record per archive. Strings are NUL-terminated.
+typedef struct __attribute__((packed)) {
+    char path[512];
+    int64_t mtime_ns;         // Stat data the record was made from
+    uint64_t size;
+    uint64_t inode;
+    char name[256];           // File name when the metadata has none
+    char version[32];
+    char author[128];
+    uint64_t icon_offset;     // Icon data within the .hdsg, 0 if it has no
+    uint64_t icon_size;       // icon or the payload is compressed
+    uint32_t flags;
+    uint8_t reserved[52];
+} game_index_record_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t count;
+    uint32_t reserved;
+} game_index_header_t;
+
+// Called with records as they become known: all unchanged ones in one
+// batch, then each re-read archive on its own. May be called from several
+// threads at once.
+typedef void (*game_index_fn)(const game_index_record_t *records, size_t count,
+                              void *ctx);
+
+// Bring the index in dir up to date and return its records, sorted by path,
+// in a malloc'd array. Only archives whose size, mtime or inode differ from
+// their record are opened, in parallel on the libhackds worker pool; an
+// unchanged library costs one directory read and a stat per file. fn may be
+// NULL. Returns the number of records, or -1.
+int game_index_scan(const char *dir, game_index_record_t **records,
+                    game_index_fn fn, void *ctx);
+
+// Build the record for a single archive. Returns -1 if it cannot be stat'd.
+int game_index_read(const char *path, game_index_record_t *record);
+
+#endif // GAME_INDEX_H
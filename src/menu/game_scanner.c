@@ -0,0 +1,210 @@
+/*
+ * HackDS GUI Menu System
+ * Background library scanning
+ *
+ * One thread owns the scan. Full scans go through the library index, which
+ * reads changed archives on the libhackds worker pool; afterwards the thread
+ * sleeps in poll() on an inotify watch of the games directory and an
+ * eventfd for rescan and stop requests.
+ */
+
+#define _GNU_SOURCE
+#include "game_scanner.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)
+
+struct game_scanner {
+    char dir[MAX_INDEX_PATH];
+    game_scan_fn fn;
+    void *ctx;
+    pthread_t thread;
+    int inotify_fd;
+    int wake_fd;
+    pthread_mutex_t lock;
+    bool rescan;              // Guarded by lock
+    bool stop;
+};
+
+static void report_found(const game_index_record_t *records, size_t count, void *arg) {
+    game_scanner_t *scanner = arg;
+    scanner->fn(GAME_SCAN_FOUND, records, count, scanner->ctx);
+}
+
+static void full_scan(game_scanner_t *scanner) {
+    scanner->fn(GAME_SCAN_BEGIN, NULL, 0, scanner->ctx);
+
+    game_index_record_t *records;
+    int count = game_index_scan(scanner->dir, &records, report_found, scanner);
+    if (count < 0) {
+        fprintf(stderr, "Warning: cannot scan %s\n", scanner->dir);
+        count = 0;
+    }
+    free(records);
+
+    scanner->fn(GAME_SCAN_DONE, NULL, count, scanner->ctx);
+}
+
+static bool is_game(const char *name) {
+    size_t len = strlen(name);
+    return name[0] != '.' && len > 5 && strcmp(name + len - 5, ".hdsg") == 0;
+}
+
+// Report one changed directory entry
+static void file_changed(game_scanner_t *scanner, const struct inotify_event *event) {
+    if (event->len == 0 || !is_game(event->name)) return;
+
+    game_index_record_t record;
+    char path[MAX_INDEX_PATH];
+    int len = snprintf(path, sizeof(path), "%s/%s", scanner->dir, event->name);
+    if (len < 0 || (size_t)len >= sizeof(path)) return;
+
+    if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) &&
+        game_index_read(path, &record) == 0) {
+        scanner->fn(GAME_SCAN_FOUND, &record, 1, scanner->ctx);
+    } else {
+        memset(&record, 0, sizeof(record));
+        memcpy(record.path, path, len + 1);
+        scanner->fn(GAME_SCAN_REMOVED, &record, 1, scanner->ctx);
+    }
+}
+
+// Handle queued inotify events. Returns false if a full scan is needed.
+static bool read_changes(game_scanner_t *scanner) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        ssize_t n = read(scanner->inotify_fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return true;
+
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *event = (const struct inotify_event*)p;
+            p += sizeof(*event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) return false;
+            file_changed(scanner, event);
+        }
+    }
+}
+
+static void* scanner_main(void *arg) {
+    game_scanner_t *scanner = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&scanner->lock);
+        bool stop = scanner->stop;
+        bool rescan = scanner->rescan;
+        scanner->rescan = false;
+        pthread_mutex_unlock(&scanner->lock);
+
+        if (stop) break;
+        if (rescan) {
+            // Changes queued before the scan are covered by it
+            if (scanner->inotify_fd >= 0) read_changes(scanner);
+            full_scan(scanner);
+        }
+
+        struct pollfd fds[2] = {
+            { .fd = scanner->wake_fd, .events = POLLIN },
+            { .fd = scanner->inotify_fd, .events = POLLIN },
+        };
+        if (poll(fds, scanner->inotify_fd >= 0 ? 2 : 1, -1) < 0 && errno != EINTR) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t value;
+            if (read(scanner->wake_fd, &value, sizeof(value)) < 0) {
+                // Nothing pending; the flags are checked anyway
+            }
+        }
+        if ((fds[1].revents & POLLIN) && !read_changes(scanner)) {
+            pthread_mutex_lock(&scanner->lock);
+            scanner->rescan = true;
+            pthread_mutex_unlock(&scanner->lock);
+        }
+    }
+
+    return NULL;
+}
+
+game_scanner_t* game_scanner_start(const char *dir, game_scan_fn fn, void *ctx) {
+    game_scanner_t *scanner = calloc(1, sizeof(*scanner));
+    if (!scanner) return NULL;
+
+    snprintf(scanner->dir, sizeof(scanner->dir), "%s", dir);
+    scanner->fn = fn;
+    scanner->ctx = ctx;
+    scanner->rescan = true;
+    pthread_mutex_init(&scanner->lock, NULL);
+
+    scanner->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (scanner->wake_fd < 0) {
+        pthread_mutex_destroy(&scanner->lock);
+        free(scanner);
+        return NULL;
+    }
+
+    // Without inotify the library only changes on a rescan
+    scanner->inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (scanner->inotify_fd >= 0 &&
+        inotify_add_watch(scanner->inotify_fd, dir, WATCH_EVENTS) < 0) {
+        close(scanner->inotify_fd);
+        scanner->inotify_fd = -1;
+    }
+    if (scanner->inotify_fd < 0) {
+        fprintf(stderr, "Warning: not watching %s: %s\n", dir, strerror(errno));
+    }
+
+    if (pthread_create(&scanner->thread, NULL, scanner_main, scanner) != 0) {
+        if (scanner->inotify_fd >= 0) close(scanner->inotify_fd);
+        close(scanner->wake_fd);
+        pthread_mutex_destroy(&scanner->lock);
+        free(scanner);
+        return NULL;
+    }
+
+    return scanner;
+}
+
+static void wake(game_scanner_t *scanner) {
+    uint64_t one = 1;
+    if (write(scanner->wake_fd, &one, sizeof(one)) < 0) {
+        // The counter is already non-zero; the thread will wake
+    }
+}
+
+void game_scanner_rescan(game_scanner_t *scanner) {
+    if (!scanner) return;
+
+    pthread_mutex_lock(&scanner->lock);
+    scanner->rescan = true;
+    pthread_mutex_unlock(&scanner->lock);
+    wake(scanner);
+}
+
+void game_scanner_stop(game_scanner_t *scanner) {
+    if (!scanner) return;
+
+    pthread_mutex_lock(&scanner->lock);
+    scanner->stop = true;
+    pthread_mutex_unlock(&scanner->lock);
+    wake(scanner);
+
+    pthread_join(scanner->thread, NULL);
+
+    if (scanner->inotify_fd >= 0) close(scanner->inotify_fd);
+    close(scanner->wake_fd);
+    pthread_mutex_destroy(&scanner->lock);
+    free(scanner);
+}
@@ -0,0 +1,35 @@
+/*
+ * HackDS GUI Menu System
+ * Background library scanning
+ */
+
+#ifndef GAME_SCANNER_H
+#define GAME_SCANNER_H
+
+#include "game_index.h"
+
+typedef enum {
+    GAME_SCAN_BEGIN,          // A full scan started
+    GAME_SCAN_FOUND,          // records were added or changed
+    GAME_SCAN_REMOVED,        // records are gone; only their path is set
+    GAME_SCAN_DONE            // Full scan finished; games not found since
+                              // GAME_SCAN_BEGIN are gone. count is the total.
+} game_scan_event_t;
+
+// Called on the scanner's threads. records are only valid during the call.
+typedef void (*game_scan_fn)(game_scan_event_t event, const game_index_record_t *records,
+                             size_t count, void *ctx);
+
+typedef struct game_scanner game_scanner_t;
+
+// Scan dir in the background, then follow it with inotify so that games
+// copied in or deleted are reported one by one without a rescan.
+game_scanner_t* game_scanner_start(const char *dir, game_scan_fn fn, void *ctx);
+
+// Queue a full scan
+void game_scanner_rescan(game_scanner_t *scanner);
+
+// Stop the scanner and wait for its thread. No calls are made afterwards.
+void game_scanner_stop(game_scanner_t *scanner);
+
+#endif // GAME_SCANNER_H
@@ -0,0 +1,407 @@
+/*
+ * HackDS GUI Menu System
+ * Game icons, decoded in the background
+ *
+ * The UI thread queues requests for icons that are on screen; a worker
+ * reads the icon file, decodes it and scales it down to the tile size, and
+ * posts the small surface back as an SDL event. Only the upload of that
+ * surface happens on the UI thread.
+ */
+
+#define _GNU_SOURCE
+#include "icon_cache.h"
+#include "../libhackds/hackds_format.h"
+#include <SDL2/SDL_image.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#define MAX_QUEUED 64             // Older requests are dropped first
+#define MAX_ICON_FILE (4 * 1024 * 1024)
+#define BUCKETS 1024
+#define WORKER_NICE 10            // Decoding yields to the UI thread
+
+typedef enum {
+    ICON_NONE = 0,
+    ICON_QUEUED,
+    ICON_READY,
+    ICON_MISSING              // No icon or it failed to decode
+} icon_state_t;
+
+typedef struct icon_entry {
+    char *path;
+    icon_state_t state;
+    unsigned request;         // Id of the request in flight
+    SDL_Texture *texture;
+    unsigned long last_used;  // Frame it was last drawn in
+    struct icon_entry *next;  // Hash chain
+} icon_entry_t;
+
+typedef struct {
+    char path[512];
+    uint64_t icon_offset;
+    uint64_t icon_size;
+    unsigned id;
+} icon_request_t;
+
+typedef struct {
+    char path[512];
+    unsigned id;
+    SDL_Surface *surface;     // NULL if there is no usable icon
+} icon_result_t;
+
+struct icon_cache {
+    SDL_Renderer *renderer;
+    int size;
+    Uint32 event_type;
+    size_t budget;            // Bytes of texture memory
+    size_t used;
+
+    icon_entry_t *buckets[BUCKETS];
+    unsigned long frame;
+    unsigned next_request;
+
+    // Shared with the worker
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    icon_request_t queue[MAX_QUEUED];
+    int queued;
+    bool stop;
+};
+
+static size_t hash_path(const char *path) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char*)path; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash % BUCKETS;
+}
+
+static icon_entry_t* find_entry(icon_cache_t *cache, const char *path) {
+    for (icon_entry_t *entry = cache->buckets[hash_path(path)]; entry; entry = entry->next) {
+        if (strcmp(entry->path, path) == 0) return entry;
+    }
+    return NULL;
+}
+
+// Shrink src into the w x h area of dest at (x, y), averaging the source
+// pixels behind each destination pixel. Colors are weighted by alpha so
+// that transparent edges do not darken.
+static void downscale(const SDL_Surface *src, SDL_Surface *dest, int x, int y, int w, int h) {
+    for (int dy = 0; dy < h; dy++) {
+        int sy0 = dy * src->h / h, sy1 = (dy + 1) * src->h / h;
+        if (sy1 <= sy0) sy1 = sy0 + 1;
+
+        Uint32 *out = (Uint32*)((Uint8*)dest->pixels + (y + dy) * dest->pitch) + x;
+        for (int dx = 0; dx < w; dx++) {
+            int sx0 = dx * src->w / w, sx1 = (dx + 1) * src->w / w;
+            if (sx1 <= sx0) sx1 = sx0 + 1;
+
+            uint64_t a = 0, r = 0, g = 0, b = 0, n = 0;
+            for (int sy = sy0; sy < sy1; sy++) {
+                const Uint32 *in = (const Uint32*)((const Uint8*)src->pixels + sy * src->pitch);
+                for (int sx = sx0; sx < sx1; sx++) {
+                    Uint32 p = in[sx];
+                    Uint32 pa = p >> 24;
+                    a += pa;
+                    r += pa * ((p >> 16) & 0xFF);
+                    g += pa * ((p >> 8) & 0xFF);
+                    b += pa * (p & 0xFF);
+                    n++;
+                }
+            }
+
+            out[dx] = a ? (Uint32)(a / n) << 24 | (Uint32)(r / a) << 16 |
+                          (Uint32)(g / a) << 8 | (Uint32)(b / a) : 0;
+        }
+    }
+}
+
+// Decode an image file and fit it into a size x size ARGB surface
+static SDL_Surface* scale_icon(const uint8_t *data, size_t len, int size) {
+    SDL_RWops *rw = SDL_RWFromConstMem(data, (int)len);
+    SDL_Surface *image = rw ? IMG_Load_RW(rw, 1) : NULL;
+    if (!image) return NULL;
+
+    SDL_Surface *argb = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(image);
+    if (!argb) return NULL;
+
+    SDL_Surface *icon = SDL_CreateRGBSurfaceWithFormat(0, size, size, 32,
+                                                       SDL_PIXELFORMAT_ARGB8888);
+    if (icon && argb->w > 0 && argb->h > 0) {
+        // Keep the aspect ratio, centered; never scale up
+        int w = argb->w, h = argb->h;
+        if (w > size || h > size) {
+            if (w >= h) {
+                h = h * size / w;
+                w = size;
+            } else {
+                w = w * size / h;
+                h = size;
+            }
+        }
+        if (w < 1) w = 1;
+        if (h < 1) h = 1;
+
+        SDL_FillRect(icon, NULL, 0);
+        SDL_LockSurface(argb);
+        downscale(argb, icon, (size - w) / 2, (size - h) / 2, w, h);
+        SDL_UnlockSurface(argb);
+    }
+
+    SDL_FreeSurface(argb);
+    return icon;
+}
+
+static SDL_Surface* decode_icon(const icon_request_t *request, int size) {
+    hackds_file_t *game = NULL;
+    uint8_t *buf = NULL;
+    const uint8_t *data = NULL;
+    size_t len = 0;
+
+    if (request->icon_size > 0) {
+        // Stored archive: the index knows where the bytes are
+        int fd = request->icon_size <= MAX_ICON_FILE ? open(request->path, O_RDONLY | O_CLOEXEC) : -1;
+        buf = fd >= 0 ? malloc(request->icon_size) : NULL;
+        if (buf && pread(fd, buf, request->icon_size, request->icon_offset) ==
+                   (ssize_t)request->icon_size) {
+            data = buf;
+            len = request->icon_size;
+        }
+        if (fd >= 0) close(fd);
+    } else {
+        char name[256];
+        game = hackds_open_mapped(request->path);
+        if (game && hackds_get_metadata_string(game, "icon", name, sizeof(name)) == 0 &&
+            hackds_file_view(game, name, &data, &len) != 0) {
+            data = NULL;
+        }
+    }
+
+    SDL_Surface *icon = data && len <= MAX_ICON_FILE ? scale_icon(data, len, size) : NULL;
+
+    free(buf);
+    if (game) hackds_close(game);
+    return icon;
+}
+
+static void* worker_main(void *arg) {
+    icon_cache_t *cache = arg;
+
+    // Linux applies nice values per thread
+    if (setpriority(PRIO_PROCESS, gettid(), WORKER_NICE) != 0) {
+        // Decoding still works, it just competes with drawing
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    for (;;) {
+        while (!cache->stop && cache->queued == 0) {
+            pthread_cond_wait(&cache->wake, &cache->lock);
+        }
+        if (cache->stop) break;
+
+        // Newest first: that is what is on screen now
+        icon_request_t request = cache->queue[--cache->queued];
+        pthread_mutex_unlock(&cache->lock);
+
+        icon_result_t *result = malloc(sizeof(*result));
+        if (result) {
+            memcpy(result->path, request.path, sizeof(result->path));
+            result->id = request.id;
+            result->surface = decode_icon(&request, cache->size);
+
+            SDL_Event event;
+            memset(&event, 0, sizeof(event));
+            event.type = cache->event_type;
+            event.user.data1 = result;
+            if (SDL_PushEvent(&event) != 1) {
+                SDL_FreeSurface(result->surface);
+                free(result);
+            }
+        }
+
+        pthread_mutex_lock(&cache->lock);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    return NULL;
+}
+
+icon_cache_t* icon_cache_create(SDL_Renderer *renderer, int size, Uint32 event_type) {
+    icon_cache_t *cache = calloc(1, sizeof(*cache));
+    if (!cache) return NULL;
+
+    cache->renderer = renderer;
+    cache->size = size;
+    cache->event_type = event_type;
+
+    const char *env = getenv("HACKDS_ICON_CACHE_MB");
+    int mb = env && atoi(env) > 0 ? atoi(env) : ICON_CACHE_MB;
+    cache->budget = (size_t)mb * 1024 * 1024;
+
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_cond_init(&cache->wake, NULL);
+
+    if (pthread_create(&cache->worker, NULL, worker_main, cache) != 0) {
+        pthread_cond_destroy(&cache->wake);
+        pthread_mutex_destroy(&cache->lock);
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+static void free_entry(icon_cache_t *cache, icon_entry_t *entry) {
+    if (entry->texture) {
+        SDL_DestroyTexture(entry->texture);
+        cache->used -= (size_t)cache->size * cache->size * 4;
+    }
+    free(entry->path);
+    free(entry);
+}
+
+void icon_cache_destroy(icon_cache_t *cache) {
+    if (!cache) return;
+
+    pthread_mutex_lock(&cache->lock);
+    cache->stop = true;
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+    pthread_join(cache->worker, NULL);
+
+    // Results that were posted but never handled
+    SDL_Event event;
+    while (SDL_PeepEvents(&event, 1, SDL_GETEVENT, cache->event_type, cache->event_type) > 0) {
+        icon_result_t *result = event.user.data1;
+        SDL_FreeSurface(result->surface);
+        free(result);
+    }
+
+    for (int i = 0; i < BUCKETS; i++) {
+        while (cache->buckets[i]) {
+            icon_entry_t *entry = cache->buckets[i];
+            cache->buckets[i] = entry->next;
+            free_entry(cache, entry);
+        }
+    }
+
+    pthread_cond_destroy(&cache->wake);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+void icon_cache_frame(icon_cache_t *cache) {
+    cache->frame++;
+}
+
+static void queue_request(icon_cache_t *cache, icon_entry_t *entry,
+                          uint64_t icon_offset, uint64_t icon_size) {
+    icon_request_t request = {
+        .icon_offset = icon_offset,
+        .icon_size = icon_size,
+        .id = ++cache->next_request,
+    };
+    snprintf(request.path, sizeof(request.path), "%s", entry->path);
+
+    pthread_mutex_lock(&cache->lock);
+    if (cache->queued == MAX_QUEUED) {
+        // Scrolled past long ago; asked for again if it comes back
+        icon_entry_t *dropped = find_entry(cache, cache->queue[0].path);
+        if (dropped && dropped->request == cache->queue[0].id) dropped->state = ICON_NONE;
+        memmove(&cache->queue[0], &cache->queue[1], (MAX_QUEUED - 1) * sizeof(request));
+        cache->queued--;
+    }
+    cache->queue[cache->queued++] = request;
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+
+    entry->state = ICON_QUEUED;
+    entry->request = request.id;
+}
+
+SDL_Texture* icon_cache_get(icon_cache_t *cache, const char *path,
+                            uint64_t icon_offset, uint64_t icon_size) {
+    icon_entry_t *entry = find_entry(cache, path);
+    if (!entry) {
+        entry = calloc(1, sizeof(*entry));
+        if (!entry) return NULL;
+        entry->path = strdup(path);
+        if (!entry->path) {
+            free(entry);
+            return NULL;
+        }
+
+        size_t bucket = hash_path(path);
+        entry->next = cache->buckets[bucket];
+        cache->buckets[bucket] = entry;
+    }
+
+    entry->last_used = cache->frame;
+    if (entry->state == ICON_NONE) queue_request(cache, entry, icon_offset, icon_size);
+
+    return entry->texture;
+}
+
+// Drop least recently drawn textures until the budget is met. Icons drawn
+// in the current frame stay, even over budget.
+static void evict(icon_cache_t *cache) {
+    while (cache->used > cache->budget) {
+        icon_entry_t *oldest = NULL;
+        for (int i = 0; i < BUCKETS; i++) {
+            for (icon_entry_t *entry = cache->buckets[i]; entry; entry = entry->next) {
+                if (entry->texture && entry->last_used < cache->frame &&
+                    (!oldest || entry->last_used < oldest->last_used)) {
+                    oldest = entry;
+                }
+            }
+        }
+        if (!oldest) return;
+
+        SDL_DestroyTexture(oldest->texture);
+        oldest->texture = NULL;
+        oldest->state = ICON_NONE;
+        cache->used -= (size_t)cache->size * cache->size * 4;
+    }
+}
+
+int icon_cache_handle_event(icon_cache_t *cache, const SDL_UserEvent *event) {
+    icon_result_t *result = event->data1;
+    icon_entry_t *entry = find_entry(cache, result->path);
+    int added = 0;
+
+    // Results for games that changed since are stale
+    if (entry && entry->state == ICON_QUEUED && entry->request == result->id) {
+        entry->state = ICON_MISSING;
+        if (result->surface) {
+            entry->texture = SDL_CreateTextureFromSurface(cache->renderer, result->surface);
+        }
+        if (entry->texture) {
+            entry->state = ICON_READY;
+            cache->used += (size_t)cache->size * cache->size * 4;
+            added = 1;
+            evict(cache);
+        }
+    }
+
+    SDL_FreeSurface(result->surface);
+    free(result);
+    return added;
+}
+
+void icon_cache_invalidate(icon_cache_t *cache, const char *path) {
+    icon_entry_t **link = &cache->buckets[hash_path(path)];
+    while (*link && strcmp((*link)->path, path) != 0) link = &(*link)->next;
+    if (!*link) return;
+
+    icon_entry_t *entry = *link;
+    *link = entry->next;
+    free_entry(cache, entry);
+}
@@ -0,0 +1,41 @@
+/*
+ * HackDS GUI Menu System
+ * Game icons, decoded in the background
+ */
+
+#ifndef ICON_CACHE_H
+#define ICON_CACHE_H
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+#define ICON_CACHE_MB 8           // Default texture budget
+
+typedef struct icon_cache icon_cache_t;
+
+// Icons are decoded on a worker thread, scaled to fit size x size, and
+// uploaded on the calling thread when their result event is handled.
+// Textures are kept within a budget of HACKDS_ICON_CACHE_MB megabytes,
+// least recently drawn first out. event_type is an SDL user event
+// registered for the cache.
+icon_cache_t* icon_cache_create(SDL_Renderer *renderer, int size, Uint32 event_type);
+
+void icon_cache_destroy(icon_cache_t *cache);
+
+// Start a new frame. Icons drawn during it are not evicted.
+void icon_cache_frame(icon_cache_t *cache);
+
+// Texture for a game's icon, or NULL while it is decoding or if the game
+// has none. The first call queues it; newest requests are decoded first.
+// icon_offset and icon_size locate the icon inside a stored archive, as
+// recorded in the library index; 0 reads it through libhackds.
+SDL_Texture* icon_cache_get(icon_cache_t *cache, const char *path,
+                            uint64_t icon_offset, uint64_t icon_size);
+
+// Upload a decoded icon. Returns 1 if a texture was added.
+int icon_cache_handle_event(icon_cache_t *cache, const SDL_UserEvent *event);
+
+// Forget a game's icon after the game changed or was removed
+void icon_cache_invalidate(icon_cache_t *cache, const char *path);
+
+#endif // ICON_CACHE_H
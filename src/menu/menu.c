@@ -4,18 +4,24 @@
  */
 
 #include "../libhackds/hackds_format.h"
+#include "game_scanner.h"
+#include "icon_cache.h"
+#include "text_render.h"
+#include "update_check.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include <SDL2/SDL_image.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
 #include <unistd.h>
 
 #define SCREEN_WIDTH 1280
 #define SCREEN_HEIGHT 720
 #define GAME_DIR "/games"
 #define SETTINGS_FILE "/settings/system.hdss"
+#define ICON_SIZE 48
 
 #define COLOR_BG      {20, 20, 30, 255}
 #define COLOR_TEXT    {220, 220, 220, 255}
@@ -27,7 +33,13 @@ typedef struct {
     char name[256];
     char version[32];
     char author[128];
-    SDL_Texture *icon;
+    int64_t mtime_ns;         // Stat data of the record, to tell a changed
+    uint64_t size;            // game from a rescan of the same one
+    uint64_t inode;
+    int has_icon;
+    uint64_t icon_offset;     // Where the index found the icon, if stored
+    uint64_t icon_size;
+    int seen;                 // Reported by the current full scan
 } game_entry_t;
 
 typedef struct {
@@ -36,23 +48,33 @@ typedef struct {
     TTF_Font *font_large;
     TTF_Font *font_small;
     TTF_Font *font_tiny;
-    game_entry_t *games;
+    text_renderer_t *text;
+    icon_cache_t *icons;
+    game_entry_t *games;      // Sorted by path
     int game_count;
+    int game_capacity;
+    game_scanner_t *scanner;
+    int scanning;
     int selected_index;
     int scroll_offset;
-    int update_available;
-    char update_version[32];
+    update_check_t *update_check;
+    update_status_t update;
+    int dirty;                // Screen is out of date
 } menu_state_t;
 
-static int scan_games(menu_state_t *state);
+static void post_scan_event(game_scan_event_t kind, const game_index_record_t *records,
+                            size_t count, void *ctx);
+static void handle_scan_event(menu_state_t *state, const SDL_UserEvent *event);
 static void render_menu(menu_state_t *state);
-static void render_text(SDL_Renderer *renderer, TTF_Font *font,
-                       const char *text, int x, int y, SDL_Color color);
 static int launch_game(const char *game_path);
 static void cleanup(menu_state_t *state);
-static void check_for_updates(menu_state_t *state);
 static void trigger_update(void);
 
+// SDL event types for scanner results, decoded icons and update checks
+static Uint32 scan_event = (Uint32)-1;
+static Uint32 icon_event = (Uint32)-1;
+static Uint32 update_event = (Uint32)-1;
+
 int main(int argc, char *argv[]) {
     (void)argc;
     (void)argv;
@@ -108,36 +130,93 @@ int main(int argc, char *argv[]) {
     state.font_large = TTF_OpenFont("/system/share/fonts/default.ttf", 32);
     state.font_small = TTF_OpenFont("/system/share/fonts/default.ttf", 20);
     state.font_tiny = TTF_OpenFont("/system/share/fonts/default.ttf", 16);
+    state.text = text_renderer_create(state.renderer);
+    if (!state.text) {
+        fprintf(stderr, "Failed to create text renderer\n");
+        cleanup(&state);
+        return 1;
+    }
 
     if (!state.font_large || !state.font_small || !state.font_tiny) {
         fprintf(stderr, "TTF_OpenFont failed: %s\n", TTF_GetError());
         // Continue without fonts - we can still show colored boxes
     }
 
+    // Icons are decoded in the background; games show without one until then
+    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+        fprintf(stderr, "IMG_Init failed: %s\n", IMG_GetError());
+    }
+    icon_event = SDL_RegisterEvents(1);
+    if (icon_event != (Uint32)-1) {
+        state.icons = icon_cache_create(state.renderer, ICON_SIZE, icon_event);
+    }
+    if (!state.icons) {
+        fprintf(stderr, "Failed to start icon decoder\n");
+    }
+
     // Hide cursor
     SDL_ShowCursor(SDL_DISABLE);
 
-    // Scan for games
+    // Scan for games in the background; results arrive as events
     printf("Scanning for games...\n");
-    scan_games(&state);
-    printf("Found %d games\n", state.game_count);
+    scan_event = SDL_RegisterEvents(1);
+    if (scan_event != (Uint32)-1) {
+        state.scanner = game_scanner_start(GAME_DIR, post_scan_event, NULL);
+    }
+    if (!state.scanner) {
+        fprintf(stderr, "Failed to start game scanner\n");
+    }
 
-    // Check for updates
-    check_for_updates(&state);
+    // Show the last update check's result; a stale one is checked again
+    // in the background
+    update_event = SDL_RegisterEvents(1);
+    if (update_event != (Uint32)-1) {
+        state.update_check = update_check_start(update_event, &state.update);
+    }
 
     // Main loop
     int running = 1;
     SDL_Event event;
+    state.dirty = 1;
 
     while (running) {
-        // Handle events
-        while (SDL_PollEvent(&event)) {
+        // Handle events. Nothing on screen moves by itself, so unless a
+        // redraw is due, sleep until an event arrives.
+        for (int have_event = state.dirty ? SDL_PollEvent(&event)
+                                          : SDL_WaitEventTimeout(&event, -1);
+             have_event; have_event = SDL_PollEvent(&event)) {
+            if (event.type == scan_event) {
+                handle_scan_event(&state, &event.user);
+                state.dirty = 1;
+                continue;
+            }
+            if (event.type == icon_event) {
+                if (icon_cache_handle_event(state.icons, &event.user)) state.dirty = 1;
+                continue;
+            }
+            if (event.type == update_event) {
+                if (update_check_result(state.update_check, &state.update)) state.dirty = 1;
+                if (state.update.available) {
+                    printf("Update found: %s\n", state.update.version);
+                } else {
+                    printf("No updates available\n");
+                }
+                continue;
+            }
+
             switch (event.type) {
                 case SDL_QUIT:
                     running = 0;
                     break;
 
+                case SDL_WINDOWEVENT:
+                case SDL_RENDER_TARGETS_RESET:
+                case SDL_RENDER_DEVICE_RESET:
+                    state.dirty = 1;
+                    break;
+
                 case SDL_KEYDOWN:
+                    state.dirty = 1;
                     switch (event.key.keysym.sym) {
                         case SDLK_ESCAPE:
                         case SDLK_q:
@@ -177,18 +256,18 @@ int main(int argc, char *argv[]) {
                         case SDLK_r:
                             // Rescan games
                             printf("Rescanning games...\n");
-                            scan_games(&state);
+                            game_scanner_rescan(state.scanner);
                             break;
 
                         case SDLK_u:
                             // Check for updates
                             printf("Checking for updates...\n");
-                            check_for_updates(&state);
+                            update_check_request(state.update_check);
                             break;
 
                         case SDLK_i:
                             // Install update if available
-                            if (state.update_available) {
+                            if (state.update.available) {
                                 printf("Installing update...\n");
                                 trigger_update();
                             }
@@ -204,6 +283,7 @@ int main(int argc, char *argv[]) {
                     break;
 
                 case SDL_CONTROLLERBUTTONDOWN:
+                    state.dirty = 1;
                     switch (event.cbutton.button) {
                         case SDL_CONTROLLER_BUTTON_DPAD_UP:
                             if (state.selected_index > 0) state.selected_index--;
@@ -223,7 +303,7 @@ int main(int argc, char *argv[]) {
                         case SDL_CONTROLLER_BUTTON_RIGHTSHOULDER:
                             // Triangle on PS5 - Check for updates
                             printf("Checking for updates...\n");
-                            check_for_updates(&state);
+                            update_check_request(state.update_check);
                             break;
                         case SDL_CONTROLLER_BUTTON_BACK:
                         case SDL_CONTROLLER_BUTTON_GUIDE:
@@ -240,10 +320,11 @@ int main(int argc, char *argv[]) {
             }
         }
 
-        // Render
-        render_menu(&state);
-
-        SDL_Delay(16);  // ~60 FPS
+        // Render only if an event changed something
+        if (state.dirty && running) {
+            render_menu(&state);
+            state.dirty = 0;
+        }
     }
 
     cleanup(&state);
@@ -251,102 +332,151 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
-static int scan_games(menu_state_t *state) {
-    // Free existing games
-    if (state->games) {
-        for (int i = 0; i < state->game_count; i++) {
-            if (state->games[i].icon) {
-                SDL_DestroyTexture(state->games[i].icon);
-            }
-        }
-        free(state->games);
-    }
+// Scanner callback, on a scanner thread: hand the records to the UI thread
+static void post_scan_event(game_scan_event_t kind, const game_index_record_t *records,
+                            size_t count, void *ctx) {
+    (void)ctx;
 
-    state->games = NULL;
-    state->game_count = 0;
-    state->selected_index = 0;
-    state->scroll_offset = 0;
+    game_index_record_t *copy = NULL;
+    if (records && count > 0) {
+        copy = malloc(count * sizeof(*copy));
+        if (!copy) return;
+        memcpy(copy, records, count * sizeof(*copy));
+    }
 
-    DIR *dir = opendir(GAME_DIR);
-    if (!dir) {
-        printf("No games directory found\n");
-        return 0;
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = scan_event;
+    event.user.code = kind;
+    event.user.data1 = copy;
+    event.user.data2 = (void*)(uintptr_t)count;
+    if (SDL_PushEvent(&event) != 1) {
+        free(copy);
     }
+}
 
-    // Count .hdsg files
-    struct dirent *entry;
-    int count = 0;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, ".hdsg") != NULL) {
-            count++;
+// Index of path in the games list, or where it would be inserted
+static int find_game(const menu_state_t *state, const char *path, int *found) {
+    int lo = 0, hi = state->game_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(state->games[mid].path, path);
+        if (cmp == 0) {
+            *found = 1;
+            return mid;
         }
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
     }
+    *found = 0;
+    return lo;
+}
 
-    if (count == 0) {
-        closedir(dir);
-        return 0;
-    }
+static void keep_selection_visible(menu_state_t *state) {
+    int visible_count = 8;
 
-    // Allocate game entries
-    state->games = calloc(count, sizeof(game_entry_t));
-    if (!state->games) {
-        closedir(dir);
-        return -1;
+    if (state->selected_index >= state->game_count) state->selected_index = state->game_count - 1;
+    if (state->selected_index < 0) state->selected_index = 0;
+    if (state->scroll_offset > state->selected_index) state->scroll_offset = state->selected_index;
+    if (state->selected_index >= state->scroll_offset + visible_count) {
+        state->scroll_offset = state->selected_index - visible_count + 1;
     }
+}
 
-    // Load game info
-    rewinddir(dir);
-    int index = 0;
-    while ((entry = readdir(dir)) != NULL && index < count) {
-        if (strstr(entry->d_name, ".hdsg") == NULL) continue;
-
-        snprintf(state->games[index].path, sizeof(state->games[index].path),
-                "%s/%s", GAME_DIR, entry->d_name);
-
-        // Try to load game metadata
-        hackds_file_t *game = hackds_open(state->games[index].path);
-        if (game && game->type == HACKDS_TYPE_GAME) {
-            const char *metadata = hackds_get_metadata(game);
-            if (metadata) {
-                // Parse name, version, author (simple parsing)
-                const char *name = strstr(metadata, "\"name\"");
-                if (name) {
-                    name = strchr(name, '"');
-                    if (name) {
-                        name = strchr(name + 1, '"');
-                        if (name) {
-                            name++;
-                            const char *end = strchr(name, '"');
-                            if (end) {
-                                size_t len = end - name;
-                                if (len < sizeof(state->games[index].name)) {
-                                    strncpy(state->games[index].name, name, len);
-                                    state->games[index].name[len] = '\0';
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-            hackds_close(game);
+// Add a game, or refresh it if it is already listed
+static void add_game(menu_state_t *state, const game_index_record_t *record) {
+    int found;
+    int index = find_game(state, record->path, &found);
+
+    if (!found) {
+        if (state->game_count == state->game_capacity) {
+            int capacity = state->game_capacity ? state->game_capacity * 2 : 64;
+            game_entry_t *games = realloc(state->games, capacity * sizeof(game_entry_t));
+            if (!games) return;
+            state->games = games;
+            state->game_capacity = capacity;
         }
+        memmove(&state->games[index + 1], &state->games[index],
+                (state->game_count - index) * sizeof(game_entry_t));
+        memset(&state->games[index], 0, sizeof(game_entry_t));
 
-        // If name wasn't loaded, use filename
-        if (state->games[index].name[0] == '\0') {
-            strncpy(state->games[index].name, entry->d_name,
-                   sizeof(state->games[index].name) - 1);
+        // Keep the same game selected
+        if (state->game_count > 0 && index <= state->selected_index) {
+            state->selected_index++;
         }
-
-        index++;
+        state->game_count++;
     }
 
-    state->game_count = index;
-    closedir(dir);
+    game_entry_t *game = &state->games[index];
+    // Every full scan reports every game again; only a changed file can
+    // have a different icon
+    int changed = game->mtime_ns != record->mtime_ns || game->size != record->size ||
+                  game->inode != record->inode || game->icon_offset != record->icon_offset ||
+                  game->icon_size != record->icon_size;
+    if (found && changed && state->icons) icon_cache_invalidate(state->icons, record->path);
+    memcpy(game->path, record->path, sizeof(game->path));
+    memcpy(game->name, record->name, sizeof(game->name));
+    memcpy(game->version, record->version, sizeof(game->version));
+    memcpy(game->author, record->author, sizeof(game->author));
+    game->mtime_ns = record->mtime_ns;
+    game->size = record->size;
+    game->inode = record->inode;
+    game->has_icon = (record->flags & GAME_INDEX_HAS_ICON) != 0;
+    game->icon_offset = record->icon_offset;
+    game->icon_size = record->icon_size;
+    game->seen = 1;
+
+    keep_selection_visible(state);
+}
+
+static void remove_game(menu_state_t *state, int index) {
+    if (state->icons) icon_cache_invalidate(state->icons, state->games[index].path);
+    memmove(&state->games[index], &state->games[index + 1],
+            (state->game_count - index - 1) * sizeof(game_entry_t));
+    state->game_count--;
+
+    if (index < state->selected_index) state->selected_index--;
+    keep_selection_visible(state);
+}
+
+static void handle_scan_event(menu_state_t *state, const SDL_UserEvent *event) {
+    const game_index_record_t *records = event->data1;
+    size_t count = (uintptr_t)event->data2;
+    int found;
+
+    switch (event->code) {
+        case GAME_SCAN_BEGIN:
+            state->scanning = 1;
+            for (int i = 0; i < state->game_count; i++) state->games[i].seen = 0;
+            break;
+
+        case GAME_SCAN_FOUND:
+            for (size_t i = 0; i < count; i++) add_game(state, &records[i]);
+            break;
+
+        case GAME_SCAN_REMOVED:
+            for (size_t i = 0; i < count; i++) {
+                int index = find_game(state, records[i].path, &found);
+                if (found) remove_game(state, index);
+            }
+            break;
 
-    return index;
+        case GAME_SCAN_DONE:
+            for (int i = state->game_count - 1; i >= 0; i--) {
+                if (!state->games[i].seen) remove_game(state, i);
+            }
+            state->scanning = 0;
+            printf("Found %d games\n", state->game_count);
+            break;
+    }
+
+    free(event->data1);
 }
 
 static void render_menu(menu_state_t *state) {
+    text_frame_begin(state->text);
+    if (state->icons) icon_cache_frame(state->icons);
+
     SDL_Color bg = COLOR_BG;
     SDL_Color text = COLOR_TEXT;
     SDL_Color selected = COLOR_SELECTED;
@@ -362,19 +492,23 @@ static void render_menu(menu_state_t *state) {
     SDL_RenderFillRect(state->renderer, &title_bar);
 
     if (state->font_large) {
-        render_text(state->renderer, state->font_large, "HackDS", 40, 20, text);
+        text_draw_label(state->text, state->font_large, "HackDS", 40, 20, text);
     }
 
     if (state->font_small) {
         char count_text[64];
-        snprintf(count_text, sizeof(count_text), "%d games", state->game_count);
-        render_text(state->renderer, state->font_small, count_text,
-                   SCREEN_WIDTH - 150, 30, text);
+        if (state->scanning) {
+            snprintf(count_text, sizeof(count_text), "%d games...", state->game_count);
+        } else {
+            snprintf(count_text, sizeof(count_text), "%d games", state->game_count);
+        }
+        text_draw(state->text, state->font_small, count_text,
+                  SCREEN_WIDTH - 150, 30, text);
     }
 
     // Draw update notification if available
     int y_offset = 80;
-    if (state->update_available) {
+    if (state->update.available) {
         SDL_Color update_color = {255, 200, 50, 255};
         SDL_SetRenderDrawColor(state->renderer, 200, 150, 0, 255);
         SDL_Rect update_bar = {0, y_offset, SCREEN_WIDTH, 40};
@@ -384,9 +518,9 @@ static void render_menu(menu_state_t *state) {
             char update_text[128];
             snprintf(update_text, sizeof(update_text),
                     "Update Available: %s - Press 'I' to Install",
-                    state->update_version);
-            render_text(state->renderer, state->font_small, update_text,
-                       40, y_offset + 10, (SDL_Color){0, 0, 0, 255});
+                    state->update.version);
+            text_draw(state->text, state->font_small, update_text,
+                      40, y_offset + 10, (SDL_Color){0, 0, 0, 255});
         }
         y_offset += 40;
     }
@@ -408,43 +542,44 @@ static void render_menu(menu_state_t *state) {
             SDL_RenderFillRect(state->renderer, &highlight);
         }
 
+        // Draw icon once it has been decoded
+        game_entry_t *game = &state->games[i];
+        SDL_Texture *icon = game->has_icon && state->icons ?
+            icon_cache_get(state->icons, game->path, game->icon_offset, game->icon_size) : NULL;
+        if (icon) {
+            SDL_Rect dest = {30, item_y + (60 - ICON_SIZE) / 2, ICON_SIZE, ICON_SIZE};
+            SDL_RenderCopy(state->renderer, icon, NULL, &dest);
+        }
+
         // Draw game name
         if (state->font_small) {
             SDL_Color color = (i == state->selected_index) ? (SDL_Color){255, 255, 255, 255} : text;
-            render_text(state->renderer, state->font_small,
-                       state->games[i].name, 40, item_y + 15, color);
+            text_draw(state->text, state->font_small,
+                      game->name, 40 + ICON_SIZE + 10, item_y + 15, color);
+        }
+    }
+
+    // Decode the next page ahead of scrolling
+    for (int i = state->scroll_offset + visible_count;
+         i < state->game_count && i < state->scroll_offset + 2 * visible_count; i++) {
+        game_entry_t *game = &state->games[i];
+        if (game->has_icon && state->icons) {
+            icon_cache_get(state->icons, game->path, game->icon_offset, game->icon_size);
         }
     }
 
     // Draw controls hint
     if (state->font_small) {
         const char *hint = "UP/DOWN: Select  |  ENTER: Play  |  F1/TAB: Settings  |  U: Updates  |  ESC: Exit";
-        render_text(state->renderer, state->font_small, hint, 40, SCREEN_HEIGHT - 60, text);
+        text_draw_label(state->text, state->font_small, hint, 40, SCREEN_HEIGHT - 60, text);
 
         // Controller hint
         const char *controller_hint = "Controller: D-Pad: Navigate  |  X: Play  |  Triangle: Updates  |  Options: Settings";
-        render_text(state->renderer, state->font_tiny,
-                   controller_hint, 40, SCREEN_HEIGHT - 35, (SDL_Color){150, 150, 150, 255});
-    }
-
-    SDL_RenderPresent(state->renderer);
-}
-
-static void render_text(SDL_Renderer *renderer, TTF_Font *font,
-                       const char *text, int x, int y, SDL_Color color) {
-    if (!font) return;
-
-    SDL_Surface *surface = TTF_RenderText_Blended(font, text, color);
-    if (!surface) return;
-
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
-    if (texture) {
-        SDL_Rect dest = {x, y, surface->w, surface->h};
-        SDL_RenderCopy(renderer, texture, NULL, &dest);
-        SDL_DestroyTexture(texture);
+        text_draw_label(state->text, state->font_tiny,
+                        controller_hint, 40, SCREEN_HEIGHT - 35, (SDL_Color){150, 150, 150, 255});
     }
 
-    SDL_FreeSurface(surface);
+    text_frame_present(state->text);
 }
 
 static int launch_game(const char *game_path) {
@@ -472,65 +607,30 @@ static int launch_game(const char *game_path) {
 }
 
 static void cleanup(menu_state_t *state) {
-    if (state->games) {
-        for (int i = 0; i < state->game_count; i++) {
-            if (state->games[i].icon) {
-                SDL_DestroyTexture(state->games[i].icon);
-            }
-        }
-        free(state->games);
+    update_check_stop(state->update_check);
+    icon_cache_destroy(state->icons);
+    game_scanner_stop(state->scanner);
+
+    // Results the scanner posted but the loop never handled
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        if (event.type == scan_event) free(event.user.data1);
     }
 
+    free(state->games);
+
+    text_renderer_destroy(state->text);
     if (state->font_large) TTF_CloseFont(state->font_large);
     if (state->font_small) TTF_CloseFont(state->font_small);
     if (state->font_tiny) TTF_CloseFont(state->font_tiny);
     if (state->renderer) SDL_DestroyRenderer(state->renderer);
     if (state->window) SDL_DestroyWindow(state->window);
 
+    IMG_Quit();
     TTF_Quit();
     SDL_Quit();
 }
 
-static void check_for_updates(menu_state_t *state) {
-    // Run the update checker in silent mode
-    FILE *fp = popen("/system/bin/hackds-updater check 2>/dev/null", "r");
-    if (!fp) {
-        printf("Failed to run update checker\n");
-        return;
-    }
-
-    char buffer[256];
-    state->update_available = 0;
-
-    while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-        // Look for "Update available:" in output
-        if (strstr(buffer, "Update available:") != NULL) {
-            state->update_available = 1;
-
-            // Extract version number
-            char *version_start = strstr(buffer, ": ");
-            if (version_start) {
-                version_start += 2;
-                char *version_end = strchr(version_start, '\n');
-                if (version_end) *version_end = '\0';
-
-                strncpy(state->update_version, version_start,
-                       sizeof(state->update_version) - 1);
-                state->update_version[sizeof(state->update_version) - 1] = '\0';
-            }
-
-            printf("Update found: %s\n", state->update_version);
-            break;
-        }
-    }
-
-    pclose(fp);
-
-    if (!state->update_available) {
-        printf("No updates available\n");
-    }
-}
-
 static void trigger_update(void) {
     printf("Triggering system update...\n");
 
@@ -3,6 +3,7 @@
  * Settings interface for WiFi, Bluetooth, and system configuration
  */
 
+#include "text_render.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <stdio.h>
@@ -33,6 +34,7 @@ typedef struct {
     TTF_Font *font_large;
     TTF_Font *font_small;
     TTF_Font *font_tiny;
+    text_renderer_t *text;
     menu_mode_t current_menu;
     int selected_index;
     char status_message[256];
@@ -43,8 +45,6 @@ static void render_main_menu(settings_state_t *state);
 static void render_wifi_menu(settings_state_t *state);
 static void render_bluetooth_menu(settings_state_t *state);
 static void render_system_menu(settings_state_t *state);
-static void render_text(SDL_Renderer *renderer, TTF_Font *font,
-                       const char *text, int x, int y, SDL_Color color);
 static void set_status(settings_state_t *state, const char *message);
 static void init_controller(settings_state_t *state);
 
@@ -96,6 +96,18 @@ int run_settings_menu(void) {
     state.font_large = TTF_OpenFont("/system/share/fonts/default.ttf", 36);
     state.font_small = TTF_OpenFont("/system/share/fonts/default.ttf", 24);
     state.font_tiny = TTF_OpenFont("/system/share/fonts/default.ttf", 18);
+    state.text = text_renderer_create(state.renderer);
+    if (!state.text) {
+        fprintf(stderr, "Text renderer creation failed\n");
+        if (state.font_large) TTF_CloseFont(state.font_large);
+        if (state.font_small) TTF_CloseFont(state.font_small);
+        if (state.font_tiny) TTF_CloseFont(state.font_tiny);
+        SDL_DestroyRenderer(state.renderer);
+        SDL_DestroyWindow(state.window);
+        TTF_Quit();
+        SDL_Quit();
+        return 1;
+    }
 
     // Hide cursor
     SDL_ShowCursor(SDL_DISABLE);
@@ -225,6 +237,7 @@ int run_settings_menu(void) {
         }
 
         // Render based on current menu
+        text_frame_begin(state.text);
         switch (state.current_menu) {
             case MENU_MAIN:
                 render_main_menu(&state);
@@ -245,6 +258,7 @@ int run_settings_menu(void) {
 
     // Cleanup
     if (state.controller) SDL_GameControllerClose(state.controller);
+    text_renderer_destroy(state.text);
     if (state.font_large) TTF_CloseFont(state.font_large);
     if (state.font_small) TTF_CloseFont(state.font_small);
     if (state.font_tiny) TTF_CloseFont(state.font_tiny);
@@ -290,8 +304,8 @@ static void render_main_menu(settings_state_t *state) {
     SDL_RenderFillRect(state->renderer, &title_bar);
 
     if (state->font_large) {
-        render_text(state->renderer, state->font_large,
-                   "⚙ Settings", 40, 20, text);
+        text_draw_label(state->text, state->font_large,
+                        "⚙ Settings", 40, 20, text);
     }
 
     // Menu items
@@ -314,8 +328,8 @@ static void render_main_menu(settings_state_t *state) {
         if (state->font_small) {
             SDL_Color color = (i == state->selected_index) ?
                 (SDL_Color){255, 255, 255, 255} : text;
-            render_text(state->renderer, state->font_small,
-                       items[i], 60, y + 15, color);
+            text_draw_label(state->text, state->font_small,
+                            items[i], 60, y + 15, color);
         }
 
         y += 80;
@@ -323,8 +337,8 @@ static void render_main_menu(settings_state_t *state) {
 
     // Status message
     if (state->font_tiny) {
-        render_text(state->renderer, state->font_tiny,
-                   state->status_message, 40, SCREEN_HEIGHT - 60, text);
+        text_draw(state->text, state->font_tiny,
+                  state->status_message, 40, SCREEN_HEIGHT - 60, text);
     }
 
     // Controls hint
@@ -332,11 +346,11 @@ static void render_main_menu(settings_state_t *state) {
         const char *hint = state->controller ?
             "D-Pad: Navigate | A/X: Select | B/Circle: Back" :
             "Arrow Keys: Navigate | Enter: Select | ESC: Back";
-        render_text(state->renderer, state->font_tiny,
-                   hint, 40, SCREEN_HEIGHT - 35, text);
+        text_draw_label(state->text, state->font_tiny,
+                        hint, 40, SCREEN_HEIGHT - 35, text);
     }
 
-    SDL_RenderPresent(state->renderer);
+    text_frame_present(state->text);
 }
 
 static void render_wifi_menu(settings_state_t *state) {
@@ -353,25 +367,25 @@ static void render_wifi_menu(settings_state_t *state) {
     SDL_RenderFillRect(state->renderer, &title_bar);
 
     if (state->font_large) {
-        render_text(state->renderer, state->font_large,
-                   "WiFi Settings", 40, 20, text);
+        text_draw_label(state->text, state->font_large,
+                        "WiFi Settings", 40, 20, text);
     }
 
     if (state->font_small) {
-        render_text(state->renderer, state->font_small,
-                   "WiFi configuration managed via command line", 400, 300, text);
-        render_text(state->renderer, state->font_small,
-                   "Run: wifi-manager scan", 400, 350, text);
-        render_text(state->renderer, state->font_small,
-                   "Then: wifi-manager connect <SSID> <password>", 400, 400, text);
+        text_draw_label(state->text, state->font_small,
+                        "WiFi configuration managed via command line", 400, 300, text);
+        text_draw_label(state->text, state->font_small,
+                        "Run: wifi-manager scan", 400, 350, text);
+        text_draw_label(state->text, state->font_small,
+                        "Then: wifi-manager connect <SSID> <password>", 400, 400, text);
     }
 
     if (state->font_tiny) {
-        render_text(state->renderer, state->font_tiny,
-                   "Press B/Circle or ESC to go back", 40, SCREEN_HEIGHT - 35, text);
+        text_draw_label(state->text, state->font_tiny,
+                        "Press B/Circle or ESC to go back", 40, SCREEN_HEIGHT - 35, text);
     }
 
-    SDL_RenderPresent(state->renderer);
+    text_frame_present(state->text);
 }
 
 static void render_bluetooth_menu(settings_state_t *state) {
@@ -388,27 +402,27 @@ static void render_bluetooth_menu(settings_state_t *state) {
     SDL_RenderFillRect(state->renderer, &title_bar);
 
     if (state->font_large) {
-        render_text(state->renderer, state->font_large,
-                   "Bluetooth Settings", 40, 20, text);
+        text_draw_label(state->text, state->font_large,
+                        "Bluetooth Settings", 40, 20, text);
     }
 
     if (state->font_small) {
-        render_text(state->renderer, state->font_small,
-                   "PS5 Controller Pairing:", 300, 250, text);
-        render_text(state->renderer, state->font_small,
-                   "1. Hold PS + Share until light flashes", 300, 300, text);
-        render_text(state->renderer, state->font_small,
-                   "2. Run: bluetooth-manager ps5-setup", 300, 350, text);
-        render_text(state->renderer, state->font_small,
-                   "3. Follow on-screen prompts", 300, 400, text);
+        text_draw_label(state->text, state->font_small,
+                        "PS5 Controller Pairing:", 300, 250, text);
+        text_draw_label(state->text, state->font_small,
+                        "1. Hold PS + Share until light flashes", 300, 300, text);
+        text_draw_label(state->text, state->font_small,
+                        "2. Run: bluetooth-manager ps5-setup", 300, 350, text);
+        text_draw_label(state->text, state->font_small,
+                        "3. Follow on-screen prompts", 300, 400, text);
     }
 
     if (state->font_tiny) {
-        render_text(state->renderer, state->font_tiny,
-                   "Press B/Circle or ESC to go back", 40, SCREEN_HEIGHT - 35, text);
+        text_draw_label(state->text, state->font_tiny,
+                        "Press B/Circle or ESC to go back", 40, SCREEN_HEIGHT - 35, text);
     }
 
-    SDL_RenderPresent(state->renderer);
+    text_frame_present(state->text);
 }
 
 static void render_system_menu(settings_state_t *state) {
@@ -425,42 +439,25 @@ static void render_system_menu(settings_state_t *state) {
     SDL_RenderFillRect(state->renderer, &title_bar);
 
     if (state->font_large) {
-        render_text(state->renderer, state->font_large,
-                   "System Settings", 40, 20, text);
+        text_draw_label(state->text, state->font_large,
+                        "System Settings", 40, 20, text);
     }
 
     if (state->font_small) {
-        render_text(state->renderer, state->font_small,
-                   "HackDS v0.1.0", 400, 250, text);
-        render_text(state->renderer, state->font_small,
-                   "Auto-updates: Press U in main menu", 400, 300, text);
-        render_text(state->renderer, state->font_small,
-                   "System info: Run 'uname -a'", 400, 350, text);
+        text_draw_label(state->text, state->font_small,
+                        "HackDS v0.1.0", 400, 250, text);
+        text_draw_label(state->text, state->font_small,
+                        "Auto-updates: Press U in main menu", 400, 300, text);
+        text_draw_label(state->text, state->font_small,
+                        "System info: Run 'uname -a'", 400, 350, text);
     }
 
     if (state->font_tiny) {
-        render_text(state->renderer, state->font_tiny,
-                   "Press B/Circle or ESC to go back", 40, SCREEN_HEIGHT - 35, text);
-    }
-
-    SDL_RenderPresent(state->renderer);
-}
-
-static void render_text(SDL_Renderer *renderer, TTF_Font *font,
-                       const char *text, int x, int y, SDL_Color color) {
-    if (!font) return;
-
-    SDL_Surface *surface = TTF_RenderText_Blended(font, text, color);
-    if (!surface) return;
-
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
-    if (texture) {
-        SDL_Rect dest = {x, y, surface->w, surface->h};
-        SDL_RenderCopy(renderer, texture, NULL, &dest);
-        SDL_DestroyTexture(texture);
+        text_draw_label(state->text, state->font_tiny,
+                        "Press B/Circle or ESC to go back", 40, SCREEN_HEIGHT - 35, text);
     }
 
-    SDL_FreeSurface(surface);
+    text_frame_present(state->text);
 }
 
 int main(int argc, char *argv[]) {
@@ -0,0 +1,345 @@
+/*
+ * HackDS GUI Menu System
+ * Cached text rendering shared by the menu and settings
+ *
+ * Glyphs are rendered in white once per font into an atlas texture and
+ * tinted with the texture color mod when drawn. Labels are whole strings
+ * kept as textures and evicted least recently used first.
+ */
+
+#define _GNU_SOURCE
+#include "text_render.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ATLAS_SIZE 1024
+#define MAX_FONTS 8
+#define MAX_LABELS 64
+#define STATS_INTERVAL 120        // Frames
+
+typedef enum {
+    GLYPH_UNKNOWN = 0,
+    GLYPH_CACHED,
+    GLYPH_UNCACHED                // Atlas full or glyph failed to render
+} glyph_state_t;
+
+typedef struct {
+    Uint16 ch;
+    glyph_state_t state;
+    SDL_Rect rect;                // Position in the atlas
+    int advance;
+} glyph_t;
+
+typedef struct {
+    TTF_Font *font;
+    SDL_Texture *atlas;
+    int shelf_x, shelf_y, shelf_height;
+    glyph_t latin1[256];
+    glyph_t *extra;               // Other characters, searched linearly
+    size_t extra_count;
+    size_t extra_capacity;
+} font_atlas_t;
+
+typedef struct {
+    TTF_Font *font;
+    char *str;
+    SDL_Texture *texture;
+    int w, h;
+    unsigned long last_used;      // Frame number
+} label_t;
+
+struct text_renderer {
+    SDL_Renderer *renderer;
+    bool enabled;
+    font_atlas_t fonts[MAX_FONTS];
+    int font_count;
+    label_t labels[MAX_LABELS];
+    unsigned long frame;
+
+    // Frame stats
+    bool stats;
+    Uint64 frame_start;
+    double cpu_ms, present_ms;
+    unsigned long rasterized;     // Glyphs or strings turned into pixels
+    unsigned long uploaded;       // Texture creations and updates
+    unsigned long stats_frames;
+};
+
+static const SDL_Color white = {255, 255, 255, 255};
+
+text_renderer_t* text_renderer_create(SDL_Renderer *renderer) {
+    text_renderer_t *text = calloc(1, sizeof(*text));
+    if (!text) return NULL;
+
+    text->renderer = renderer;
+    const char *env = getenv("HACKDS_TEXT_CACHE");
+    text->enabled = !env || strcmp(env, "0") != 0;
+    env = getenv("HACKDS_FRAME_STATS");
+    text->stats = env && strcmp(env, "0") != 0;
+
+    return text;
+}
+
+void text_renderer_destroy(text_renderer_t *text) {
+    if (!text) return;
+
+    for (int i = 0; i < text->font_count; i++) {
+        if (text->fonts[i].atlas) SDL_DestroyTexture(text->fonts[i].atlas);
+        free(text->fonts[i].extra);
+    }
+    for (int i = 0; i < MAX_LABELS; i++) {
+        if (text->labels[i].texture) SDL_DestroyTexture(text->labels[i].texture);
+        free(text->labels[i].str);
+    }
+    free(text);
+}
+
+// Render without any cache
+static void draw_uncached(text_renderer_t *text, TTF_Font *font, const char *str,
+                          int x, int y, SDL_Color color) {
+    SDL_Surface *surface = TTF_RenderUTF8_Blended(font, str, color);
+    if (!surface) return;
+
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(text->renderer, surface);
+    if (texture) {
+        SDL_Rect dest = {x, y, surface->w, surface->h};
+        SDL_RenderCopy(text->renderer, texture, NULL, &dest);
+        SDL_DestroyTexture(texture);
+    }
+    text->rasterized++;
+    text->uploaded++;
+
+    SDL_FreeSurface(surface);
+}
+
+static font_atlas_t* get_atlas(text_renderer_t *text, TTF_Font *font) {
+    for (int i = 0; i < text->font_count; i++) {
+        if (text->fonts[i].font == font) return &text->fonts[i];
+    }
+    if (text->font_count == MAX_FONTS) return NULL;
+
+    SDL_Texture *atlas = SDL_CreateTexture(text->renderer, SDL_PIXELFORMAT_ARGB8888,
+                                           SDL_TEXTUREACCESS_STATIC, ATLAS_SIZE, ATLAS_SIZE);
+    if (!atlas) return NULL;
+    SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
+
+    font_atlas_t *fa = &text->fonts[text->font_count++];
+    memset(fa, 0, sizeof(*fa));
+    fa->font = font;
+    fa->atlas = atlas;
+    return fa;
+}
+
+// Find space for a w x h glyph on the atlas shelves
+static bool pack(font_atlas_t *fa, int w, int h, SDL_Rect *rect) {
+    if (w > ATLAS_SIZE || h > ATLAS_SIZE) return false;
+
+    if (fa->shelf_x + w > ATLAS_SIZE) {
+        fa->shelf_y += fa->shelf_height;
+        fa->shelf_x = 0;
+        fa->shelf_height = 0;
+    }
+    if (fa->shelf_y + h > ATLAS_SIZE) return false;
+
+    *rect = (SDL_Rect){fa->shelf_x, fa->shelf_y, w, h};
+    fa->shelf_x += w + 1;
+    if (h + 1 > fa->shelf_height) fa->shelf_height = h + 1;
+    return true;
+}
+
+static glyph_t* find_glyph(font_atlas_t *fa, Uint16 ch) {
+    if (ch < 256) return &fa->latin1[ch];
+
+    for (size_t i = 0; i < fa->extra_count; i++) {
+        if (fa->extra[i].ch == ch) return &fa->extra[i];
+    }
+
+    if (fa->extra_count == fa->extra_capacity) {
+        size_t capacity = fa->extra_capacity ? fa->extra_capacity * 2 : 32;
+        glyph_t *extra = realloc(fa->extra, capacity * sizeof(*extra));
+        if (!extra) return NULL;
+        fa->extra = extra;
+        fa->extra_capacity = capacity;
+    }
+
+    glyph_t *glyph = &fa->extra[fa->extra_count++];
+    memset(glyph, 0, sizeof(*glyph));
+    glyph->ch = ch;
+    return glyph;
+}
+
+// Look up a glyph, adding it to the atlas on first use
+static glyph_t* get_glyph(text_renderer_t *text, font_atlas_t *fa, Uint16 ch) {
+    glyph_t *glyph = find_glyph(fa, ch);
+    if (!glyph || glyph->state != GLYPH_UNKNOWN) return glyph;
+
+    glyph->state = GLYPH_UNCACHED;
+    int minx, maxx, miny, maxy;
+    if (TTF_GlyphMetrics(fa->font, ch, &minx, &maxx, &miny, &maxy, &glyph->advance) != 0) {
+        return glyph;
+    }
+
+    SDL_Surface *surface = TTF_RenderGlyph_Blended(fa->font, ch, white);
+    if (!surface) return glyph;
+    text->rasterized++;
+
+    if (pack(fa, surface->w, surface->h, &glyph->rect) &&
+        SDL_UpdateTexture(fa->atlas, &glyph->rect, surface->pixels, surface->pitch) == 0) {
+        glyph->state = GLYPH_CACHED;
+        text->uploaded++;
+    }
+    SDL_FreeSurface(surface);
+    return glyph;
+}
+
+// Next character of a UTF-8 string. Characters outside the basic
+// multilingual plane, which SDL_ttf glyph calls cannot take, become '?'.
+static Uint16 next_char(const char **str) {
+    const unsigned char *s = (const unsigned char*)*str;
+    Uint32 ch = s[0];
+    int extra = ch >= 0xF0 ? 3 : ch >= 0xE0 ? 2 : ch >= 0xC0 ? 1 : 0;
+    if (extra) ch &= 0x3F >> extra;
+
+    int i = 1;
+    for (; i <= extra && (s[i] & 0xC0) == 0x80; i++) {
+        ch = (ch << 6) | (s[i] & 0x3F);
+    }
+    *str += i;
+
+    if (i <= extra || (ch >= 0x80 && ch < 0xA0) || ch > 0xFFFF) return '?';
+    return (Uint16)ch;
+}
+
+void text_draw(text_renderer_t *text, TTF_Font *font, const char *str,
+               int x, int y, SDL_Color color) {
+    if (!font || !str[0]) return;
+
+    font_atlas_t *fa = text->enabled ? get_atlas(text, font) : NULL;
+    if (!fa) {
+        draw_uncached(text, font, str, x, y, color);
+        return;
+    }
+
+    // Every glyph must be in the atlas, or the string is drawn as a whole
+    for (const char *p = str; *p; ) {
+        glyph_t *glyph = get_glyph(text, fa, next_char(&p));
+        if (!glyph || glyph->state != GLYPH_CACHED) {
+            draw_uncached(text, font, str, x, y, color);
+            return;
+        }
+    }
+
+    SDL_SetTextureColorMod(fa->atlas, color.r, color.g, color.b);
+    SDL_SetTextureAlphaMod(fa->atlas, color.a);
+
+    int pen = x;
+    Uint16 prev = 0;
+    for (const char *p = str; *p; ) {
+        Uint16 ch = next_char(&p);
+        glyph_t *glyph = find_glyph(fa, ch);
+
+        if (prev) pen += TTF_GetFontKerningSizeGlyphs(font, prev, ch);
+        SDL_Rect dest = {pen, y, glyph->rect.w, glyph->rect.h};
+        SDL_RenderCopy(text->renderer, fa->atlas, &glyph->rect, &dest);
+        pen += glyph->advance;
+        prev = ch;
+    }
+}
+
+static label_t* get_label(text_renderer_t *text, TTF_Font *font, const char *str) {
+    label_t *victim = &text->labels[0];
+    for (int i = 0; i < MAX_LABELS; i++) {
+        label_t *label = &text->labels[i];
+        if (label->texture && label->font == font && strcmp(label->str, str) == 0) {
+            return label;
+        }
+        if (!label->texture || (victim->texture && label->last_used < victim->last_used)) {
+            victim = label;
+        }
+    }
+
+    char *copy = strdup(str);
+    if (!copy) return NULL;
+
+    SDL_Surface *surface = TTF_RenderUTF8_Blended(font, str, white);
+    if (!surface) {
+        free(copy);
+        return NULL;
+    }
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(text->renderer, surface);
+    text->rasterized++;
+    text->uploaded++;
+    if (!texture) {
+        SDL_FreeSurface(surface);
+        free(copy);
+        return NULL;
+    }
+
+    if (victim->texture) SDL_DestroyTexture(victim->texture);
+    free(victim->str);
+    victim->font = font;
+    victim->str = copy;
+    victim->texture = texture;
+    victim->w = surface->w;
+    victim->h = surface->h;
+    SDL_FreeSurface(surface);
+    return victim;
+}
+
+void text_draw_label(text_renderer_t *text, TTF_Font *font, const char *str,
+                     int x, int y, SDL_Color color) {
+    if (!font || !str[0]) return;
+
+    label_t *label = text->enabled ? get_label(text, font, str) : NULL;
+    if (!label) {
+        draw_uncached(text, font, str, x, y, color);
+        return;
+    }
+
+    label->last_used = text->frame;
+    SDL_SetTextureColorMod(label->texture, color.r, color.g, color.b);
+    SDL_SetTextureAlphaMod(label->texture, color.a);
+
+    SDL_Rect dest = {x, y, label->w, label->h};
+    SDL_RenderCopy(text->renderer, label->texture, NULL, &dest);
+}
+
+void text_frame_begin(text_renderer_t *text) {
+    text->frame++;
+    if (text->stats) text->frame_start = SDL_GetPerformanceCounter();
+}
+
+static double elapsed_ms(Uint64 from, Uint64 to) {
+    return (double)(to - from) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+void text_frame_present(text_renderer_t *text) {
+    if (!text->stats) {
+        SDL_RenderPresent(text->renderer);
+        return;
+    }
+
+    // CPU: building the frame. Present: the driver flushing it, which is
+    // where GPU work and uploads show up (plus vsync wait if enabled).
+    Uint64 built = SDL_GetPerformanceCounter();
+    SDL_RenderPresent(text->renderer);
+    Uint64 presented = SDL_GetPerformanceCounter();
+
+    text->cpu_ms += elapsed_ms(text->frame_start, built);
+    text->present_ms += elapsed_ms(built, presented);
+
+    if (++text->stats_frames == STATS_INTERVAL) {
+        double n = (double)text->stats_frames;
+        printf("Frame: cpu %.3f ms, present %.3f ms, %.2f rasterized, %.2f uploads "
+               "(text cache %s)\n",
+               text->cpu_ms / n, text->present_ms / n, text->rasterized / n,
+               text->uploaded / n, text->enabled ? "on" : "off");
+        text->cpu_ms = 0;
+        text->present_ms = 0;
+        text->rasterized = 0;
+        text->uploaded = 0;
+        text->stats_frames = 0;
+    }
+}
@@ -0,0 +1,38 @@
+/*
+ * HackDS GUI Menu System
+ * Cached text rendering shared by the menu and settings
+ */
+
+#ifndef TEXT_RENDER_H
+#define TEXT_RENDER_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+typedef struct text_renderer text_renderer_t;
+
+// HACKDS_TEXT_CACHE=0 renders every string from scratch, as before the
+// caches existed. HACKDS_FRAME_STATS=1 prints frame timings every 2 s.
+text_renderer_t* text_renderer_create(SDL_Renderer *renderer);
+
+// Free cached textures. Call before the fonts are closed.
+void text_renderer_destroy(text_renderer_t *text);
+
+// Draw text that changes, laid out from a glyph atlas kept per font.
+// Glyphs are rasterized and uploaded once. text is UTF-8.
+void text_draw(text_renderer_t *text, TTF_Font *font, const char *str,
+               int x, int y, SDL_Color color);
+
+// Draw a fixed label, such as a title or a control hint, from a cached
+// texture of the whole string
+void text_draw_label(text_renderer_t *text, TTF_Font *font, const char *str,
+                     int x, int y, SDL_Color color);
+
+// Mark the start of drawing a frame
+void text_frame_begin(text_renderer_t *text);
+
+// Present the frame. Also accounts its CPU and present time when frame
+// stats are on.
+void text_frame_present(text_renderer_t *text);
+
+#endif // TEXT_RENDER_H
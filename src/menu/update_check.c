@@ -0,0 +1,258 @@
+/*
+ * HackDS GUI Menu System
+ * System update check, off the UI thread
+ *
+ * hackds-updater can take as long as its network timeout, so it runs in a
+ * child process read by a short-lived thread. The last result is saved
+ * with the time it was found, which lets the menu show it at once and skip
+ * the check entirely on most boots.
+ */
+
+#define _GNU_SOURCE
+#include "update_check.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UPDATER "/system/bin/hackds-updater"
+#define CHECK_NICE 10             // Starting the updater yields to the UI
+
+struct update_check {
+    Uint32 event_type;
+    char cache_path[512];
+    pthread_t thread;
+    bool joinable;            // UI thread only
+
+    // Shared with the check thread
+    pthread_mutex_t lock;
+    bool running;
+    bool stop;
+    pid_t pid;                // Updater's process group, 0 once it is done
+    bool has_result;
+    update_status_t result;
+};
+
+// Saved result: the time of the check, then the version or an empty line
+static bool load_cache(const char *path, update_status_t *status, time_t *checked) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return false;
+
+    char line[64];
+    bool ok = false;
+    if (fgets(line, sizeof(line), fp)) {
+        char *end;
+        long long when = strtoll(line, &end, 10);
+        if (end != line && *end == '\n') {
+            *checked = (time_t)when;
+            memset(status, 0, sizeof(*status));
+            if (fgets(line, sizeof(line), fp)) {
+                snprintf(status->version, sizeof(status->version), "%.*s",
+                         (int)strcspn(line, "\n"), line);
+                status->available = status->version[0] != '\0';
+            }
+            ok = true;
+        }
+    }
+
+    fclose(fp);
+    return ok;
+}
+
+static void save_cache(const char *path, const update_status_t *status) {
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash && slash != dir) {
+        *slash = '\0';
+        mkdir(dir, 0755);
+    }
+
+    char tmp[sizeof(dir) + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "w");
+    if (!fp) return;
+
+    fprintf(fp, "%lld\n%s\n", (long long)time(NULL), status->available ? status->version : "");
+    if (fclose(fp) != 0 || rename(tmp, path) != 0) {
+        fprintf(stderr, "Warning: cannot save %s\n", path);
+        unlink(tmp);
+    }
+}
+
+// Run "hackds-updater check". Returns false if it did not finish normally or
+// could not tell whether there is an update.
+static bool run_updater(update_check_t *check, update_status_t *status) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) < 0) return false;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Own process group, so that stop reaches anything it starts
+        setpgid(0, 0);
+        dup2(fds[1], STDOUT_FILENO);
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) dup2(null, STDERR_FILENO);
+        setpriority(PRIO_PROCESS, 0, CHECK_NICE);
+        char *args[] = {UPDATER, "check", NULL};
+        execv(UPDATER, args);
+        _exit(127);
+    }
+    // Also from this side, so that a stop right after fork() cannot miss
+    // the group; fails harmlessly once the child has exec'd
+    if (pid > 0) setpgid(pid, pid);
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return false;
+    }
+
+    pthread_mutex_lock(&check->lock);
+    check->pid = pid;
+    if (check->stop) kill(-pid, SIGTERM);
+    pthread_mutex_unlock(&check->lock);
+
+    FILE *fp = fdopen(fds[0], "r");
+    if (!fp) close(fds[0]);
+
+    // The updater prints its errors and exits 0 all the same, so only a
+    // positive answer counts as a finished check
+    char buffer[256];
+    bool line_start = true;
+    bool up_to_date = false;
+    bool failed = false;
+    memset(status, 0, sizeof(*status));
+    while (fp && fgets(buffer, sizeof(buffer), fp) != NULL) {
+        bool whole_line = line_start;
+        line_start = strchr(buffer, '\n') != NULL;
+        if (!whole_line) continue;
+
+        if (strncmp(buffer, "Error", 5) == 0 || strncmp(buffer, "HTTP Error", 10) == 0) {
+            failed = true;
+        } else if (strncmp(buffer, "Already up to date", 18) == 0) {
+            up_to_date = true;
+        } else if (strncmp(buffer, "Update available: ", 18) == 0 && !status->available) {
+            const char *found = buffer + strlen("Update available: ");
+            snprintf(status->version, sizeof(status->version), "%.*s",
+                     (int)strcspn(found, "\n"), found);
+            status->available = 1;
+        }
+    }
+    if (fp) fclose(fp);
+
+    // The updater closed its output, so it is exiting; stop must not signal
+    // the pid once it has been reaped
+    pthread_mutex_lock(&check->lock);
+    check->pid = 0;
+    bool stopped = check->stop;
+    pthread_mutex_unlock(&check->lock);
+
+    int wstatus;
+    while (waitpid(pid, &wstatus, 0) < 0) {
+        if (errno != EINTR) return false;
+    }
+    return !stopped && !failed && (status->available || up_to_date) &&
+           WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0;
+}
+
+static void* check_main(void *arg) {
+    update_check_t *check = arg;
+
+    update_status_t status;
+    bool ok = run_updater(check, &status);
+    if (ok) save_cache(check->cache_path, &status);
+
+    pthread_mutex_lock(&check->lock);
+    check->running = false;
+    if (ok) {
+        check->result = status;
+        check->has_result = true;
+    }
+    bool stop = check->stop;
+    pthread_mutex_unlock(&check->lock);
+
+    if (!stop) {
+        SDL_Event event = {0};
+        event.type = check->event_type;
+        SDL_PushEvent(&event);
+    }
+    return NULL;
+}
+
+update_check_t* update_check_start(Uint32 event_type, update_status_t *status) {
+    update_check_t *check = calloc(1, sizeof(*check));
+    if (!check) return NULL;
+
+    check->event_type = event_type;
+    const char *path = getenv("HACKDS_UPDATE_CACHE");
+    snprintf(check->cache_path, sizeof(check->cache_path), "%s",
+             path && *path ? path : UPDATE_CACHE_FILE);
+    pthread_mutex_init(&check->lock, NULL);
+
+    time_t checked = 0;
+    memset(status, 0, sizeof(*status));
+    bool cached = load_cache(check->cache_path, status, &checked);
+
+    // A clock that went backwards makes the result stale too
+    time_t now = time(NULL);
+    if (!cached || now < checked || now - checked >= UPDATE_CHECK_INTERVAL) {
+        update_check_request(check);
+    }
+    return check;
+}
+
+void update_check_request(update_check_t *check) {
+    if (!check) return;
+
+    pthread_mutex_lock(&check->lock);
+    if (check->running || check->stop) {
+        pthread_mutex_unlock(&check->lock);
+        return;
+    }
+    check->running = true;
+    pthread_mutex_unlock(&check->lock);
+
+    // The previous check has finished; only its thread is left
+    if (check->joinable) pthread_join(check->thread, NULL);
+    check->joinable = pthread_create(&check->thread, NULL, check_main, check) == 0;
+
+    if (!check->joinable) {
+        pthread_mutex_lock(&check->lock);
+        check->running = false;
+        pthread_mutex_unlock(&check->lock);
+    }
+}
+
+int update_check_result(update_check_t *check, update_status_t *status) {
+    if (!check) return 0;
+
+    pthread_mutex_lock(&check->lock);
+    int changed = check->has_result && memcmp(&check->result, status, sizeof(*status)) != 0;
+    if (changed) *status = check->result;
+    check->has_result = false;
+    pthread_mutex_unlock(&check->lock);
+
+    return changed;
+}
+
+void update_check_stop(update_check_t *check) {
+    if (!check) return;
+
+    pthread_mutex_lock(&check->lock);
+    check->stop = true;
+    if (check->pid > 0) kill(-check->pid, SIGTERM);
+    pthread_mutex_unlock(&check->lock);
+
+    if (check->joinable) pthread_join(check->thread, NULL);
+    pthread_mutex_destroy(&check->lock);
+    free(check);
+}
@@ -0,0 +1,38 @@
+/*
+ * HackDS GUI Menu System
+ * System update check, off the UI thread
+ */
+
+#ifndef UPDATE_CHECK_H
+#define UPDATE_CHECK_H
+
+#include <SDL2/SDL.h>
+
+#define UPDATE_CACHE_FILE "/var/cache/hackds/update-check"
+#define UPDATE_CHECK_INTERVAL (6 * 60 * 60)   // Seconds a cached result is trusted
+
+typedef struct {
+    int available;
+    char version[32];
+} update_status_t;
+
+typedef struct update_check update_check_t;
+
+// Fill status from the last saved result, which lives in
+// HACKDS_UPDATE_CACHE (default UPDATE_CACHE_FILE), and check again in the
+// background if it is older than UPDATE_CHECK_INTERVAL. Results arrive as
+// SDL events of event_type, registered for the check.
+update_check_t* update_check_start(Uint32 event_type, update_status_t *status);
+
+// Check now, whatever the age of the saved result. Does nothing while a
+// check is running.
+void update_check_request(update_check_t *check);
+
+// Take the result of a finished check, after its event arrived. Returns 1
+// if status changed.
+int update_check_result(update_check_t *check, update_status_t *status);
+
+// Stop a running check and wait for it
+void update_check_stop(update_check_t *check);
+
+#endif // UPDATE_CHECK_H
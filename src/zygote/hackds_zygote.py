@@ -0,0 +1,330 @@
+#!/usr/bin/env python3
+"""
+HackDS Python Zygote
+Keeps a Python interpreter with the common game libraries already imported
+and forks a ready copy of it for each Python game, so launches skip
+interpreter startup and `import pygame`.
+
+Protocol (one connection per game, over a Unix stream socket):
+  request:  NUL-terminated strings, ended by an empty string
+              "hackds-zygote 1", game directory, entrypoint,
+              then "E<name>=<value>" for each environment variable
+              and "L<module>" for each library the game requires
+            stdin, stdout and stderr are passed along as SCM_RIGHTS
+  response: "pid <pid>\\n" once the game is running, then
+            "exit <code>\\n" or "signal <number>\\n" when it ends
+Closing the connection early terminates the game.
+"""
+
+import os
+import re
+import sys
+import json
+import select
+import signal
+import socket
+import struct
+import array
+import atexit
+import runpy
+import importlib
+import traceback
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+# Configuration
+SOCKET_PATH = os.environ.get("HACKDS_ZYGOTE_SOCKET") or "/run/hackds/zygote.sock"
+GAMES_DIR = "/games"
+PROTOCOL = "hackds-zygote 1"
+MAX_REQUEST = 64 * 1024
+
+# Common .hdsg header: magic, version major/minor, flags, reserved,
+# header crc, metadata size, payload size, uncompressed size
+HEADER_FORMAT = "<IHHHHIIQQ"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+MAGIC_HDSG = 0x47534448
+
+
+def log(message: str):
+    print(f"hackds-zygote: {message}", file=sys.stderr, flush=True)
+
+
+def read_metadata(path: Path) -> Optional[Dict]:
+    """Read the metadata JSON of a game file without touching its payload"""
+    try:
+        with open(path, 'rb') as f:
+            header = f.read(HEADER_SIZE)
+            if len(header) != HEADER_SIZE:
+                return None
+            fields = struct.unpack(HEADER_FORMAT, header)
+            if fields[0] != MAGIC_HDSG:
+                return None
+            return json.loads(f.read(fields[6]).decode('utf-8'))
+    except (OSError, ValueError):
+        return None
+
+
+def module_name(requirement: str) -> str:
+    """Turn a requirement such as "numpy>=1.20" into a module name"""
+    return re.split(r"[<>=!~;\[\s]", requirement.strip(), maxsplit=1)[0]
+
+
+def required_libraries() -> List[str]:
+    """Libraries listed under requires.libraries by the installed games"""
+    libraries = set()
+    for path in sorted(Path(GAMES_DIR).glob("*.hdsg")):
+        metadata = read_metadata(path)
+        if not isinstance(metadata, dict):
+            continue
+        requires = metadata.get("requires")
+        if not isinstance(requires, dict):
+            continue
+        for requirement in requires.get("libraries") or []:
+            if isinstance(requirement, str) and module_name(requirement):
+                libraries.add(module_name(requirement))
+    return sorted(libraries)
+
+
+class Zygote:
+    def __init__(self):
+        self.imported = set()
+        self.failed = set()
+        self.games = {}           # pid -> connection of the loader that asked
+        self.detached = set()     # Games whose loader went away; reaped silently
+        self.listener = None
+
+    def preload(self, libraries: List[str]):
+        """Import libraries into this process so every fork inherits them"""
+        # pygame greets on import; games started cold would print the same
+        os.environ.setdefault("PYGAME_HIDE_SUPPORT_PROMPT", "1")
+
+        for name in libraries:
+            if name in self.imported or name in self.failed:
+                continue
+            try:
+                importlib.import_module(name)
+                self.imported.add(name)
+            except Exception as e:
+                self.failed.add(name)
+                log(f"cannot preload {name}: {e}")
+
+    def listen(self):
+        os.makedirs(os.path.dirname(SOCKET_PATH), exist_ok=True)
+        try:
+            os.unlink(SOCKET_PATH)
+        except FileNotFoundError:
+            pass
+
+        # Requests run arbitrary files with any environment, so only the
+        # loader, which runs as the same user, may connect. The umask keeps
+        # the socket closed to others between bind() and chmod().
+        self.listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        old_umask = os.umask(0o177)
+        try:
+            self.listener.bind(SOCKET_PATH)
+        finally:
+            os.umask(old_umask)
+        os.chmod(SOCKET_PATH, 0o600)
+        self.listener.listen(8)
+
+    def receive_request(self, conn: socket.socket) -> Optional[Tuple[List[str], List[int]]]:
+        """Read one request and the descriptors sent with it"""
+        data = b""
+        fds = []
+        while not data.endswith(b"\0\0") and len(data) < MAX_REQUEST:
+            chunk, received = self._recv_fds(conn)
+            fds.extend(received)
+            if not chunk:
+                break
+            data += chunk
+
+        fields = data.split(b"\0")[:-2] if data.endswith(b"\0\0") else []
+        if len(fields) < 3 or fields[0] != PROTOCOL.encode() or len(fds) != 3:
+            for fd in fds:
+                os.close(fd)
+            return None
+        return [f.decode('utf-8', 'surrogateescape') for f in fields], fds
+
+    @staticmethod
+    def _recv_fds(conn: socket.socket) -> Tuple[bytes, List[int]]:
+        fds = array.array("i")
+        msg, ancdata, _, _ = conn.recvmsg(4096, socket.CMSG_SPACE(3 * fds.itemsize))
+        for level, kind, payload in ancdata:
+            if level == socket.SOL_SOCKET and kind == socket.SCM_RIGHTS:
+                fds.frombytes(payload[:len(payload) - (len(payload) % fds.itemsize)])
+        return msg, list(fds)
+
+    def spawn(self, conn: socket.socket):
+        request = self.receive_request(conn)
+        if request is None:
+            log("malformed request")
+            conn.close()
+            return
+
+        fields, fds = request
+        game_dir, entrypoint = fields[1], fields[2]
+        env = dict(f[1:].split("=", 1) for f in fields[3:] if f.startswith("E") and "=" in f)
+        libraries = [module_name(f[1:]) for f in fields[3:] if f.startswith("L")]
+
+        # Anything printed by the zygote must not show up in the game's output
+        sys.stdout.flush()
+        sys.stderr.flush()
+
+        pid = os.fork()
+        if pid == 0:
+            self.listener.close()
+            for other in self.games.values():
+                other.close()
+            conn.close()
+            run_game(game_dir, entrypoint, env, fds)
+
+        for fd in fds:
+            os.close(fd)
+        self.games[pid] = conn
+        try:
+            conn.sendall(f"pid {pid}\n".encode())
+        except OSError:
+            pass
+
+        # Games that need libraries nobody preloaded yet get them warm from
+        # the next launch on
+        self.preload(libraries)
+
+    def reap(self):
+        while True:
+            try:
+                pid, status = os.waitpid(-1, os.WNOHANG)
+            except ChildProcessError:
+                return
+            if pid == 0:
+                return
+
+            self.detached.discard(pid)
+            conn = self.games.pop(pid, None)
+            if conn is None:
+                continue
+            if os.WIFSIGNALED(status):
+                reply = f"signal {os.WTERMSIG(status)}\n"
+            else:
+                reply = f"exit {os.WEXITSTATUS(status)}\n"
+            try:
+                conn.sendall(reply.encode())
+            except OSError:
+                pass
+            conn.close()
+
+    def serve(self):
+        wakeup_r, wakeup_w = os.pipe()
+        os.set_blocking(wakeup_w, False)
+        signal.set_wakeup_fd(wakeup_w)
+        signal.signal(signal.SIGCHLD, lambda signum, frame: None)
+        signal.signal(signal.SIGTERM, lambda signum, frame: sys.exit(0))
+
+        log(f"ready on {SOCKET_PATH} with {', '.join(sorted(self.imported)) or 'no libraries'}")
+
+        while True:
+            watched = [self.listener, wakeup_r] + list(self.games.values())
+            try:
+                readable, _, _ = select.select(watched, [], [])
+            except InterruptedError:
+                continue
+
+            if wakeup_r in readable:
+                os.read(wakeup_r, 512)
+                self.reap()
+
+            if self.listener in readable:
+                conn, _ = self.listener.accept()
+                conn.settimeout(5)
+                try:
+                    self.spawn(conn)
+                except OSError as e:
+                    log(f"launch failed: {e}")
+                    conn.close()
+
+            # A loader that goes away takes its game with it
+            for pid, conn in list(self.games.items()):
+                if conn in readable and conn.fileno() >= 0:
+                    try:
+                        gone = conn.recv(1, socket.MSG_PEEK) == b""
+                    except OSError:
+                        gone = True
+                    if gone:
+                        # Signal once and stop watching; the game may take a
+                        # while to exit, or ignore the signal altogether
+                        del self.games[pid]
+                        conn.close()
+                        self.detached.add(pid)
+                        try:
+                            os.kill(pid, signal.SIGTERM)
+                        except ProcessLookupError:
+                            pass
+
+
+def run_game(game_dir: str, entrypoint: str, env: Dict[str, str], fds: List[int]):
+    """Turn this forked child into the game, as `python3 entrypoint` would"""
+    code = 1
+    try:
+        signal.set_wakeup_fd(-1)
+        for signum in (signal.SIGCHLD, signal.SIGTERM):
+            signal.signal(signum, signal.SIG_DFL)
+        signal.signal(signal.SIGINT, signal.default_int_handler)
+
+        for target, fd in enumerate(fds):
+            os.dup2(fd, target)
+            os.close(fd)
+
+        os.chdir(game_dir)
+        os.environ.clear()
+        os.environ.update(env)
+
+        script = os.path.abspath(entrypoint)
+        extra = [p for p in env.get("PYTHONPATH", "").split(os.pathsep) if p]
+        sys.path[:] = [os.path.dirname(script)] + extra + \
+            [p for p in sys.path[1:] if p not in extra]
+        sys.argv = [entrypoint]
+
+        runpy.run_path(entrypoint, run_name="__main__")
+        code = 0
+    except SystemExit as e:
+        if e.code is None:
+            code = 0
+        elif isinstance(e.code, int):
+            code = e.code
+        else:
+            print(e.code, file=sys.stderr)
+            code = 1
+    except BaseException:
+        traceback.print_exc()
+        code = 1
+    finally:
+        try:
+            atexit._run_exitfuncs()
+            sys.stdout.flush()
+            sys.stderr.flush()
+        finally:
+            os._exit(code & 0xFF)
+
+
+def main():
+    zygote = Zygote()
+    zygote.preload(required_libraries())
+
+    try:
+        zygote.listen()
+    except OSError as e:
+        log(f"cannot listen on {SOCKET_PATH}: {e}")
+        return 1
+
+    try:
+        zygote.serve()
+    finally:
+        try:
+            os.unlink(SOCKET_PATH)
+        except OSError:
+            pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,102 @@
+#!/bin/bash
+#
+# HackDS Pipelined Launch Check
+# Launches a block-compressed game through the game loader on a
+# multi-threaded worker pool and fails unless the game has started (the
+# profiled "exec" phase ended) well before its background extraction
+# ("fill") finished: within the first half of it. Anything that makes
+# fork() wait for the extraction job, such as a fork handler in libhackds
+# taking the pool's run lock, breaks this.
+#
+# Usage: check-pipelined-launch.sh [launches]
+# Run by "make check" in src/. Whether the loader forks while extraction is
+# under way depends on scheduling, so it launches [launches] (default 10)
+# times and every launch must pass.
+#
+
+set -e
+
+TOOLS_DIR="$(cd "$(dirname "$0")" && pwd)"
+SRC_DIR="${TOOLS_DIR}/../src"
+LOADER="${SRC_DIR}/gameloader/hackds-gameloader"
+PRELOAD="${SRC_DIR}/libhackds/libhackds_preload.so"
+LAUNCHES="${1:-10}"
+
+for file in "${LOADER}" "${PRELOAD}"; do
+    if [ ! -f "${file}" ]; then
+        echo "Missing ${file}; run \"make preload gameloader\" in src/ first"
+        exit 1
+    fi
+done
+
+WORK_DIR="$(mktemp -d "${TMPDIR:-/tmp}/hackds-check.XXXXXX")"
+trap 'rm -rf "${WORK_DIR}"' EXIT
+
+# A game that exits at once, with 48 MiB of assets that compress to about
+# three quarters, so extraction takes far longer than starting the game
+mkdir "${WORK_DIR}/game"
+printf '#!/bin/sh\nexit 0\n' > "${WORK_DIR}/game/run.sh"
+chmod 755 "${WORK_DIR}/game/run.sh"
+for i in $(seq -w 1 64); do
+    head -c 786432 /dev/urandom | base64 > "${WORK_DIR}/game/data${i}.txt"
+done
+cat > "${WORK_DIR}/metadata.json" << EOF
+{
+  "name": "Pipelined Launch Check",
+  "version": "1.0.0",
+  "author": "HackDS",
+  "engine": "cpp",
+  "entrypoint": "run.sh"
+}
+EOF
+python3 "${TOOLS_DIR}/hdsg-packager.py" game "${WORK_DIR}/game" \
+    "${WORK_DIR}/check.hdsg" "${WORK_DIR}/metadata.json" > /dev/null
+
+for i in $(seq 1 "${LAUNCHES}"); do
+    # Each launch starts from an empty cache so that it is pipelined again;
+    # their profiles collect in one log
+    rm -rf "${WORK_DIR}/cache"
+    HACKDS_THREADS=4 \
+    HACKDS_CACHE_DIR="${WORK_DIR}/cache" \
+    HACKDS_PRELOAD_LIB="${PRELOAD}" \
+        "${LOADER}" --profile="${WORK_DIR}/profile.jsonl" "${WORK_DIR}/check.hdsg" > /dev/null
+done
+
+python3 - "${WORK_DIR}/profile.jsonl" << 'EOF'
+import json
+import sys
+
+failed = 0
+overlapped = 0
+records = [json.loads(line) for line in open(sys.argv[1]) if line.strip()]
+for i, record in enumerate(records, 1):
+    phases = record.get("phases", {})
+    if record.get("mode") != "pipelined" or "exec" not in phases or "fill" not in phases:
+        print(f"launch {i}: not a pipelined launch (mode {record.get('mode')})")
+        failed += 1
+        continue
+
+    exec_phase, fill = phases["exec"], phases["fill"]
+    exec_end = exec_phase["start_us"] + exec_phase["us"]
+    # Writing the cache marker ends fill too, so a game that waited for the
+    # extraction still starts shortly before fill ends
+    fill_half = fill["start_us"] + fill["us"] // 2
+    # Only a fork made once extraction is under way can be held up by it
+    during = exec_phase["start_us"] > fill["start_us"]
+    overlapped += during
+    verdict = "ok" if exec_end < fill_half else "FAILED: the game waited for extraction"
+    print(f"launch {i}: exec {exec_phase['us']} us, fill {fill['us']} us"
+          f"{', forked during extraction' if during else ''} - {verdict}")
+    failed += exec_end >= fill_half
+
+if not records:
+    print("No launch profiles were written")
+    sys.exit(1)
+if failed:
+    print("Pipelined launch check failed")
+    sys.exit(1)
+if not overlapped:
+    print("Warning: no launch forked while extraction was running, so a fork "
+          "that waits for it would have gone unnoticed (one CPU?)")
+print("Pipelined launch check passed")
+EOF
@@ -0,0 +1,694 @@
+/*
+ * HackDS File Format Library
+ * Benchmarks
+ *
+ * Usage: hackds-bench <archive> [runs]
+ *        hackds-bench scan [runs]
+ *        hackds-bench lookup [runs]
+ *        hackds-bench metadata [runs]
+ *
+ * hackds-bench <archive> measures worker pool scaling. For 1, 2, 4 and 8
+ * pool threads, times the best of [runs] of:
+ *   read     hackds_extract_file() of the largest entry, whose whole blocks
+ *            are inflated on the pool
+ *   extract  hackds_extract_all() into a scratch directory under TMPDIR;
+ *            point it at a tmpfs to keep disk writeback out of the numbers
+ *   4 calls  four threads reading the largest entry at once; the pool runs
+ *            one job at a time, so this shows what serializing callers costs
+ *
+ * Each run opens the archive again so that no block cache carries over.
+ *
+ * hackds-bench scan measures what the menu's library scan pays per game as
+ * archives grow. It writes uncompressed games with 1 to 256 MiB payloads
+ * under TMPDIR and times the best of [runs] of hackds_open_header(),
+ * hackds_peek_metadata() and, for comparison, hackds_open() on each. The
+ * first two read only the header and metadata, so their times should not
+ * depend on the payload size. The files were just written, so hackds_open()
+ * reads them from the page cache; from disk it would be slower still.
+ *
+ * hackds-bench lookup measures name lookups in archives of 1k, 10k and 100k
+ * small entries. It times the best of [runs] of:
+ *   index    the first hackds_extract_file() on a fresh handle, which parses
+ *            the directory and builds the name index
+ *   lookup   hackds_extract_file() of every entry in shuffled order, per call
+ *   linear   a strcmp() walk over the directory for a sample of the same
+ *            names, per name, as lookups worked before the index
+ *
+ * hackds-bench metadata compares reading what the game loader needs (five
+ * strings and the preload list) from 1.6 KB of metadata, per game, by:
+ *   strstr    the loader's old strstr() scan, which is faster but matches
+ *             keys inside other values and ignores escapes
+ *   tokenize  hackds_json_parse() of the whole document, which the first
+ *             lookup on a handle does once
+ *   lookups   the typed getters on a handle that is already indexed
+ * A game parsed once per launch or scan pays tokenize + lookups.
+ *
+ * [runs] defaults to 5. Build with "make bench" in src/.
+ */
+
+#define _GNU_SOURCE
+#include "../src/libhackds/hackds_format.h"
+#include <ftw.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CALLERS 4
+#define CHUNK_SIZE (1024 * 1024)
+#define ENTRY_SIZE 64             // Bytes per entry in the lookup archives
+#define LINEAR_SAMPLE 1000        // Names timed with the linear walk
+#define METADATA_PARSES 100000    // Parses per metadata run
+
+// Metadata of the archives the benchmarks write
+#define BENCH_METADATA "{\"name\":\"Bench\",\"version\":\"1.0.0\",\"author\":\"HackDS\"," \
+                       "\"engine\":\"python\",\"entrypoint\":\"main.py\"}"
+
+static const char *archive;
+static char largest[512];
+static char (*lookup_names)[32];  // Entry names in shuffled order
+static size_t lookup_count;
+static hackds_file_t *metadata_file;  // Handle whose metadata is indexed
+static hackds_json_token_t *metadata_tokens;
+static int metadata_token_count;
+static volatile size_t sink;      // Keeps parsed results alive
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int read_once(void) {
+    hackds_file_t *file = hackds_open(archive);
+    if (!file) return -1;
+
+    uint8_t *data;
+    size_t size;
+    int ret = hackds_extract_file(file, largest, &data, &size);
+    if (ret == 0) free(data);
+
+    hackds_close(file);
+    return ret;
+}
+
+static void* caller_main(void *failed) {
+    if (read_once() != 0) *(int*)failed = 1;
+    return NULL;
+}
+
+static int read_concurrently(void) {
+    pthread_t threads[CALLERS];
+    int failed = 0;
+    int started = 0;
+
+    for (; started < CALLERS; started++) {
+        if (pthread_create(&threads[started], NULL, caller_main, &failed) != 0) break;
+    }
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    return failed || started < CALLERS ? -1 : 0;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+// Time one call of fn, or return a negative value if it failed
+static double time_read(int (*fn)(void)) {
+    double start = now_ms();
+    return fn() == 0 ? now_ms() - start : -1;
+}
+
+// The scratch tree goes in TMPDIR; removing it is not timed
+static double time_extract(void) {
+    const char *tmp = getenv("TMPDIR");
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/hackds-bench.XXXXXX", tmp && *tmp ? tmp : "/tmp");
+    if (!mkdtemp(dir)) return -1;
+
+    double start = now_ms();
+    hackds_file_t *file = hackds_open(archive);
+    int ret = file ? hackds_extract_all(file, dir) : -1;
+    hackds_close(file);
+    double elapsed = now_ms() - start;
+
+    nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    return ret == 0 ? elapsed : -1;
+}
+
+static int open_header_once(void) {
+    hackds_file_t *file = hackds_open_header(archive);
+    if (!file) return -1;
+    hackds_close(file);
+    return 0;
+}
+
+static int peek_once(void) {
+    char *metadata = hackds_peek_metadata(archive);
+    if (!metadata) return -1;
+    free(metadata);
+    return 0;
+}
+
+static int open_once(void) {
+    hackds_file_t *file = hackds_open(archive);
+    if (!file) return -1;
+    hackds_close(file);
+    return 0;
+}
+
+// Open the archive and look one name up, which builds the index
+static hackds_file_t* open_indexed(double *elapsed) {
+    hackds_file_t *file = hackds_open(archive);
+    if (!file) return NULL;
+
+    uint8_t *data;
+    size_t size;
+    double start = now_ms();
+    int ret = hackds_extract_file(file, lookup_names[0], &data, &size);
+    if (elapsed) *elapsed = now_ms() - start;
+    if (ret != 0) {
+        hackds_close(file);
+        return NULL;
+    }
+    free(data);
+    return file;
+}
+
+static double time_index(void) {
+    double elapsed;
+    hackds_file_t *file = open_indexed(&elapsed);
+    if (!file) return -1;
+    hackds_close(file);
+    return elapsed;
+}
+
+static double time_lookups(void) {
+    hackds_file_t *file = open_indexed(NULL);
+    if (!file) return -1;
+
+    double start = now_ms();
+    int ret = 0;
+    for (size_t i = 0; i < lookup_count && ret == 0; i++) {
+        uint8_t *data;
+        size_t size;
+        ret = hackds_extract_file(file, lookup_names[i], &data, &size);
+        if (ret == 0) free(data);
+    }
+    double elapsed = now_ms() - start;
+
+    hackds_close(file);
+    return ret == 0 ? elapsed : -1;
+}
+
+static double time_linear(void) {
+    hackds_file_t *file = open_indexed(NULL);
+    if (!file) return -1;
+
+    size_t sample = lookup_count < LINEAR_SAMPLE ? lookup_count : LINEAR_SAMPLE;
+    size_t found = 0;
+    double start = now_ms();
+    for (size_t i = 0; i < sample; i++) {
+        for (size_t j = 0; j < file->file_count; j++) {
+            if (strcmp(file->files[j].filename, lookup_names[i]) == 0) {
+                found++;
+                break;
+            }
+        }
+    }
+    double elapsed = now_ms() - start;
+
+    hackds_close(file);
+    return found == sample ? elapsed : -1;
+}
+
+typedef struct {
+    char name[256];
+    char version[32];
+    char author[128];
+    char engine[32];
+    char entrypoint[256];
+} bench_metadata_t;
+
+// The game loader's metadata parsing before the tokenizer: the first
+// string after the first occurrence of the quoted key
+static void strstr_field(const char *json, const char *key, char *buf, size_t len) {
+    const char *start = strstr(json, key);
+    if (start) start = strchr(start, ':');
+    if (start) start = strchr(start, '"');
+    if (!start) return;
+
+    start++;
+    const char *end = strchr(start, '"');
+    if (end && (size_t)(end - start) < len) {
+        memcpy(buf, start, (size_t)(end - start));
+        buf[end - start] = '\0';
+    }
+}
+
+static void strstr_preload(const char *json) {
+    const char *p = strstr(json, "\"preload\"");
+    if (p) p = strchr(p, '[');
+    if (!p) return;
+
+    for (p++; *p && *p != ']'; p++) {
+        if (*p != '"') continue;
+
+        const char *start = ++p;
+        while (*p && *p != '"') {
+            if (*p == '\\' && p[1]) p++;
+            p++;
+        }
+        if (!*p) break;
+
+        char *name = strndup(start, (size_t)(p - start));
+        sink += name ? (size_t)name[0] : 0;
+        free(name);
+    }
+}
+
+static double time_strstr(void) {
+    const char *json = hackds_get_metadata(metadata_file);
+    double start = now_ms();
+    for (int i = 0; i < METADATA_PARSES; i++) {
+        bench_metadata_t meta = {0};
+        strstr_field(json, "\"name\"", meta.name, sizeof(meta.name));
+        strstr_field(json, "\"version\"", meta.version, sizeof(meta.version));
+        strstr_field(json, "\"author\"", meta.author, sizeof(meta.author));
+        strstr_field(json, "\"engine\"", meta.engine, sizeof(meta.engine));
+        strstr_field(json, "\"entrypoint\"", meta.entrypoint, sizeof(meta.entrypoint));
+        strstr_preload(json);
+        sink += (size_t)meta.name[0];
+    }
+    return now_ms() - start;
+}
+
+static double time_tokenize(void) {
+    const char *json = hackds_get_metadata(metadata_file);
+    size_t len = strlen(json);
+    double start = now_ms();
+    for (int i = 0; i < METADATA_PARSES; i++) {
+        int count = hackds_json_parse(json, len, metadata_tokens, metadata_token_count);
+        if (count < 0) return -1;
+        sink += (size_t)count;
+    }
+    return now_ms() - start;
+}
+
+static double time_getters(void) {
+    double start = now_ms();
+    for (int i = 0; i < METADATA_PARSES; i++) {
+        bench_metadata_t meta = {0};
+        hackds_get_metadata_string(metadata_file, "name", meta.name, sizeof(meta.name));
+        hackds_get_metadata_string(metadata_file, "version", meta.version, sizeof(meta.version));
+        hackds_get_metadata_string(metadata_file, "author", meta.author, sizeof(meta.author));
+        hackds_get_metadata_string(metadata_file, "engine", meta.engine, sizeof(meta.engine));
+        hackds_get_metadata_string(metadata_file, "entrypoint", meta.entrypoint,
+                                   sizeof(meta.entrypoint));
+
+        int count = hackds_get_metadata_array_size(metadata_file, "preload");
+        for (int j = 0; j < count; j++) {
+            char path[32];
+            snprintf(path, sizeof(path), "preload.%d", j);
+            char *name = hackds_get_metadata_field(metadata_file, path);
+            sink += name ? (size_t)name[0] : 0;
+            free(name);
+        }
+        sink += (size_t)meta.name[0];
+    }
+    return now_ms() - start;
+}
+
+typedef enum {
+    TEST_READ, TEST_EXTRACT, TEST_CALLS,
+    TEST_OPEN_HEADER, TEST_PEEK, TEST_OPEN,
+    TEST_INDEX, TEST_LOOKUPS, TEST_LINEAR,
+    TEST_STRSTR, TEST_TOKENIZE, TEST_GETTERS
+} test_t;
+
+// Best time of runs, or a negative value if any failed
+static double best_of(int runs, test_t test) {
+    double best = -1;
+    for (int i = 0; i < runs; i++) {
+        double elapsed = test == TEST_READ ? time_read(read_once)
+                       : test == TEST_EXTRACT ? time_extract()
+                       : test == TEST_CALLS ? time_read(read_concurrently)
+                       : test == TEST_OPEN_HEADER ? time_read(open_header_once)
+                       : test == TEST_PEEK ? time_read(peek_once)
+                       : test == TEST_OPEN ? time_read(open_once)
+                       : test == TEST_INDEX ? time_index()
+                       : test == TEST_LOOKUPS ? time_lookups()
+                       : test == TEST_LINEAR ? time_linear()
+                       : test == TEST_STRSTR ? time_strstr()
+                       : test == TEST_TOKENIZE ? time_tokenize()
+                       : time_getters();
+        if (elapsed < 0) return -1;
+        if (best < 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+// Pick the largest entry for the read test
+static int find_largest(size_t *size) {
+    hackds_file_t *file = hackds_open(archive);
+    if (!file) return -1;
+
+    char **names;
+    size_t count;
+    if (hackds_list_files(file, &names, &count) != 0) {
+        hackds_close(file);
+        return -1;
+    }
+
+    *size = 0;
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *data;
+        size_t entry_size;
+        uint8_t *copy = NULL;
+        // Views are only available for stored archives
+        if (hackds_file_view(file, names[i], &data, &entry_size) != 0 &&
+            hackds_extract_file(file, names[i], &copy, &entry_size) != 0) {
+            entry_size = 0;
+        }
+        free(copy);
+
+        if (entry_size > *size) {
+            *size = entry_size;
+            snprintf(largest, sizeof(largest), "%s", names[i]);
+        }
+        free(names[i]);
+    }
+    free(names);
+
+    hackds_close(file);
+    return *size > 0 ? 0 : -1;
+}
+
+// Write an uncompressed game of count entries of size bytes each, named
+// assets/<index>.dat. Entry data goes out in chunks, so a payload can be
+// larger than memory.
+static int write_archive(const char *path, const char *metadata,
+                         size_t count, uint64_t size) {
+    uint8_t *chunk = malloc(CHUNK_SIZE);
+    if (!chunk) return -1;
+    for (size_t i = 0; i < CHUNK_SIZE; i++) chunk[i] = (uint8_t)(i * 31);
+
+    // Every entry holds the same bytes
+    uint32_t crc = 0;
+    for (uint64_t done = 0; done < size; ) {
+        size_t n = size - done < CHUNK_SIZE ? (size_t)(size - done) : CHUNK_SIZE;
+        crc = hackds_crc32_update(crc, chunk, n);
+        done += n;
+    }
+
+    // Directory: name length (2), name, size (8), offset (8), crc (4), with
+    // offsets counted from the start of the payload
+    char name[32];
+    size_t name_len = (size_t)snprintf(name, sizeof(name), "assets/%06d.dat", 0);
+    size_t record = 2 + name_len + 8 + 8 + 4;
+    size_t dir_size = count * record;
+    uint8_t *dir = malloc(dir_size);
+    if (!dir) {
+        free(chunk);
+        return -1;
+    }
+
+    uint8_t *ptr = dir;
+    for (size_t i = 0; i < count; i++) {
+        uint16_t len16 = (uint16_t)name_len;
+        uint64_t offset = dir_size + i * size;
+        snprintf(name, sizeof(name), "assets/%06zu.dat", i);
+        memcpy(ptr, &len16, 2);
+        memcpy(ptr + 2, name, name_len);
+        memcpy(ptr + 2 + name_len, &size, 8);
+        memcpy(ptr + 2 + name_len + 8, &offset, 8);
+        memcpy(ptr + 2 + name_len + 16, &crc, 4);
+        ptr += record;
+    }
+
+    hackds_header_t header = {
+        .magic = MAGIC_HDSG,
+        .version_major = HACKDS_VERSION_MAJOR,
+        .metadata_size = (uint32_t)strlen(metadata),
+        .payload_size = dir_size + count * size,
+    };
+    header.header_crc = hackds_crc32((const uint8_t*)&header, sizeof(header));
+
+    FILE *fp = fopen(path, "wb");
+    int ret = fp ? 0 : -1;
+    if (fp) {
+        if (fwrite(&header, sizeof(header), 1, fp) != 1 ||
+            fwrite(metadata, header.metadata_size, 1, fp) != 1 ||
+            fwrite(dir, dir_size, 1, fp) != 1) {
+            ret = -1;
+        }
+        for (size_t i = 0; i < count && ret == 0; i++) {
+            for (uint64_t done = 0; done < size && ret == 0; ) {
+                size_t n = size - done < CHUNK_SIZE ? (size_t)(size - done) : CHUNK_SIZE;
+                if (fwrite(chunk, n, 1, fp) != 1) ret = -1;
+                done += n;
+            }
+        }
+        if (fclose(fp) != 0) ret = -1;
+    }
+
+    free(dir);
+    free(chunk);
+    return ret;
+}
+
+// Scratch archive under TMPDIR; the caller unlinks it
+static int scratch_path(char *path, size_t len) {
+    const char *tmp = getenv("TMPDIR");
+    snprintf(path, len, "%s/hackds-bench.XXXXXX", tmp && *tmp ? tmp : "/tmp");
+    int fd = mkstemp(path);
+    if (fd < 0) return -1;
+    close(fd);
+    return 0;
+}
+
+static int bench_scan(int runs) {
+    static const int sizes_mib[] = { 1, 16, 64, 256 };
+
+    char path[512];
+    if (scratch_path(path, sizeof(path)) != 0) {
+        fprintf(stderr, "Cannot create a scratch file in TMPDIR\n");
+        return 1;
+    }
+    archive = path;
+
+    printf("Library scan cost per game, best of %d\n\n", runs);
+    printf("| Payload (MiB) | open_header (us) | peek_metadata (us) | open (us) |\n");
+    printf("|---------------|------------------|--------------------|-----------|\n");
+
+    for (size_t i = 0; i < sizeof(sizes_mib) / sizeof(sizes_mib[0]); i++) {
+        if (write_archive(path, BENCH_METADATA, 1, (uint64_t)sizes_mib[i] * 1024 * 1024) != 0) {
+            fprintf(stderr, "Cannot write %s\n", path);
+            unlink(path);
+            return 1;
+        }
+
+        double header = best_of(runs, TEST_OPEN_HEADER);
+        double peek = best_of(runs, TEST_PEEK);
+        double open = best_of(runs, TEST_OPEN);
+        if (header < 0 || peek < 0 || open < 0) {
+            fprintf(stderr, "Benchmark failed: %s\n", hackds_get_error());
+            unlink(path);
+            return 1;
+        }
+
+        printf("| %13d | %16.1f | %18.1f | %9.0f |\n",
+               sizes_mib[i], header * 1e3, peek * 1e3, open * 1e3);
+    }
+
+    unlink(path);
+    return 0;
+}
+
+static int bench_lookup(int runs) {
+    static const size_t counts[] = { 1000, 10000, 100000 };
+    size_t max_count = counts[sizeof(counts) / sizeof(counts[0]) - 1];
+
+    lookup_names = malloc(max_count * sizeof(*lookup_names));
+    char path[512];
+    if (!lookup_names || scratch_path(path, sizeof(path)) != 0) {
+        fprintf(stderr, "Cannot set up the lookup benchmark\n");
+        free(lookup_names);
+        return 1;
+    }
+    archive = path;
+
+    printf("Name lookups with %d-byte entries, best of %d\n\n", ENTRY_SIZE, runs);
+    printf("| Entries | index (ms) | lookup (ns) | linear (ns) |\n");
+    printf("|---------|------------|-------------|-------------|\n");
+
+    int ret = 0;
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]) && ret == 0; i++) {
+        lookup_count = counts[i];
+        if (write_archive(path, BENCH_METADATA, lookup_count, ENTRY_SIZE) != 0) {
+            fprintf(stderr, "Cannot write %s\n", path);
+            ret = 1;
+            break;
+        }
+
+        // Fisher-Yates with a fixed seed, so runs see the same order
+        uint32_t seed = 2463534242u;
+        for (size_t j = 0; j < lookup_count; j++) {
+            snprintf(lookup_names[j], sizeof(lookup_names[j]), "assets/%06zu.dat", j);
+        }
+        for (size_t j = lookup_count - 1; j > 0; j--) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            size_t k = seed % (j + 1);
+            char swap[32];
+            memcpy(swap, lookup_names[j], sizeof(swap));
+            memcpy(lookup_names[j], lookup_names[k], sizeof(swap));
+            memcpy(lookup_names[k], swap, sizeof(swap));
+        }
+
+        double index = best_of(runs, TEST_INDEX);
+        double lookups = best_of(runs, TEST_LOOKUPS);
+        double linear = best_of(runs, TEST_LINEAR);
+        if (index < 0 || lookups < 0 || linear < 0) {
+            fprintf(stderr, "Benchmark failed: %s\n", hackds_get_error());
+            ret = 1;
+            break;
+        }
+
+        size_t sample = lookup_count < LINEAR_SAMPLE ? lookup_count : LINEAR_SAMPLE;
+        printf("| %7zu | %10.2f | %11.0f | %11.0f |\n", lookup_count, index,
+               lookups * 1e6 / (double)lookup_count, linear * 1e6 / (double)sample);
+    }
+
+    unlink(path);
+    free(lookup_names);
+    return ret;
+}
+
+// Metadata the size of a real game's: a long description, tags, a nested
+// object and a preload list around the fields the loader reads
+static char* build_metadata(void) {
+    char *json = malloc(8192);
+    if (!json) return NULL;
+
+    size_t n = (size_t)sprintf(json, "{\n  \"description\": \"");
+    for (int i = 0; i < 40; i++) {
+        n += (size_t)sprintf(json + n, "A long description line %d. ", i);
+    }
+    n += (size_t)sprintf(json + n, "\",\n  \"tags\": [");
+    for (int i = 0; i < 30; i++) {
+        n += (size_t)sprintf(json + n, "%s\"tag%d\"", i ? ", " : "", i);
+    }
+    sprintf(json + n,
+            "],\n  \"controls\": {\"a\": \"jump\", \"b\": \"fire\", \"start\": \"pause\"},\n"
+            "  \"name\": \"Example Game\",\n  \"version\": \"1.2.0\",\n"
+            "  \"author\": \"Someone\",\n  \"engine\": \"python\",\n"
+            "  \"entrypoint\": \"main.py\",\n"
+            "  \"preload\": [\"assets/a.png\", \"assets/b.ogg\", \"assets/font.ttf\"]\n}\n");
+    return json;
+}
+
+static int bench_metadata(int runs) {
+    char *json = build_metadata();
+    char path[512];
+    if (!json || scratch_path(path, sizeof(path)) != 0 ||
+        write_archive(path, json, 1, 0) != 0) {
+        fprintf(stderr, "Cannot set up the metadata benchmark\n");
+        free(json);
+        return 1;
+    }
+
+    // Index the handle once, as the first lookup of a launch does
+    metadata_file = hackds_open_header(path);
+    unlink(path);
+    metadata_token_count = hackds_json_parse(json, strlen(json), NULL, 0);
+    metadata_tokens = metadata_token_count > 0 ?
+        malloc((size_t)metadata_token_count * sizeof(*metadata_tokens)) : NULL;
+    char name[256];
+    if (!metadata_file || !metadata_tokens ||
+        hackds_get_metadata_string(metadata_file, "name", name, sizeof(name)) != 0) {
+        fprintf(stderr, "Cannot read the benchmark metadata: %s\n", hackds_get_error());
+        hackds_close(metadata_file);
+        free(metadata_tokens);
+        free(json);
+        return 1;
+    }
+
+    double strstr_ms = best_of(runs, TEST_STRSTR);
+    double tokenize = best_of(runs, TEST_TOKENIZE);
+    double getters = best_of(runs, TEST_GETTERS);
+
+    int ret = 0;
+    if (strstr_ms < 0 || tokenize < 0 || getters < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", hackds_get_error());
+        ret = 1;
+    } else {
+        printf("Loader metadata parse, %zu bytes in %d tokens, best of %d\n\n",
+               strlen(json), metadata_token_count, runs);
+        printf("| strstr (ns) | tokenize (ns) | lookups (ns) | tokenize + lookups (ns) |\n");
+        printf("|-------------|---------------|--------------|-------------------------|\n");
+        printf("| %11.0f | %13.0f | %12.0f | %23.0f |\n",
+               strstr_ms * 1e6 / METADATA_PARSES, tokenize * 1e6 / METADATA_PARSES,
+               getters * 1e6 / METADATA_PARSES, (tokenize + getters) * 1e6 / METADATA_PARSES);
+    }
+
+    hackds_close(metadata_file);
+    free(metadata_tokens);
+    free(json);
+    return ret;
+}
+
+static int bench_pool(int runs) {
+    size_t size;
+    if (find_largest(&size) != 0) {
+        fprintf(stderr, "Cannot read %s: %s\n", archive, hackds_get_error());
+        return 1;
+    }
+
+    printf("%s: largest entry %s (%zu KiB), %ld CPUs online, best of %d\n\n",
+           archive, largest, size / 1024, sysconf(_SC_NPROCESSORS_ONLN), runs);
+    printf("| Threads | read (ms) | extract (ms) | %d calls (ms) |\n", CALLERS);
+    printf("|---------|-----------|--------------|--------------|\n");
+
+    static const int thread_counts[] = { 1, 2, 4, 8 };
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+        hackds_set_threads(thread_counts[i]);
+
+        double read = best_of(runs, TEST_READ);
+        double extract = best_of(runs, TEST_EXTRACT);
+        double calls = best_of(runs, TEST_CALLS);
+        if (read < 0 || extract < 0 || calls < 0) {
+            fprintf(stderr, "Benchmark failed: %s\n", hackds_get_error());
+            return 1;
+        }
+
+        printf("| %7d | %9.1f | %12.1f | %12.1f |\n",
+               thread_counts[i], read, extract, calls);
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <archive> [runs]\n", argv[0]);
+        fprintf(stderr, "       %s scan [runs]\n", argv[0]);
+        fprintf(stderr, "       %s lookup [runs]\n", argv[0]);
+        fprintf(stderr, "       %s metadata [runs]\n", argv[0]);
+        return 1;
+    }
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    if (runs < 1) runs = 1;
+
+    if (strcmp(argv[1], "scan") == 0) return bench_scan(runs);
+    if (strcmp(argv[1], "lookup") == 0) return bench_lookup(runs);
+    if (strcmp(argv[1], "metadata") == 0) return bench_metadata(runs);
+
+    archive = argv[1];
+    return bench_pool(runs);
+}
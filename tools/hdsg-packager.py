@@ -20,11 +20,31 @@ MAGIC_HDSH = 0x48534448
 
 # Flags
 FLAG_COMPRESSED = 1 << 0
+FLAG_BLOCKED = 1 << 2
+
+# Compression codecs (flag bits 4-7) and their default levels
+CODEC_SHIFT = 4
+CODECS = {
+    'zlib': (0, 9),
+    'lz4': (1, 9),    # LZ4 HC: fastest to decode
+    'zstd': (2, 19),  # Zstandard: smallest files
+}
+
+# Uncompressed bytes per independently compressed block (format 1.1)
+DEFAULT_BLOCK_SIZE = 128 * 1024
+
+# magic, version major/minor, flags, reserved, header crc,
+# metadata size, payload size, uncompressed payload size
+HEADER_FORMAT = '<IHHHHIIQQ'
 
 class HDSGPackager:
-    def __init__(self):
+    def __init__(self, block_size: int = DEFAULT_BLOCK_SIZE,
+                 codec: str = 'zlib'):
         self.version_major = 1
         self.version_minor = 0
+        # 0 produces a single compressed stream (format 1.0)
+        self.block_size = block_size
+        self.codec = codec
 
     def create_hdsg(self, game_dir: str, output_file: str,
                     metadata: Dict, compress: bool = True) -> bool:
@@ -54,20 +74,22 @@ class HDSGPackager:
 
         # Compress if requested
         flags = 0
+        uncompressed_size = 0
         if compress:
             print("Compressing...")
-            compressed = zlib.compress(payload, 9)
+            uncompressed_size = len(payload)
+            compressed, flags = self._compress_payload(payload)
             print(f"Compressed size: {len(compressed)} bytes "
                   f"({100 * len(compressed) / len(payload):.1f}%)")
             payload = compressed
-            flags = FLAG_COMPRESSED | (9 << 8)
 
         # Build header
         header = self._build_header(
             MAGIC_HDSG,
             flags,
             len(metadata_json),
-            len(payload)
+            len(payload),
+            uncompressed_size
         )
 
         # Write file
@@ -126,11 +148,13 @@ class HDSGPackager:
             return False
 
         flags = 0
+        uncompressed_size = 0
         if compress:
-            payload = zlib.compress(payload, 9)
-            flags = FLAG_COMPRESSED | (9 << 8)
+            uncompressed_size = len(payload)
+            payload, flags = self._compress_payload(payload)
 
-        header = self._build_header(magic, flags, len(metadata_json), len(payload))
+        header = self._build_header(magic, flags, len(metadata_json),
+                                    len(payload), uncompressed_size)
 
         try:
             with open(output_file, 'wb') as f:
@@ -142,29 +166,64 @@ class HDSGPackager:
             print(f"Error: {e}")
             return False
 
+    def _compressor(self, level: int):
+        """Return a function compressing one buffer with the chosen codec"""
+        if self.codec == 'lz4':
+            import lz4.block
+            return lambda data: lz4.block.compress(
+                data, mode='high_compression', compression=level,
+                store_size=False)
+        if self.codec == 'zstd':
+            import zstandard
+            compressor = zstandard.ZstdCompressor(level=level)
+            return compressor.compress
+        return lambda data: zlib.compress(data, level)
+
+    def _compress_payload(self, payload: bytes):
+        """Compress an archive payload, returning (data, flags)"""
+        codec_id, level = CODECS[self.codec]
+        compress = self._compressor(level)
+        flags = FLAG_COMPRESSED | (codec_id << CODEC_SHIFT) | (level << 8)
+        if not self.block_size:
+            return compress(payload), flags
+
+        # Block table: block size, block count, then count + 1 offsets
+        # into the compressed blocks that follow
+        blocks = []
+        for start in range(0, len(payload), self.block_size):
+            blocks.append(compress(payload[start:start + self.block_size]))
+
+        offsets = [0]
+        for block in blocks:
+            offsets.append(offsets[-1] + len(block))
+
+        table = struct.pack('<II', self.block_size, len(blocks))
+        table += struct.pack(f'<{len(offsets)}Q', *offsets)
+
+        return table + b''.join(blocks), flags | FLAG_BLOCKED
+
     def _build_header(self, magic: int, flags: int,
-                     metadata_size: int, payload_size: int) -> bytes:
-        """Build the file header"""
-        header = struct.pack('<IHHH',
+                     metadata_size: int, payload_size: int,
+                     uncompressed_size: int = 0) -> bytes:
+        """Build the file header (matches hackds_header_t)"""
+        fields = [
             magic,
             self.version_major,
-            self.version_minor,
-            flags
-        )
-
-        # Calculate checksum (excluding the checksum field itself)
-        header += struct.pack('<I', 0)  # Placeholder for checksum
-        header += struct.pack('<IQQ',
+            # Block-compressed payloads need a 1.1 reader
+            1 if flags & FLAG_BLOCKED else self.version_minor,
+            flags,
+            0,  # Reserved
+            0,  # Placeholder for checksum
             metadata_size,
             payload_size,
-            0  # Reserved
-        )
+            uncompressed_size
+        ]
 
-        # Calculate and update checksum
-        checksum = zlib.crc32(header[:8] + header[12:])
-        header = header[:8] + struct.pack('<I', checksum) + header[12:]
+        # Checksum covers the whole header with the checksum field zeroed
+        checksum = zlib.crc32(struct.pack(HEADER_FORMAT, *fields))
+        fields[5] = checksum
 
-        return header
+        return struct.pack(HEADER_FORMAT, *fields)
 
     def _build_archive(self, directory: str) -> Optional[bytes]:
         """Build archive payload from directory"""
@@ -247,6 +306,41 @@ class HDSGPackager:
 
 
 def main():
+    # Split options from positional arguments
+    block_size = DEFAULT_BLOCK_SIZE
+    codec = 'zlib'
+    args = [sys.argv[0]]
+    for arg in sys.argv[1:]:
+        if arg.startswith('--codec='):
+            codec = arg.split('=', 1)[1].lower()
+            if codec not in CODECS:
+                print(f"Unknown codec: {codec} (choose from {', '.join(CODECS)})")
+                return 1
+        elif arg == '--solid':
+            block_size = 0
+        elif arg.startswith('--block-size='):
+            try:
+                block_size = int(arg.split('=', 1)[1]) * 1024
+            except ValueError:
+                print(f"Invalid block size: {arg}")
+                return 1
+            if block_size <= 0 or block_size > 0xFFFFFFFF:
+                print(f"Invalid block size: {arg}")
+                return 1
+        else:
+            args.append(arg)
+    sys.argv = args
+
+    # Fail early if the codec's Python package is missing
+    codec_modules = {'lz4': 'lz4', 'zstd': 'zstandard'}
+    if codec in codec_modules:
+        try:
+            __import__(codec_modules[codec])
+        except ImportError:
+            print(f"Error: --codec={codec} needs the "
+                  f"'{codec_modules[codec]}' Python package")
+            return 1
+
     if len(sys.argv) < 2:
         print("HackDS Game Packager")
         print("\nUsage:")
@@ -255,6 +349,10 @@ def main():
         print("  game <dir> <output.hdsg> <metadata.json>  - Package a game")
         print("  mod  <dir> <output.hdsm> <metadata.json>  - Package a mod")
         print("  hack <dir> <output.hdsh> <metadata.json>  - Package a hack")
+        print("\nOptions:")
+        print("  --block-size=<KiB>  Compress in independent blocks (default 128)")
+        print("  --solid             Compress as a single stream (format 1.0)")
+        print("  --codec=<name>      zlib (default), lz4 (fastest) or zstd (smallest)")
         print("\nMetadata JSON format:")
         print('''{
   "name": "Game Name",
@@ -267,7 +365,7 @@ def main():
         return 1
 
     command = sys.argv[1].lower()
-    packager = HDSGPackager()
+    packager = HDSGPackager(block_size, codec)
 
     if command == 'game':
         if len(sys.argv) != 5: